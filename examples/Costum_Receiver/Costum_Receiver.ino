@@ -52,20 +52,20 @@ void loop() {
 
 // void customrecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len){
 //   msg_struct receivedData;
-//   memcpy(&receivedData, incomingData, sizeof(receivedData));
+//   if(!decodeMsg(&receivedData, incomingData, len)) return;
 
 //   int current;
-//   memcpy(&current, &receivedData.data_array[0], sizeof(int));
+//   memcpy(&current, receivedData.payload, sizeof(int));
 
 //   received_value = current;
 // }
 
 void customrecv(const uint8_t *mac_addr, const uint8_t *incomingData, int len){
   msg_struct receivedData;
-  memcpy(&receivedData, incomingData, sizeof(receivedData));
+  if(!decodeMsg(&receivedData, incomingData, len)) return;
 
   int current;
-  memcpy(&current, &receivedData.data_array[0], sizeof(int));
+  memcpy(&current, receivedData.payload, sizeof(int));
 
   received_value = current;
 }
\ No newline at end of file
@@ -33,10 +33,9 @@ void setup() {
 
 void loop() {
   int received_value;
-  if(receiver_1.available()){
+  if(receiver_1.waitAvailable(1000)){ // Sleeps until a message arrives instead of polling
     received_value = receiver_1.read<int>();
     Serial.print("Received: ");
     Serial.println(received_value);
   }
-  delay(100);
 }
@@ -0,0 +1,1205 @@
+/**
+ * Benchmarks of QuickESPNow on the host backend.
+ *
+ * Measures the receive queue, the message codec, the peer and sender lookups, the compressor and the Send/receive path
+ * through the virtual radio, and prints the results as JSON (to stdout or to the file given
+ * as the first argument). Build it as described in extras/host/README.md.
+ */
+#include <QuickESPNow.h>
+#include <host_radio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define QUEUE_ROUNDS 20000          // Fill and drain cycles of the queue
+#define QUEUE_BATCH (MSG_QUEUE_CAPACITY - MSG_PRIORITY_RESERVE)  // Normal messages a queue takes, the reserve is left to urgent ones
+#define SPSC_MESSAGES 200000        // Messages passed between the two queue threads
+#define CODEC_BATCHES 2000          // Timed batches per codec benchmark
+#define CODEC_BATCH_SIZE 256        // Operations per batch
+#define LOOKUP_BATCHES 2000         // Timed batches of the peer lookup
+#define SEND_MESSAGES 20000         // Messages sent by each Send benchmark
+#define SEND_WINDOW_LIMIT 8         // Loopback messages in flight at once
+#define CALLBACK_BATCHES 2000       // Timed batches of each ESP-NOW callback
+#define CALLBACK_BATCH_SIZE 16      // Callbacks per batch, fewer than the receive queue and a log buffer hold
+#define LARGE_BYTES_IDEAL (1 << 20) // Bytes sent per fragmented size over the ideal radio
+#define LARGE_BYTES_1MBPS (1 << 17) // Bytes sent per fragmented size over the 1 Mbps radio
+#define LARGE_MAX_SIZE (64 * 1024)  // Largest fragmented message
+#define RELIABLE_MESSAGES 1000      // Messages sent by each reliable mode benchmark
+#define RELIABLE_LOSS 0.1f          // Frame loss of the lossy radio
+#define PRIORITY_PROBES 500         // Probe messages sent by each priority benchmark
+#define PRIORITY_PROBE_US 2000      // Time between two probe messages
+#define PRIORITY_READ_US 200        // Time between two reads, slower than the bulk traffic arrives
+#define DELTA_TRACE_MESSAGES 1000   // Messages of the telemetry trace sent by each delta benchmark
+#define LZ_CORPUS_SIZE (16 * 1024)  // Bytes of each compression corpus
+#define LZ_BATCHES 200              // Timed batches per compression benchmark
+#define LZ_MESSAGES 32              // Log dumps sent by each compressed loopback benchmark
+#define FANOUT_NODES 8              // Virtual nodes that receive each setpoint
+#define FANOUT_ROUNDS 500           // Setpoints sent by each fan-out benchmark
+#define DISPATCH_MESSAGES 1000      // Messages sent by each dispatch benchmark
+#define DISPATCH_WORK_US 1000       // Other work done by each pass of the application loop
+#define WAIT_MESSAGES 200           // Messages sent by each blocking read benchmark
+#define WAIT_POLL_MS 10             // Delay of the polling loop that the blocking read replaces
+#define HOP_NODES 2                 // Virtual nodes on channels of their own
+#define HOP_MESSAGES 100            // Messages sent round-robin to the hop nodes by each channel benchmark
+#define HOP_SWITCH_US 1000          // Time the radio is deaf after a channel switch in the channel benchmarks
+#define CLOCK_ROUNDS 200            // Pings sent to the clock node
+#define CLOCK_SKEW_US 250000000ll   // How far the clock of the clock node runs ahead
+#define CLOCK_HOLD_MAX_US 2000      // Longest time the clock node holds a pong after stamping it
+
+static std::string results;         // The JSON objects of the finished benchmarks
+
+static uint64_t nowNs(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the compiler from optimizing a value away
+template<typename T>
+static inline void keep(const T& value){
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief   Appends a result to the JSON output.
+ * @param   name The name of the benchmark
+ * @param   ops The number of operations that were timed
+ * @param   elapsed_ns The total time of the operations
+ * @param   samples Time of single operations (or batch averages), used for the percentiles
+ */
+static void report(const char* name, uint64_t ops, uint64_t elapsed_ns, std::vector<double>& samples){
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p){
+        return samples.empty() ? 0.0 : samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))];
+    };
+
+    char line[384];
+    snprintf(line, sizeof(line),
+             "%s\n    {\"name\": \"%s\", \"ops\": %llu, \"ops_per_sec\": %.0f, \"mean_ns\": %.1f, "
+             "\"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f}",
+             results.empty() ? "" : ",", name, (unsigned long long)ops,
+             elapsed_ns > 0 ? ops * 1e9 / elapsed_ns : 0.0, ops > 0 ? (double)elapsed_ns / ops : 0.0,
+             percentile(0.50), percentile(0.90), percentile(0.99), samples.empty() ? 0.0 : samples.back());
+    results += line;
+    fprintf(stderr, "%-28s %12.0f ops/s  p50 %8.1f ns  p99 %8.1f ns\n", name,
+            elapsed_ns > 0 ? ops * 1e9 / elapsed_ns : 0.0, percentile(0.50), percentile(0.99));
+}
+
+/**
+ * @brief   Times an operation in batches, each batch gives one sample of its average cost.
+ */
+template<typename F>
+static void timeBatches(const char* name, int batches, int batch_size, F operation){
+    std::vector<double> samples;
+    samples.reserve(batches);
+    uint64_t total = 0;
+
+    for(int b = 0; b < batches; b++){
+        uint64_t start = nowNs();
+        for(int i = 0; i < batch_size; i++){
+            operation(i);
+        }
+        uint64_t elapsed = nowNs() - start;
+        total += elapsed;
+        samples.push_back((double)elapsed / batch_size);
+    }
+    report(name, (uint64_t)batches * batch_size, total, samples);
+}
+
+/**************Msg_Queue**************/
+static Msg_Queue queue;
+
+static void benchQueue(){
+    msg_struct value_msg;
+    msg_struct array_msg;
+    int array[40] = {};
+    encodeMsg(&value_msg, 42);
+    encodeMsg(&array_msg, array, 40);
+
+    std::vector<double> add_samples, pop_samples, array_samples;
+    uint64_t add_total = 0, pop_total = 0, array_total = 0;
+
+    for(int round = 0; round < QUEUE_ROUNDS; round++){
+        uint64_t start = nowNs();
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            queue.add(&value_msg);
+        }
+        uint64_t elapsed = nowNs() - start;
+        add_total += elapsed;
+        add_samples.push_back((double)elapsed / QUEUE_BATCH);
+
+        start = nowNs();
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            keep(queue.pop<int>());
+        }
+        elapsed = nowNs() - start;
+        pop_total += elapsed;
+        pop_samples.push_back((double)elapsed / QUEUE_BATCH);
+
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            queue.add(&array_msg);
+        }
+        start = nowNs();
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            queue.popArray(array);
+            keep(array[0]);
+        }
+        elapsed = nowNs() - start;
+        array_total += elapsed;
+        array_samples.push_back((double)elapsed / QUEUE_BATCH);
+    }
+
+    uint64_t ops = (uint64_t)QUEUE_ROUNDS * QUEUE_BATCH;
+    report("queue.add", ops, add_total, add_samples);
+    report("queue.pop.int", ops, pop_total, pop_samples);
+    report("queue.pop_array.int40", ops, array_total, array_samples);
+}
+
+// The cost of a message that arrives at a full queue, for each OVERFLOW_POLICY
+static void benchQueueOverflow(const char* name, OVERFLOW_POLICY policy){
+    msg_struct value_msg;
+    encodeMsg(&value_msg, 42);
+    queue.setOverflowPolicy(policy);
+
+    std::vector<double> samples;
+    uint64_t total = 0;
+    for(int round = 0; round < QUEUE_ROUNDS; round++){
+        while(queue.freeSlots() > 0){
+            queue.add(&value_msg);
+        }
+
+        uint64_t start = nowNs();
+        for(int i = 0; i < MSG_QUEUE_CAPACITY; i++){
+            queue.add(&value_msg);
+        }
+        uint64_t elapsed = nowNs() - start;
+        total += elapsed;
+        samples.push_back((double)elapsed / MSG_QUEUE_CAPACITY);
+        queue.clear();
+    }
+    queue.setOverflowPolicy(DROP_NEWEST);
+    report(name, (uint64_t)QUEUE_ROUNDS * MSG_QUEUE_CAPACITY, total, samples);
+}
+
+// The receive path for a 200 byte frame: decoded into a slot, then read in place or copied out
+static void benchQueueFrames(){
+    uint8_t sensor[200] = {};
+    uint8_t output[200];
+    msg_struct msg;
+    int len = encodeMsg(&msg, sensor, 200);
+    uint8_t frame[ESPNOW_MTU];
+    memcpy(frame, &msg, len);
+
+    std::vector<double> add_samples, peek_samples, copy_samples;
+    uint64_t add_total = 0, peek_total = 0, copy_total = 0;
+
+    for(int round = 0; round < QUEUE_ROUNDS; round++){
+        uint64_t start = nowNs();
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            queue.add(frame, len);
+        }
+        uint64_t elapsed = nowNs() - start;
+        add_total += elapsed;
+        add_samples.push_back((double)elapsed / QUEUE_BATCH);
+
+        start = nowNs();
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            Msg_View view = queue.peek();
+            keep(view.data()[view.size() - 1]);
+        }
+        elapsed = nowNs() - start;
+        peek_total += elapsed;
+        peek_samples.push_back((double)elapsed / QUEUE_BATCH);
+
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            queue.add(frame, len);
+        }
+        start = nowNs();
+        for(int i = 0; i < QUEUE_BATCH; i++){
+            queue.popArray(output);
+            keep(output[199]);
+        }
+        elapsed = nowNs() - start;
+        copy_total += elapsed;
+        copy_samples.push_back((double)elapsed / QUEUE_BATCH);
+    }
+
+    uint64_t ops = (uint64_t)QUEUE_ROUNDS * QUEUE_BATCH;
+    report("queue.add_frame.200B", ops, add_total, add_samples);
+    report("queue.peek.200B", ops, peek_total, peek_samples);
+    report("queue.pop_array.200B", ops, copy_total, copy_samples);
+}
+
+// One thread adds like the receive callback, the other pops like loop()
+static void benchQueueThreads(){
+    std::vector<double> latencies;
+    latencies.reserve(SPSC_MESSAGES);
+
+    uint64_t start = nowNs();
+    std::thread producer([]{
+        msg_struct msg;
+        for(int i = 0; i < SPSC_MESSAGES; i++){
+            encodeMsg(&msg, nowNs());
+            while(!queue.add(&msg)){
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int received = 0;
+    while(received < SPSC_MESSAGES){
+        if(queue.isEmpty()){
+            std::this_thread::yield(); // Lets the producer run on a single core
+            continue;
+        }
+        uint64_t sent_at = queue.pop<uint64_t>();
+        latencies.push_back((double)(nowNs() - sent_at));
+        received++;
+    }
+    uint64_t elapsed = nowNs() - start;
+    producer.join();
+
+    report("queue.spsc_threads", SPSC_MESSAGES, elapsed, latencies);
+}
+/*************************************/
+
+/**************Codec**************/
+template<typename T>
+static void benchCodec(const char* type_name, const T& value){
+    std::string name;
+    msg_struct msg;
+    uint8_t frame[ESPNOW_MTU];
+    int len = encodeMsg(&msg, value);
+    memcpy(frame, &msg, len);
+
+    name = std::string("codec.encode.") + type_name;
+    timeBatches(name.c_str(), CODEC_BATCHES, CODEC_BATCH_SIZE, [&](int){
+        keep(encodeMsg(&msg, value));
+        keep(msg);
+    });
+
+    name = std::string("codec.decode.") + type_name;
+    timeBatches(name.c_str(), CODEC_BATCHES, CODEC_BATCH_SIZE, [&](int){
+        keep(decodeMsg(&msg, frame, len));
+        keep(msg);
+    });
+}
+
+template<typename T, int N>
+static void benchCodecArray(const char* type_name){
+    std::string name;
+    T values[N] = {};
+    msg_struct msg;
+    uint8_t frame[ESPNOW_MTU];
+    int len = encodeMsg(&msg, values, N);
+    memcpy(frame, &msg, len);
+
+    name = std::string("codec.encode.") + type_name;
+    timeBatches(name.c_str(), CODEC_BATCHES, CODEC_BATCH_SIZE, [&](int){
+        keep(encodeMsg(&msg, values, N));
+        keep(msg);
+    });
+
+    name = std::string("codec.decode.") + type_name;
+    timeBatches(name.c_str(), CODEC_BATCHES, CODEC_BATCH_SIZE, [&](int){
+        keep(decodeMsg(&msg, frame, len));
+        keep(msg);
+    });
+}
+
+static void benchCodecs(){
+    data value;
+    char text[] = "benchmark";
+    Set_Data_parameters(&value, 'b', text, 1, 2.0f, true);
+
+    benchCodec("int", (int)1);
+    benchCodec("short", (short)1);
+    benchCodec("long", (long)1);
+    benchCodec("float", 1.0f);
+    benchCodec("double", 1.0);
+    benchCodec("char", 'a');
+    benchCodec("bool", true);
+    benchCodec("data", value);
+    benchCodecArray<int, 40>("int40");
+    benchCodecArray<char, MSG_MAX_PAYLOAD>("char246");
+}
+/*********************************/
+
+/**************Peer lookup**************/
+static void benchPeerLookup(){
+    Peer_Table table(MAX_PEERS);
+    esp_now_peer_info_t info = {};
+    int ids[MAX_PEERS];
+
+    // Sparse IDs so the lookup can not just index an array
+    for(int i = 0; i < MAX_PEERS; i++){
+        ids[i] = 1000 + i * 7919;
+        info.peer_addr[5] = i;
+        table.add(ids[i], &info);
+    }
+
+    timeBatches("peers.find.hit", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        keep(table.find(ids[i % MAX_PEERS]));
+    });
+    timeBatches("peers.find.miss", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        keep(table.find(ids[i % MAX_PEERS] + 1));
+    });
+
+    // The receive callback finds the sender's queue by MAC, the boards usually share the vendor prefix
+    static Rx_Demux demux;
+    uint8_t macs[MAX_PEERS][MAC_LENGTH];
+    for(int i = 0; i < MAX_PEERS; i++){
+        uint8_t mac[MAC_LENGTH] = {0x24, 0x0A, 0xC4, 0x10, (uint8_t)(i * 37), (uint8_t)(i * 11)};
+        memcpy(macs[i], mac, MAC_LENGTH);
+        demux.open(i, ids[i], macs[i]);
+    }
+    uint8_t stranger[MAC_LENGTH] = {0x24, 0x0A, 0xC4, 0x20, 0x00, 0x00};
+
+    timeBatches("inboxes.find.hit", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        keep(demux.find(macs[i % MAX_PEERS]));
+    });
+    timeBatches("inboxes.find.miss", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        stranger[5] = i;
+        keep(demux.find(stranger));
+    });
+    demux.reset();
+}
+/***************************************/
+
+/**************Mailbox_Table**************/
+static Mailbox_Table mailboxes;
+
+// Overwriting the newest value of a (peer, type) pair and reading it, with every mailbox in use
+static void benchMailbox(){
+    struct state { float joints[6]; uint32_t battery; } value = {};
+    for(int key = 0; key < MAILBOX_CAPACITY; key++){
+        mailboxes.open(key, MSG_USER_TYPE_FIRST);
+    }
+    msg_struct msg;
+    msg.header.type = MSG_USER_TYPE_FIRST;
+    msg.header.length = sizeof(value);
+    memcpy(msg.payload, &value, sizeof(value));
+    const int last = MAILBOX_CAPACITY - 1;  // Found after every other mailbox
+
+    timeBatches("mailbox.write.28B", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        msg.payload[0] = (uint8_t)i;
+        keep(mailboxes.write(last, (const uint8_t*)&msg, MSG_HEADER_SIZE + sizeof(value)));
+    });
+    timeBatches("mailbox.latest.28B", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int){
+        uint32_t stamp;
+        keep(mailboxes.read(last, MSG_USER_TYPE_FIRST, &value, sizeof(value), &stamp));
+        keep(value.battery);
+    });
+    for(int key = 0; key < MAILBOX_CAPACITY; key++){
+        mailboxes.closeAll(key);
+    }
+}
+/***************************************/
+
+/**************Link_Stats_Table**************/
+static Link_Stats_Table link_table;
+
+static void benchLinkStats(){
+    wifi_pkt_rx_ctrl_t rx_ctrl = {};
+    rx_ctrl.noise_floor = -95;
+    link_stats snapshot;
+
+    timeBatches("link.record", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        rx_ctrl.rssi = -60 - (i & 15);
+        rx_ctrl.timestamp += 1000 + (i & 7) * 100;
+        link_table.record(MAX_PEERS - 1, &rx_ctrl);
+    });
+    timeBatches("link.snapshot", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int){
+        keep(link_table.snapshot(MAX_PEERS - 1, &snapshot));
+        keep(snapshot.rssi);
+    });
+}
+/********************************************/
+
+/**************Perf_Counters**************/
+static void benchMetrics(){
+    timeBatches("metrics.count", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        QEN_COUNT(PERF_BYTES_RECEIVED, i);
+    });
+    timeBatches("metrics.latency_sample", LOOKUP_BATCHES, CODEC_BATCH_SIZE, [&](int i){
+        QEN_LATENCY(PERF_RECEIVE_TO_READ, i * 97);
+    });
+    perf_snapshot snapshot;
+    Perf_Counters::snapshot(&snapshot);
+    char json[640];
+    timeBatches("metrics.json", LOOKUP_BATCHES / 10, 16, [&](int){
+        keep(Perf_Counters::toJson(&snapshot, json, sizeof(json)));
+    });
+    Perf_Counters::reset();
+}
+/*****************************************/
+
+/**************Lz_Codec**************/
+enum LZ_CORPUS {LZ_LOG, LZ_JSON, LZ_RANDOM};
+
+// Fills a buffer with a serial log dump, a JSON configuration blob or random bytes
+static void fillCorpus(LZ_CORPUS corpus, uint8_t* buffer, int size){
+    int used = 0;
+    srand(7);
+    for(int i = 0; used < size; i++){
+        char line[96];
+        int len;
+        if(corpus == LZ_LOG){
+            len = snprintf(line, sizeof(line), "[%lu] [Info] sensor %d read %d.%02d C, battery %d mV\n",
+                           120000ul + i * 20, i % 6, 20 + rand() % 5, rand() % 100, 3700 + rand() % 200);
+        }else if(corpus == LZ_JSON){
+            len = snprintf(line, sizeof(line), "{\"joint\": %d, \"kp\": %d.%d, \"ki\": 0.%02d, \"limit\": %d, \"enabled\": %s},",
+                           i, 1 + rand() % 9, rand() % 10, rand() % 100, 90 + i % 4 * 45, i % 3 ? "true" : "false");
+        }else{
+            line[0] = (char)rand();
+            len = 1;
+        }
+        len = std::min(len, size - used);
+        memcpy(buffer + used, line, len);
+        used += len;
+    }
+}
+
+// Compressing and restoring a corpus, as sendLarge() and the reassembler do for a fragmented message
+static void benchCompress(const char* corpus_name, LZ_CORPUS corpus){
+    static uint8_t input[LZ_CORPUS_SIZE];
+    static uint8_t packed[LZ_CORPUS_SIZE + LZ_CORPUS_SIZE / 8];
+    static uint8_t output[LZ_CORPUS_SIZE];
+    static Lz_Codec codec;
+    fillCorpus(corpus, input, LZ_CORPUS_SIZE);
+
+    // Without the capacity limit of sendLarge(), so random data is measured too
+    uint32_t packed_size = codec.compress(input, LZ_CORPUS_SIZE, packed, sizeof(packed));
+    std::string name = std::string("lz.compress.") + corpus_name;
+    uint64_t start = nowNs();
+    timeBatches(name.c_str(), LZ_BATCHES, 1, [&](int){
+        keep(codec.compress(input, LZ_CORPUS_SIZE, packed, sizeof(packed)));
+    });
+    double compress_mbps = (double)LZ_BATCHES * LZ_CORPUS_SIZE * 1e3 / (nowNs() - start);
+
+    bool restored = packed_size > 0 && Lz_Codec::decompress(packed, packed_size, output) &&
+                    memcmp(input, output, LZ_CORPUS_SIZE) == 0;
+    name = std::string("lz.decompress.") + corpus_name;
+    start = nowNs();
+    timeBatches(name.c_str(), LZ_BATCHES, 1, [&](int){
+        keep(Lz_Codec::decompress(packed, packed_size, output));
+    });
+    double decompress_mbps = (double)LZ_BATCHES * LZ_CORPUS_SIZE * 1e3 / (nowNs() - start);
+
+    // Peak RAM is the match table plus the compressed copy sendLarge() allocates
+    fprintf(stderr, "%-28s %12.2f ratio, %.0f / %.0f MB/s, %u bytes peak RAM, %s\n", "",
+            packed_size > 0 ? (double)LZ_CORPUS_SIZE / packed_size : 0.0, compress_mbps, decompress_mbps,
+            (unsigned)(sizeof(uint32_t) << COMPRESS_HASH_BITS) + LZ_CORPUS_SIZE - LZ_CORPUS_SIZE / 8,
+            !restored ? "RESTORED WRONG" : packed_size > LZ_CORPUS_SIZE - LZ_CORPUS_SIZE / 8 ? "sent raw" : "sent compressed");
+}
+/***************************************/
+
+/**************Send and receive**************/
+static uint8_t local_mac[MAC_LENGTH] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+static uint8_t node_mac[MAC_LENGTH] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x02};
+static uint8_t clock_mac[MAC_LENGTH] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x03};
+
+#define LOOPBACK_ID 1
+#define NODE_ID 2
+#define CLOCK_ID 3
+#define HOP_FIRST_ID 200            // ID of the first hop node, the others follow
+#define FANOUT_FIRST_ID 100         // ID of the first fan-out node, the others follow
+#define FANOUT_GROUP 1              // Group of the fan-out nodes
+
+/**
+ * @brief   Sets up the virtual radio, with no airtime and latency when ideal is set.
+ */
+static void configureRadio(bool ideal, float loss = 0.0f){
+    host_radio_config_t config;
+    host_radio_default_config(&config);
+    config.loss = loss;
+    if(ideal){
+        config.latency_us = 0;
+        config.overhead_us = 0;
+        config.bitrate_bps = 4000000000u;
+    }
+    config.driver_queue = 64;
+    host_radio_configure(&config);
+    host_radio_reset_stats();
+}
+
+// Cost of a Send call to an acknowledging node, lookup included
+static void benchSendCall(QuickESPNow& esp){
+    configureRadio(true);
+    std::vector<double> samples;
+    uint64_t total = 0;
+
+    for(int sent = 0; sent < SEND_MESSAGES; sent += SEND_WINDOW_LIMIT){
+        for(int i = 0; i < SEND_WINDOW_LIMIT; i++){
+            uint64_t start = nowNs();
+            esp.Send(NODE_ID, i);
+            uint64_t elapsed = nowNs() - start;
+            total += elapsed;
+            samples.push_back((double)elapsed);
+        }
+        host_radio_wait_idle(1000);
+    }
+    report("send.call", samples.size(), total, samples);
+}
+
+// The two ESP-NOW callbacks on their own, the receive queue and the log buffers are emptied between batches
+static void benchCallbacks(QuickESPNow& esp){
+    configureRadio(true);
+    msg_struct msg;
+    int len = encodeMsg(&msg, (uint64_t)42);
+    std::vector<double> recv_samples, sent_samples;
+    uint64_t recv_total = 0;
+    uint64_t sent_total = 0;
+
+    for(int b = 0; b < CALLBACK_BATCHES; b++){
+        uint64_t start = nowNs();
+        for(int i = 0; i < CALLBACK_BATCH_SIZE; i++){
+            host_radio_deliver(node_mac, (const uint8_t*)&msg, len);
+        }
+        uint64_t elapsed = nowNs() - start;
+        recv_total += elapsed;
+        recv_samples.push_back((double)elapsed / CALLBACK_BATCH_SIZE);
+
+        start = nowNs();
+        for(int i = 0; i < CALLBACK_BATCH_SIZE; i++){
+            host_radio_report_sent(node_mac, true);
+        }
+        elapsed = nowNs() - start;
+        sent_total += elapsed;
+        sent_samples.push_back((double)elapsed / CALLBACK_BATCH_SIZE);
+
+        uint64_t value;
+        while(esp.read(NODE_ID, value)){}
+        QEN_LOG_DRAIN(2 * LOG_BUFFER_CAPACITY);
+    }
+    report("callback.recv", (uint64_t)CALLBACK_BATCHES * CALLBACK_BATCH_SIZE, recv_total, recv_samples);
+    report("callback.sent", (uint64_t)CALLBACK_BATCHES * CALLBACK_BATCH_SIZE, sent_total, sent_samples);
+}
+
+// Messages sent to the local MAC come back through the receive callback
+static void benchLoopback(QuickESPNow& esp, const char* name, bool ideal){
+    configureRadio(ideal);
+    std::vector<double> latencies;
+    latencies.reserve(SEND_MESSAGES);
+
+    int sent = 0;
+    int received = 0;
+    uint64_t start = nowNs();
+    uint64_t last_progress = start;
+
+    while(received < SEND_MESSAGES){
+        if(sent < SEND_MESSAGES && sent - received < SEND_WINDOW_LIMIT){
+            esp.Send(LOOPBACK_ID, nowNs());
+            sent++;
+        }
+        esp.update();
+        while(esp.available()){
+            latencies.push_back((double)(nowNs() - esp.read<uint64_t>()));
+            received++;
+            last_progress = nowNs();
+        }
+        if(nowNs() - last_progress > 1000000000ull){
+            fprintf(stderr, "%s: %d of %d messages lost, stopping\n", name, sent - received, sent);
+            break; // A lost message would stall the window forever
+        }
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    report(name, received, elapsed, latencies);
+}
+
+// Arrays larger than a frame sent to the local MAC, one at a time, until they are read back
+static void benchLargeLoopback(QuickESPNow& esp, int size, bool ideal){
+    configureRadio(ideal);
+    static uint8_t message[LARGE_MAX_SIZE];
+    static uint8_t output[LARGE_MAX_SIZE];
+    for(int i = 0; i < size; i++){
+        message[i] = (uint8_t)i;
+    }
+
+    int messages = (ideal ? LARGE_BYTES_IDEAL : LARGE_BYTES_1MBPS) / size;
+    std::vector<double> latencies;
+    int received = 0;
+    uint64_t start = nowNs();
+
+    for(int i = 0; i < messages; i++){
+        uint64_t sent_at = nowNs();
+        esp.Send(LOOPBACK_ID, message, size);
+        while(!esp.available() && nowNs() - sent_at < 1000000000ull){
+            esp.update();
+            std::this_thread::yield();
+        }
+        if(!esp.available()){
+            fprintf(stderr, "fragment.%d: message %d lost, stopping\n", size, i);
+            break;
+        }
+        if(esp.data_size() == (size_t)size && esp.read_array(output)){
+            latencies.push_back((double)(nowNs() - sent_at));
+            received++;
+        }else{
+            esp.peek(); // The view drops whatever else arrived
+        }
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    // Throughput in bytes per second is ops_per_sec times the size in the name
+    char name[64];
+    snprintf(name, sizeof(name), "fragment.%dKB.%s", size / 1024, ideal ? "ideal_radio" : "1mbps_radio");
+    report(name, received, elapsed, latencies);
+    fprintf(stderr, "%-28s %12.0f KB/s\n", "", elapsed > 0 ? (double)received * size * 1e9 / elapsed / 1024 : 0.0);
+}
+
+// The log dump sent in fragments over the 1 Mbps radio, compressed or not
+static void benchCompressedLoopback(QuickESPNow& esp, const char* name, bool compressed){
+    configureRadio(false);
+    static uint8_t message[LZ_CORPUS_SIZE];
+    static uint8_t output[LZ_CORPUS_SIZE];
+    fillCorpus(LZ_LOG, message, LZ_CORPUS_SIZE);
+    if(compressed){
+        esp.enableCompression(LOOPBACK_ID);
+    }
+
+    std::vector<double> latencies;
+    uint64_t start = nowNs();
+    for(int i = 0; i < LZ_MESSAGES; i++){
+        uint64_t sent_at = nowNs();
+        esp.Send(LOOPBACK_ID, message, LZ_CORPUS_SIZE);
+        while(!esp.available() && nowNs() - sent_at < 1000000000ull){
+            esp.update();
+            std::this_thread::yield();
+        }
+        if(esp.data_size() == LZ_CORPUS_SIZE && esp.read_array(output) && memcmp(message, output, LZ_CORPUS_SIZE) == 0){
+            latencies.push_back((double)(nowNs() - sent_at));
+        }else{
+            esp.peek();
+        }
+    }
+    uint64_t elapsed = nowNs() - start;
+    esp.disableCompression(LOOPBACK_ID);
+
+    host_radio_stats_t stats;
+    host_radio_get_stats(&stats);
+    report(name, latencies.size(), elapsed, latencies);
+    fprintf(stderr, "%-28s %12.0f KB/s, %.1f frames per message\n", "",
+            elapsed > 0 ? (double)latencies.size() * LZ_CORPUS_SIZE * 1e9 / elapsed / 1024 : 0.0,
+            (double)stats.frames_sent / LZ_MESSAGES);
+}
+
+// Reliable loopback over the lossy 1 Mbps radio, a window of 1 is stop-and-wait
+static void benchReliable(QuickESPNow& esp, const char* name, int window){
+    configureRadio(false, RELIABLE_LOSS);
+    esp.enableReliable(LOOPBACK_ID, window);
+    std::vector<double> latencies;
+    latencies.reserve(RELIABLE_MESSAGES);
+
+    int sent = 0;
+    int received = 0;
+    int out_of_order = 0;
+    uint64_t start = nowNs();
+    uint64_t last_progress = start;
+
+    while(received < RELIABLE_MESSAGES){
+        if(sent < RELIABLE_MESSAGES && esp.unacknowledged(LOOPBACK_ID) < window){
+            uint64_t message[2] = {(uint64_t)sent, nowNs()};
+            esp.Send(LOOPBACK_ID, message, 2);
+            sent++;
+        }
+        esp.update();
+        uint64_t message[2];
+        while(esp.available()){
+            esp.read_array(message);
+            out_of_order += message[0] != (uint64_t)received;
+            latencies.push_back((double)(nowNs() - message[1]));
+            received++;
+            last_progress = nowNs();
+        }
+        if(nowNs() - last_progress > 2000000000ull){
+            fprintf(stderr, "%s: %d of %d messages lost, stopping\n", name, sent - received, sent);
+            break;
+        }
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    // Wait for the last acknowledgments so the next benchmark starts clean
+    while(esp.unacknowledged(LOOPBACK_ID) > 0 && nowNs() - last_progress < 2000000000ull){
+        esp.update();
+    }
+    esp.disableReliable(LOOPBACK_ID);
+
+    host_radio_stats_t stats;
+    host_radio_get_stats(&stats);
+    report(name, received, elapsed, latencies);
+    fprintf(stderr, "%-28s %12.2f frames per message, %d out of order\n", "",
+            received > 0 ? (double)stats.frames_sent / received : 0.0, out_of_order);
+}
+
+// Latency of probe messages while bulk messages saturate the transmit scheduler and the receive queue
+static void benchPriority(QuickESPNow& esp, const char* name, MSG_PRIORITY probe_priority){
+    configureRadio(false);
+    esp.enableTxScheduler(0, 8);
+    std::vector<double> latencies;
+    latencies.reserve(PRIORITY_PROBES);
+
+    int probes = 0;
+    uint64_t start = nowNs();
+    uint64_t next_probe = start;
+    uint64_t next_read = start;
+    uint64_t last_progress = start;
+
+    while((int)latencies.size() < PRIORITY_PROBES){
+        uint64_t now = nowNs();
+        if(probes < PRIORITY_PROBES && now >= next_probe){
+            uint64_t probe[2] = {1, now};
+            esp.Send(LOOPBACK_ID, probe, 2, probe_priority);
+            probes++;
+            next_probe += PRIORITY_PROBE_US * 1000ull;
+        }else{
+            uint64_t bulk[2] = {0, now};
+            esp.Send(LOOPBACK_ID, bulk, 2); // Dropped while the scheduler is full
+        }
+        esp.update();
+
+        // A slow reader, so the receive queue stays full of bulk messages
+        if(nowNs() >= next_read){
+            next_read = nowNs() + PRIORITY_READ_US * 1000ull;
+            uint64_t message[2];
+            if(esp.read_array(message) && message[0] == 1){
+                latencies.push_back((double)(nowNs() - message[1]));
+                last_progress = nowNs();
+            }
+        }
+        if(nowNs() - last_progress > 2000000000ull){
+            fprintf(stderr, "%s: %d of %d probes lost, stopping\n", name, probes - (int)latencies.size(), probes);
+            break;
+        }
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    esp.disableTxScheduler();
+    host_radio_wait_idle(1000);
+    while(esp.available()){
+        esp.update();
+        uint64_t message[2];
+        esp.read_array(message);
+    }
+    report(name, latencies.size(), elapsed, latencies);
+    fprintf(stderr, "%-28s %12.0f ns worst case\n", "", latencies.empty() ? 0.0 : latencies.back());
+}
+
+// A 50 Hz telemetry trace of the data struct: the counter changes every message, the float every 5th,
+// the status text every 100th and the flag every 250th
+static data telemetryAt(int i){
+    data sample = {};
+    sample.type = 'd';
+    snprintf(sample.msg_char, STRING_LENGTH, (i / 100) % 2 ? "state: RUNNING" : "state: IDLE");
+    sample.msg_int = i;
+    sample.msg_float = 3.5f + (i / 5) * 0.25f;
+    sample.msg_bool = (i / 250) % 2;
+    return sample;
+}
+
+// The telemetry trace sent whole or delta encoded over the 1 Mbps radio, one message at a time
+static void benchDelta(QuickESPNow& esp, const char* name, bool delta){
+    configureRadio(false);
+    host_radio_config_t config;
+    host_radio_default_config(&config);
+    if(delta){
+        esp.enableDelta(LOOPBACK_ID);
+    }
+
+    std::vector<double> latencies;
+    int wrong = 0;
+    uint64_t start = nowNs();
+    for(int i = 0; i < DELTA_TRACE_MESSAGES; i++){
+        uint64_t sent_at = nowNs();
+        esp.Send(LOOPBACK_ID, telemetryAt(i));
+        while(!esp.available() && nowNs() - sent_at < 100000000ull){
+            esp.update();
+        }
+        if(esp.available()){
+            latencies.push_back((double)(nowNs() - sent_at));
+            data sample = esp.read<data>();
+            data expected = telemetryAt(sample.msg_int);
+            wrong += memcmp(&sample, &expected, sizeof(data)) != 0;
+        }
+    }
+    uint64_t elapsed = nowNs() - start;
+    esp.disableDelta(LOOPBACK_ID);
+
+    host_radio_stats_t stats;
+    host_radio_get_stats(&stats);
+    double airtime = stats.frames_sent > 0 ? (double)stats.airtime_us[1] / stats.frames_sent : 0.0;
+    report(name, latencies.size(), elapsed, latencies);
+    fprintf(stderr, "%-28s %12.1f bytes per frame, %.0f us airtime per frame, %d rebuilt wrong\n", "",
+            (airtime - config.overhead_us) * config.bitrate_bps / 8e6, airtime, wrong);
+}
+static uint8_t fanout_macs[FANOUT_NODES][MAC_LENGTH];
+static std::atomic<int> fanout_received(0);
+
+// A fan-out node counts the setpoints and, like a member that joined the group, replies to the group frames that ask for it
+static void fanoutNodeRecv(void* arg, const uint8_t* src_mac, const uint8_t* data, int len){
+    if(len >= GROUP_OVERHEAD && ((const msg_header*)data)->type == MSG_GROUP_TYPE){
+        group_header group;
+        memcpy(&group, data + MSG_HEADER_SIZE, sizeof(group_header));
+        if(group.flags & GROUP_FLAG_REPLY){
+            return;
+        }
+        if(group.flags & GROUP_FLAG_ACK){
+            uint8_t reply[GROUP_OVERHEAD];
+            memcpy(reply, data, MSG_HEADER_SIZE);
+            group.flags = GROUP_FLAG_REPLY;
+            memcpy(reply + MSG_HEADER_SIZE, &group, sizeof(group_header));
+            host_radio_node_send(fanout_macs[(intptr_t)arg], src_mac, reply, GROUP_OVERHEAD);
+        }
+    }
+    fanout_received.fetch_add(1, std::memory_order_relaxed);
+}
+
+// A setpoint pushed to FANOUT_NODES nodes over the 1 Mbps radio, as one Send per node or one group frame,
+// until every node has it (or has acknowledged it)
+static void benchFanout(QuickESPNow& esp, const char* name, bool group, bool acked){
+    configureRadio(false);
+    if(acked){
+        esp.enableGroupAcks(FANOUT_GROUP);
+    }
+
+    std::vector<double> latencies;
+    uint64_t start = nowNs();
+    for(int i = 0; i < FANOUT_ROUNDS; i++){
+        uint64_t sent_at = nowNs();
+        fanout_received.store(0, std::memory_order_relaxed);
+        float setpoint = i * 0.5f;
+        if(group){
+            esp.sendGroup(FANOUT_GROUP, setpoint);
+        }else{
+            for(int node = 0; node < FANOUT_NODES; node++){
+                esp.Send(FANOUT_FIRST_ID + node, setpoint);
+            }
+        }
+        auto done = [&](){
+            return acked ? esp.groupDelivered(FANOUT_GROUP) : fanout_received.load(std::memory_order_relaxed) == FANOUT_NODES;
+        };
+        while(!done() && nowNs() - sent_at < 100000000ull){
+            esp.update();
+        }
+        if(done()){
+            latencies.push_back((double)(nowNs() - sent_at));
+        }
+        host_radio_wait_idle(100);
+    }
+    uint64_t elapsed = nowNs() - start;
+    esp.disableGroupAcks(FANOUT_GROUP);
+
+    host_radio_stats_t stats;
+    host_radio_get_stats(&stats);
+    report(name, latencies.size(), elapsed, latencies);
+    fprintf(stderr, "%-28s %12.1f frames per setpoint, %.0f us airtime per setpoint\n", "",
+            (double)stats.frames_sent / FANOUT_ROUNDS, (double)stats.airtime_us[1] / FANOUT_ROUNDS);
+}
+
+static std::vector<double> dispatch_latencies;     // Written by the dispatch task only
+static std::atomic<int> dispatch_received(0);
+
+static void onStamp(int from, const uint64_t& sent_at){
+    (void)from;
+    dispatch_latencies.push_back((double)(nowNs() - sent_at));
+    dispatch_received.fetch_add(1, std::memory_order_release);
+}
+
+static void busyWait(uint64_t us){
+    uint64_t until = nowNs() + us * 1000;
+    while(nowNs() < until){
+    }
+}
+
+// A loop that does DISPATCH_WORK_US of other work per pass, a message arrives at a different point of each pass
+// and is read by the loop after its work or by a handler on the dispatch task
+static void benchDispatch(QuickESPNow& esp, const char* name, bool handler){
+    configureRadio(true);
+    std::vector<double> latencies;
+    if(handler){
+        dispatch_latencies.clear();
+        dispatch_latencies.reserve(DISPATCH_MESSAGES);
+        dispatch_received.store(0, std::memory_order_relaxed);
+        esp.onMessage<uint64_t>(onStamp);
+    }
+
+    uint64_t start = nowNs();
+    for(int i = 0; i < DISPATCH_MESSAGES; i++){
+        uint64_t phase = (i * 37) % DISPATCH_WORK_US;
+        busyWait(phase);
+        esp.Send(LOOPBACK_ID, nowNs());
+        busyWait(DISPATCH_WORK_US - phase);
+        esp.update();
+        while(esp.available()){
+            latencies.push_back((double)(nowNs() - esp.read<uint64_t>()));
+        }
+    }
+    host_radio_wait_idle(100);
+    uint64_t waited = nowNs();
+    while(handler && dispatch_received.load(std::memory_order_acquire) < DISPATCH_MESSAGES && nowNs() - waited < 100000000ull){
+        delay(1);
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    if(handler){
+        esp.removeHandler<uint64_t>();
+        dispatch_received.load(std::memory_order_acquire);
+        latencies.insert(latencies.end(), dispatch_latencies.begin(), dispatch_latencies.end());
+    }
+    report(name, latencies.size(), elapsed, latencies);
+}
+
+static uint64_t threadCpuNs(){
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+// A node sends WAIT_MESSAGES stamps 2 to 5 ms apart, read by a loop that polls with a delay or blocks in waitRead
+static void benchWait(QuickESPNow& esp, const char* name, bool blocking){
+    configureRadio(true);
+    std::thread node([](){
+        for(int i = 0; i < WAIT_MESSAGES; i++){
+            std::this_thread::sleep_for(std::chrono::microseconds(2000 + (i * 7919) % 3000));
+            msg_struct msg;
+            int len = encodeMsg(&msg, nowNs());
+            host_radio_node_send(node_mac, local_mac, (const uint8_t*)&msg, len);
+        }
+    });
+
+    std::vector<double> latencies;
+    uint64_t start = nowNs();
+    uint64_t cpu_start = threadCpuNs();
+    uint64_t sent_at;
+    while(latencies.size() < WAIT_MESSAGES && nowNs() - start < 10000000000ull){
+        if(blocking){
+            if(esp.waitRead(NODE_ID, sent_at, 100)){
+                latencies.push_back((double)(nowNs() - sent_at));
+            }
+        }else{
+            while(esp.read(NODE_ID, sent_at)){
+                latencies.push_back((double)(nowNs() - sent_at));
+            }
+            delay(WAIT_POLL_MS);
+        }
+    }
+    uint64_t cpu = threadCpuNs() - cpu_start;
+    uint64_t elapsed = nowNs() - start;
+    node.join();
+
+    report(name, latencies.size(), elapsed, latencies);
+    fprintf(stderr, "%-28s %12.2f%% of a core used by the reading loop\n", "", 100.0 * cpu / elapsed);
+}
+
+static const uint8_t hop_channels[HOP_NODES] = {1, 6};
+static uint8_t hop_macs[HOP_NODES][MAC_LENGTH];
+static double hop_latencies[HOP_MESSAGES];          // Written by the radio thread, read once hop_received is complete
+static std::atomic<int> hop_received(0);
+
+// A hop node stamps the time each message took from Send
+static void hopNodeRecv(void* arg, const uint8_t* src_mac, const uint8_t* data, int len){
+    (void)arg;
+    (void)src_mac;
+    uint64_t message[2];
+    if(len == MSG_HEADER_SIZE + (int)sizeof(message)){
+        memcpy(message, data + MSG_HEADER_SIZE, sizeof(message));
+        hop_latencies[message[0] % HOP_MESSAGES] = (double)(nowNs() - message[1]);
+        hop_received.fetch_add(1, std::memory_order_release);
+    }
+}
+
+// Messages sent round-robin to nodes on channels 1 and 6 over the 1 Mbps radio, each Send hopping on its own
+// (with the blocking settle of setChannel) or queued in the transmit scheduler that drains a channel before hopping
+static void benchChannelHops(QuickESPNow& esp, const char* name, bool scheduled){
+    configureRadio(false);
+    host_radio_config_t config;
+    host_radio_default_config(&config);
+    config.switch_us = HOP_SWITCH_US;
+    config.driver_queue = 64;
+    host_radio_configure(&config);
+    if(scheduled){
+        esp.enableTxScheduler(HOP_SWITCH_US / 1000, 8);
+    }
+    hop_received.store(0, std::memory_order_relaxed);
+
+    int sent = 0;
+    uint64_t start = nowNs();
+    while(hop_received.load(std::memory_order_acquire) < HOP_MESSAGES && nowNs() - start < 30000000000ull){
+        if(sent < HOP_MESSAGES && sent - hop_received.load(std::memory_order_acquire) < SEND_WINDOW_LIMIT){
+            uint64_t message[2] = {(uint64_t)sent, nowNs()};
+            esp.Send(HOP_FIRST_ID + sent % HOP_NODES, message, 2);
+            sent++;
+        }
+        esp.update();
+    }
+    uint64_t elapsed = nowNs() - start;
+    if(scheduled){
+        esp.disableTxScheduler();
+    }
+    host_radio_wait_idle(1000);
+    esp.setChannel(1); // The other benchmarks follow the current channel
+
+    host_radio_stats_t stats;
+    host_radio_get_stats(&stats);
+    int received = hop_received.load(std::memory_order_acquire);
+    std::vector<double> latencies(hop_latencies, hop_latencies + std::min(received, HOP_MESSAGES));
+    report(name, received, elapsed, latencies);
+    fprintf(stderr, "%-28s %12.1f channel switches per second, %.1f messages per second\n", "",
+            stats.channel_switches * 1e9 / elapsed, received * 1e9 / elapsed);
+}
+
+static int clock_pings = 0;         // Written by the radio thread only
+
+// The clock node answers the pings on a clock CLOCK_SKEW_US ahead, every other pong is held after it was stamped,
+// like a pong stuck behind other frames in the driver, which makes the way back look longer than the way there
+static void clockNodeRecv(void* arg, const uint8_t* src_mac, const uint8_t* data, int len){
+    (void)arg;
+    if(len != CLOCK_OVERHEAD || ((const msg_header*)data)->type != MSG_CLOCK_TYPE){
+        return;
+    }
+    clock_probe probe;
+    memcpy(&probe, data + MSG_HEADER_SIZE, sizeof(clock_probe));
+    if(probe.flags & CLOCK_FLAG_PONG){
+        return;
+    }
+    probe.flags = CLOCK_FLAG_PONG;
+    probe.received = esp_timer_get_time() + CLOCK_SKEW_US;
+    clock_pings++;
+
+    uint8_t pong[CLOCK_OVERHEAD];
+    memcpy(pong, data, MSG_HEADER_SIZE);
+    probe.transmitted = esp_timer_get_time() + CLOCK_SKEW_US;
+    memcpy(pong + MSG_HEADER_SIZE, &probe, sizeof(clock_probe));
+    if(clock_pings & 1){
+        busyWait((clock_pings * 7919) % CLOCK_HOLD_MAX_US);
+    }
+    host_radio_node_send(clock_mac, src_mac, pong, CLOCK_OVERHEAD);
+}
+
+// Pings to the clock node over the 1 Mbps radio, one at a time, with the error of the offset of the newest
+// round trip against the error of the offset chosen by the filter
+static void benchClockSync(QuickESPNow& esp){
+    configureRadio(false);
+    std::vector<double> round_trips;
+    std::vector<double> unfiltered;
+    std::vector<double> filtered;
+    clock_stats clock = {};
+
+    uint64_t start = nowNs();
+    for(int i = 0; i < CLOCK_ROUNDS; i++){
+        uint32_t samples = clock.samples;
+        uint64_t sent_at = nowNs();
+        esp.ping(CLOCK_ID);
+        while(!(esp.peerLatency(CLOCK_ID, clock) && clock.samples > samples) && nowNs() - sent_at < 100000000ull){
+            esp.update();
+        }
+        if(clock.samples > samples){
+            round_trips.push_back((double)(nowNs() - sent_at));
+            unfiltered.push_back(1000.0 * std::abs(clock.last_offset_us - CLOCK_SKEW_US));
+            filtered.push_back(1000.0 * std::abs(clock.offset_us - CLOCK_SKEW_US));
+        }
+        host_radio_wait_idle(100);
+    }
+    uint64_t elapsed = nowNs() - start;
+
+    report("clock.round_trip", round_trips.size(), elapsed, round_trips);
+    fprintf(stderr, "%-28s %12u us rtt p50, %u us p99 over the newest CLOCK_SAMPLES round trips\n", "",
+            clock.rtt_p50_us, clock.rtt_p99_us);
+    report("clock.offset_error.newest", unfiltered.size(), elapsed, unfiltered);
+    report("clock.offset_error.filtered", filtered.size(), elapsed, filtered);
+}
+/********************************************/
+
+int main(int argc, char** argv){
+    benchQueue();
+    benchQueueOverflow("queue.overflow.drop_newest", DROP_NEWEST);
+    benchQueueOverflow("queue.overflow.drop_oldest", DROP_OLDEST);
+    benchQueueOverflow("queue.overflow.coalesce", COALESCE_TYPE);
+    benchQueueFrames();
+    benchQueueThreads();
+    benchCodecs();
+    benchPeerLookup();
+    benchMailbox();
+    benchLinkStats();
+    benchMetrics();
+    benchCompress("log16KB", LZ_LOG);
+    benchCompress("json16KB", LZ_JSON);
+    benchCompress("random16KB", LZ_RANDOM);
+
+    host_radio_add_node(node_mac, 1, nullptr, nullptr);
+    host_radio_add_node(clock_mac, 1, clockNodeRecv, nullptr);
+    QuickESPNow esp(TWO_WAY_COMMUNICATION, 3 + FANOUT_NODES + HOP_NODES, local_mac);
+    esp.begin();
+    esp.addPeer(LOOPBACK_ID, local_mac, 0, WIFI_IF_STA);
+    esp.addPeer(NODE_ID, node_mac, 0, WIFI_IF_STA);
+    esp.addPeer(CLOCK_ID, clock_mac, 0, WIFI_IF_STA);
+    for(int node = 0; node < FANOUT_NODES; node++){
+        uint8_t mac[MAC_LENGTH] = {0x24, 0x0A, 0xC4, 0x00, 0x01, (uint8_t)node};
+        memcpy(fanout_macs[node], mac, MAC_LENGTH);
+        host_radio_add_node(fanout_macs[node], 1, fanoutNodeRecv, (void*)(intptr_t)node);
+        esp.addPeer(FANOUT_FIRST_ID + node, fanout_macs[node], 0, WIFI_IF_STA);
+        esp.addToGroup(FANOUT_GROUP, FANOUT_FIRST_ID + node);
+    }
+    for(int node = 0; node < HOP_NODES; node++){
+        uint8_t mac[MAC_LENGTH] = {0x24, 0x0A, 0xC4, 0x00, 0x02, (uint8_t)node};
+        memcpy(hop_macs[node], mac, MAC_LENGTH);
+        host_radio_add_node(hop_macs[node], hop_channels[node], hopNodeRecv, nullptr);
+        esp.addPeer(HOP_FIRST_ID + node, hop_macs[node], hop_channels[node], WIFI_IF_STA);
+    }
+
+    benchSendCall(esp);
+    benchCallbacks(esp);
+    benchLoopback(esp, "loopback.ideal_radio", true);
+    benchLoopback(esp, "loopback.1mbps_radio", false);
+
+    esp.enableFragmentation(LARGE_MAX_SIZE + FRAG_BLOCK_SIZE, 500);
+    for(bool ideal : {true, false}){
+        for(int size : {1024, 4096, 16384, 65536}){
+            benchLargeLoopback(esp, size, ideal);
+        }
+    }
+    benchCompressedLoopback(esp, "fragment.log16KB.raw", false);
+    benchCompressedLoopback(esp, "fragment.log16KB.compressed", true);
+
+    benchReliable(esp, "reliable.loss10.stop_and_wait", 1);
+    benchReliable(esp, "reliable.loss10.window8", 8);
+
+    benchPriority(esp, "priority.normal_under_load", PRIORITY_NORMAL);
+    benchPriority(esp, "priority.urgent_under_load", PRIORITY_URGENT);
+
+    benchDelta(esp, "delta.telemetry.whole", false);
+    benchDelta(esp, "delta.telemetry.delta", true);
+
+    benchFanout(esp, "fanout8.unicast", false, false);
+    benchFanout(esp, "fanout8.group", true, false);
+    benchFanout(esp, "fanout8.group_acked", true, true);
+
+    benchDispatch(esp, "dispatch.polled_1ms_loop", false);
+    benchDispatch(esp, "dispatch.handler", true);
+
+    benchWait(esp, "wait.poll_delay10ms", false);
+    benchWait(esp, "wait.blocking", true);
+
+    benchClockSync(esp);
+
+    benchChannelHops(esp, "channels2.send_each", false);
+    benchChannelHops(esp, "channels2.tx_scheduler", true);
+
+    FILE* out = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if(out == nullptr){
+        fprintf(stderr, "can not open %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(out, "{\n  \"benchmark\": \"QuickESPNow\",\n  \"compiler\": \"%s\",\n  \"log_level\": %d,\n"
+                 "  \"msg_queue_capacity\": %d,\n  \"max_peers\": %d,\n  \"results\": [%s\n  ]\n}\n",
+            __VERSION__, QUICKESPNOW_LOG_LEVEL, MSG_QUEUE_CAPACITY, MAX_PEERS, results.c_str());
+    if(out != stdout){
+        fclose(out);
+    }
+    return 0;
+}
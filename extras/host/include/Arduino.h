@@ -0,0 +1,125 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_Arduino_h
+#define Host_Arduino_h
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+
+///< The host backend behaves like arduino-esp32 3.x, define ESP_ARDUINO_VERSION to build against 2.0.17
+#define ESP_ARDUINO_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#ifndef ESP_ARDUINO_VERSION
+#define ESP_ARDUINO_VERSION ESP_ARDUINO_VERSION_VAL(3, 0, 0)
+#endif
+
+#define DEC 10
+#define HEX 16
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define LED_BUILTIN 2
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+/**
+ * @class   String
+ * @brief   The parts of the Arduino String used by the library and the examples, on top of std::string.
+ */
+class String : public std::string {
+    public:
+        String() {}
+        String(const char* text) : std::string(text != nullptr ? text : "") {}
+        String(const std::string& text) : std::string(text) {}
+        String(char ch) : std::string(1, ch) {}
+        String(int value, int base = DEC) : String((long)value, base) {}
+        String(unsigned int value, int base = DEC) : String((unsigned long)value, base) {}
+        String(long value, int base = DEC);
+        String(unsigned long value, int base = DEC);
+        String(double value, int decimals = 2);
+
+        unsigned int length() const { return (unsigned int)size(); }
+        String substring(unsigned int from) const { return substring(from, length()); }
+        String substring(unsigned int from, unsigned int to) const;
+        int indexOf(char ch, unsigned int from = 0) const;
+        bool equals(const String& other) const { return compare(other) == 0; }
+        bool concat(const String& other) { append(other); return true; }
+        long toInt() const { return strtol(c_str(), nullptr, 10); }
+        float toFloat() const { return strtof(c_str(), nullptr); }
+        void toUpperCase();
+        void toLowerCase();
+
+        String& operator+=(const String& other) { append(other); return *this; }
+        String& operator+=(const char* other) { append(other); return *this; }
+        String& operator+=(char ch) { push_back(ch); return *this; }
+        String& operator+=(int value) { append(String(value)); return *this; }
+};
+
+/**
+ * @class   HostSerial
+ * @brief   Serial port that writes to the standard output.
+ */
+class HostSerial {
+    public:
+        void begin(unsigned long baud) { (void)baud; }
+        void end() {}
+        void flush();
+        int availableForWrite() { return 128; }
+        int available() { return 0; }
+        int read() { return -1; }
+        size_t write(uint8_t ch);
+        size_t write(const uint8_t* buffer, size_t size);
+        size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+        size_t print(const String& text) { return write((const uint8_t*)text.c_str(), text.size()); }
+        size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+        size_t print(char ch) { return write((uint8_t)ch); }
+        size_t print(int value, int base = DEC) { return print(String(value, base)); }
+        size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+        size_t print(long value, int base = DEC) { return print(String(value, base)); }
+        size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+        size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+        size_t println() { return print("\n"); }
+        template<typename T>
+        size_t println(const T& value) { size_t n = print(value); return n + println(); }
+        template<typename T>
+        size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+
+        operator bool() const { return true; }
+};
+
+extern HostSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// GPIO has no meaning on the host, the pins keep their last written value
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+#endif
@@ -0,0 +1,50 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_WiFi_h
+#define Host_WiFi_h
+
+#include "Arduino.h"
+#include "esp_wifi.h"
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+#define WIFI_AP WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+/**
+ * @class   HostWiFi
+ * @brief   The parts of the Arduino WiFi object used by the library, on top of the esp_wifi calls.
+ */
+class HostWiFi {
+    public:
+        bool mode(wifi_mode_t mode) { return esp_wifi_set_mode(mode) == ESP_OK; }
+        wifi_mode_t getMode();
+        String macAddress();
+        uint8_t* macAddress(uint8_t* mac);
+        int32_t channel();
+        bool setChannel(uint8_t primary, wifi_second_chan_t secondary = WIFI_SECOND_CHAN_NONE) {
+            return esp_wifi_set_channel(primary, secondary) == ESP_OK;
+        }
+    #if ESP_ARDUINO_VERSION < ESP_ARDUINO_VERSION_VAL(3, 0, 0)
+        int32_t channel(int primary) { setChannel((uint8_t)primary); return channel(); } // How the library switches on 2.0.17
+    #endif
+        bool disconnect(bool wifioff = false, bool eraseap = false) { (void)wifioff; (void)eraseap; return true; }
+};
+
+extern HostWiFi WiFi;
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_esp_err_h
+#define Host_esp_err_h
+
+#include <cstdint>
+
+typedef int esp_err_t;
+
+///< Error codes returned by the host backend, same values as ESP-IDF
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_ESPNOW_BASE 0x3064
+#define ESP_ERR_ESPNOW_NOT_INIT (ESP_ERR_ESPNOW_BASE + 1)  ///< ESP-NOW is not initialized
+#define ESP_ERR_ESPNOW_ARG (ESP_ERR_ESPNOW_BASE + 2)       ///< Invalid argument
+#define ESP_ERR_ESPNOW_NO_MEM (ESP_ERR_ESPNOW_BASE + 3)    ///< The transmit queue of the driver is full
+#define ESP_ERR_ESPNOW_FULL (ESP_ERR_ESPNOW_BASE + 4)      ///< The peer list is full
+#define ESP_ERR_ESPNOW_NOT_FOUND (ESP_ERR_ESPNOW_BASE + 5) ///< The peer is not found
+#define ESP_ERR_ESPNOW_INTERNAL (ESP_ERR_ESPNOW_BASE + 6)  ///< Internal error
+#define ESP_ERR_ESPNOW_EXIST (ESP_ERR_ESPNOW_BASE + 7)     ///< The peer has already been added
+#define ESP_ERR_ESPNOW_IF (ESP_ERR_ESPNOW_BASE + 8)        ///< Interface error
+#define ESP_ERR_ESPNOW_CHAN (ESP_ERR_ESPNOW_BASE + 9)      ///< The peer is on another channel
+
+#endif
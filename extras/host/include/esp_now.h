@@ -0,0 +1,91 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_esp_now_h
+#define Host_esp_now_h
+
+#include <cstddef>
+#include <cstdint>
+#include "Arduino.h"
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+#define ESP_NOW_ETH_ALEN 6              ///< Length of a MAC address
+#define ESP_NOW_KEY_LEN 16              ///< Length of the PMK and LMK
+#define ESP_NOW_MAX_TOTAL_PEER_NUM 20   ///< Maximum number of peers
+#define ESP_NOW_MAX_ENCRYPT_PEER_NUM 6  ///< Maximum number of encrypted peers
+#define ESP_NOW_MAX_DATA_LEN 250        ///< Maximum length of a frame
+
+typedef enum {
+    ESP_NOW_SEND_SUCCESS = 0,           ///< The destination acknowledged the frame
+    ESP_NOW_SEND_FAIL                   ///< The frame was not acknowledged
+} esp_now_send_status_t;
+
+/**
+ * @brief   Information about a peer
+ */
+typedef struct {
+    uint8_t peer_addr[ESP_NOW_ETH_ALEN];    ///< MAC address of the peer.
+    uint8_t lmk[ESP_NOW_KEY_LEN];           ///< Local master key of the peer.
+    uint8_t channel;                        ///< Channel of the peer, 0 for the current channel.
+    wifi_interface_t ifidx;                 ///< Interface used to reach the peer.
+    bool encrypt;                           ///< Whether the frames to the peer are encrypted.
+    void* priv;                             ///< User data.
+} esp_now_peer_info_t;
+
+/**
+ * @brief   Number of peers
+ */
+typedef struct {
+    int total_num;                          ///< Number of peers.
+    int encrypt_num;                        ///< Number of encrypted peers.
+} esp_now_peer_num_t;
+
+/**
+ * @brief   Information about a received frame
+ */
+typedef struct {
+    uint8_t* src_addr;                      ///< MAC address of the source.
+    uint8_t* des_addr;                      ///< MAC address of the destination.
+    wifi_pkt_rx_ctrl_t* rx_ctrl;            ///< Metadata of the frame.
+} esp_now_recv_info_t;
+
+typedef wifi_tx_info_t esp_now_send_info_t;
+
+#if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
+typedef void (*esp_now_recv_cb_t)(const esp_now_recv_info_t* info, const uint8_t* data, int data_len);
+typedef void (*esp_now_send_cb_t)(const esp_now_send_info_t* tx_info, esp_now_send_status_t status);
+#else
+typedef void (*esp_now_recv_cb_t)(const uint8_t* mac_addr, const uint8_t* data, int data_len);
+typedef void (*esp_now_send_cb_t)(const uint8_t* mac_addr, esp_now_send_status_t status);
+#endif
+
+esp_err_t esp_now_init();
+esp_err_t esp_now_deinit();
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb);
+esp_err_t esp_now_unregister_recv_cb();
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb);
+esp_err_t esp_now_unregister_send_cb();
+esp_err_t esp_now_send(const uint8_t* peer_addr, const uint8_t* data, size_t len);
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer);
+esp_err_t esp_now_del_peer(const uint8_t* peer_addr);
+esp_err_t esp_now_mod_peer(const esp_now_peer_info_t* peer);
+esp_err_t esp_now_get_peer(const uint8_t* peer_addr, esp_now_peer_info_t* peer);
+esp_err_t esp_now_get_peer_num(esp_now_peer_num_t* num);
+bool esp_now_is_peer_exist(const uint8_t* peer_addr);
+esp_err_t esp_now_set_pmk(const uint8_t* pmk);
+
+#endif
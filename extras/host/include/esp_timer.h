@@ -0,0 +1,28 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_esp_timer_h
+#define Host_esp_timer_h
+
+#include <cstdint>
+
+/**
+ * @brief   Gives the time since the program started.
+ * @return  The time in microseconds
+ */
+int64_t esp_timer_get_time();
+
+#endif
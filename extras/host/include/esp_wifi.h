@@ -0,0 +1,92 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_esp_wifi_h
+#define Host_esp_wifi_h
+
+#include <cstdint>
+#include "esp_err.h"
+
+typedef enum {
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP = 1
+} wifi_interface_t;
+
+typedef enum {
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA
+} wifi_mode_t;
+
+typedef enum {
+    WIFI_SECOND_CHAN_NONE = 0,
+    WIFI_SECOND_CHAN_ABOVE,
+    WIFI_SECOND_CHAN_BELOW
+} wifi_second_chan_t;
+
+/**
+ * @brief   Metadata of a received frame, filled in by the virtual radio
+ */
+typedef struct {
+    signed rssi:8;                  ///< Received signal strength (dBm).
+    unsigned rate:5;                ///< PHY rate of the frame.
+    unsigned :1;
+    unsigned sig_mode:2;            ///< 0: non HT (11bg) frame.
+    unsigned :16;
+    unsigned mcs:7;
+    unsigned cwb:1;
+    unsigned :16;
+    unsigned smoothing:1;
+    unsigned not_sounding:1;
+    unsigned :1;
+    unsigned aggregation:1;
+    unsigned stbc:2;
+    unsigned fec_coding:1;
+    unsigned sgi:1;
+    signed noise_floor:8;           ///< Noise floor (dBm).
+    unsigned ampdu_cnt:8;
+    unsigned channel:4;             ///< Channel the frame was received on.
+    unsigned secondary_channel:4;
+    unsigned :8;
+    unsigned timestamp:32;          ///< Time (us) the frame was received.
+    unsigned :32;
+    unsigned :31;
+    unsigned ant:1;
+    unsigned sig_len:12;            ///< Length of the frame.
+    unsigned :12;
+    unsigned rx_state:8;
+} wifi_pkt_rx_ctrl_t;
+
+/**
+ * @brief   Transmit information given to the send callback
+ */
+typedef struct {
+    const uint8_t* des_addr;        ///< MAC address of the destination.
+    const uint8_t* src_addr;        ///< MAC address of the source.
+    wifi_interface_t ifidx;         ///< Interface the frame was sent from.
+    uint8_t* data;                  ///< The frame.
+    uint16_t data_len;              ///< Length of the frame.
+} wifi_tx_info_t;
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_get_mode(wifi_mode_t* mode);
+esp_err_t esp_wifi_set_mac(wifi_interface_t ifx, const uint8_t mac[6]);
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]);
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second);
+esp_err_t esp_wifi_get_channel(uint8_t* primary, wifi_second_chan_t* second);
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_semphr_h
+#define Host_semphr_h
+
+#include "FreeRTOS.h"
+
+struct host_semaphore;
+typedef host_semaphore* SemaphoreHandle_t;
+
+/**
+ * @brief   Creates a binary semaphore, empty until it is given.
+ * @return  The semaphore
+ */
+SemaphoreHandle_t xSemaphoreCreateBinary();
+
+/**
+ * @brief   Gives a semaphore, waking a task that waits in xSemaphoreTake.
+ * @return  pdTRUE, pdFALSE if the binary semaphore was already given
+ */
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+/**
+ * @brief   Takes a semaphore, waiting for it to be given.
+ * @param   ticks_to_wait The maximum time to wait (ms), portMAX_DELAY to wait forever
+ * @return  pdTRUE, pdFALSE on timeout
+ */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+
+/**
+ * @brief   Frees a semaphore that no task waits for.
+ */
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_task_h
+#define Host_task_h
+
+#include "FreeRTOS.h"
+
+struct host_task;
+typedef host_task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+/**
+ * @brief   Starts a task on its own thread, the priority, stack size and core are ignored.
+ * @return  pdPASS, the handle stays valid after the task deletes itself
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+
+/**
+ * @brief   Starts a task on its own thread, the priority and stack size are ignored.
+ */
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle);
+
+/**
+ * @brief   Ends the calling task, only NULL (the calling task) is supported on the host.
+ */
+void vTaskDelete(TaskHandle_t task);
+
+/**
+ * @brief   Gives the handle of the calling task, a thread not started with xTaskCreate gets one on first use.
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+/**
+ * @brief   Increments the notification value of a task, waking it if it waits in ulTaskNotifyTake.
+ */
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+/**
+ * @brief   Waits for the notification value of the calling task to be non-zero.
+ * @param   clear_on_exit pdTRUE to zero the value, pdFALSE to decrement it
+ * @param   ticks_to_wait The maximum time to wait (ms), portMAX_DELAY to wait forever
+ * @return  The value before it was cleared or decremented, 0 on timeout
+ */
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+
+/**
+ * @brief   Sleeps for a number of ticks (ms).
+ */
+void vTaskDelay(TickType_t ticks);
+
+#endif
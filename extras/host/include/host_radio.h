@@ -0,0 +1,155 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef Host_radio_h
+#define Host_radio_h
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+#define HOST_RADIO_MAX_NODES 32         ///< Maximum number of virtual nodes besides the local one
+#define HOST_RADIO_MAX_CHANNEL 14       ///< Highest channel of the virtual radio
+
+/**
+ * @brief   Parameters of the virtual radio
+ * @note    A frame occupies its channel for overhead_us + 8 * length / bitrate seconds. Frames on the same
+ *          channel are sent one after the other, frames on different channels do not wait for each other.
+ */
+typedef struct {
+    float loss;                         ///< Probability (0-1) that a frame does not reach a receiver.
+    uint32_t latency_us;                ///< Delay between the end of the transmission and the callbacks.
+    uint32_t bitrate_bps;               ///< PHY rate used for the payload.
+    uint32_t overhead_us;               ///< Fixed airtime of a frame (preamble, headers, ACK).
+    uint32_t switch_us;                 ///< Time the local radio is deaf and mute after a channel change.
+    int driver_queue;                   ///< Frames the driver holds before esp_now_send returns ESP_ERR_ESPNOW_NO_MEM.
+    int8_t rssi;                        ///< Mean RSSI (dBm) reported to the receivers.
+    uint8_t rssi_jitter;                ///< Maximum deviation (dB) from the mean RSSI.
+    uint32_t seed;                      ///< Seed of the loss and RSSI generator.
+} host_radio_config_t;
+
+/**
+ * @brief   Counters of the virtual radio
+ */
+typedef struct {
+    uint32_t frames_sent;                               ///< Frames put on the air.
+    uint32_t frames_lost;                               ///< Frame copies dropped by loss or a channel mismatch.
+    uint32_t frames_delivered;                          ///< Frame copies given to a receiver.
+    uint32_t frames_refused;                            ///< Calls to esp_now_send that returned an error.
+    uint32_t channel_switches;                          ///< Channel changes of the local radio.
+    uint64_t airtime_us[HOST_RADIO_MAX_CHANNEL + 1];    ///< Time each channel was busy.
+} host_radio_stats_t;
+
+/**
+ * @brief   Callback of a virtual node for a received frame (runs in the radio thread)
+ * @param   arg The argument given to host_radio_add_node
+ * @param   src_mac MAC address of the sender
+ * @param   data The frame
+ * @param   len The length of the frame
+ */
+typedef void (*host_node_recv_cb_t)(void* arg, const uint8_t* src_mac, const uint8_t* data, int len);
+
+/**
+ * @brief   Fills a configuration with the defaults: no loss, 1 Mbps, 200 us latency.
+ * @param   config The configuration to be filled
+ */
+void host_radio_default_config(host_radio_config_t* config);
+
+/**
+ * @brief   Changes the parameters of the virtual radio, frames already on the air keep the old ones.
+ * @param   config The new parameters
+ */
+void host_radio_configure(const host_radio_config_t* config);
+
+/**
+ * @brief   Adds a virtual node that receives and acknowledges the frames sent to its MAC address.
+ * @param   mac The MAC address of the node
+ * @param   channel The channel the node listens to
+ * @param   recv Callback for the received frames, nullptr to only acknowledge them
+ * @param   arg Argument passed to the callback
+ * @return
+ *          - ESP_OK : the node was added
+ *          - ESP_ERR_INVALID_ARG : the MAC address is in use or the channel is invalid
+ *          - ESP_FAIL : there are already HOST_RADIO_MAX_NODES nodes
+ */
+esp_err_t host_radio_add_node(const uint8_t* mac, uint8_t channel, host_node_recv_cb_t recv, void* arg);
+
+/**
+ * @brief   Removes a virtual node.
+ * @param   mac The MAC address of the node
+ */
+void host_radio_remove_node(const uint8_t* mac);
+
+/**
+ * @brief   Moves a virtual node to another channel.
+ * @param   mac The MAC address of the node
+ * @param   channel The new channel
+ */
+void host_radio_set_node_channel(const uint8_t* mac, uint8_t channel);
+
+/**
+ * @brief   Sends a frame from a virtual node on its channel, the local node receives it through ESP-NOW.
+ * @param   src_mac The MAC address of the node
+ * @param   dst_mac The destination, FF:FF:FF:FF:FF:FF for every node on the channel
+ * @param   data The frame
+ * @param   len The length of the frame
+ * @return
+ *          - ESP_OK : the frame is on the air
+ *          - ESP_ERR_ESPNOW_ARG : the node does not exist or the frame is longer than 250 bytes
+ */
+esp_err_t host_radio_node_send(const uint8_t* src_mac, const uint8_t* dst_mac, const uint8_t* data, size_t len);
+
+/**
+ * @brief   Calls the local receive callback in the calling thread, as if a node had sent the frame.
+ * @note    The frame skips the air, the loss and the channel check. Used to time the callback on its own.
+ * @param   src_mac The MAC address of the sender
+ * @param   data The frame
+ * @param   len The length of the frame
+ * @return
+ *          - ESP_OK : the callback returned
+ *          - ESP_ERR_ESPNOW_NOT_INIT : ESP-NOW is not initialized or has no receive callback
+ */
+esp_err_t host_radio_deliver(const uint8_t* src_mac, const uint8_t* data, size_t len);
+
+/**
+ * @brief   Calls the local send callback in the calling thread, as if a frame had been acknowledged or lost.
+ * @param   dst_mac The destination of the frame
+ * @param   acked Whether the frame was acknowledged
+ * @return
+ *          - ESP_OK : the callback returned
+ *          - ESP_ERR_ESPNOW_NOT_INIT : ESP-NOW is not initialized or has no send callback
+ */
+esp_err_t host_radio_report_sent(const uint8_t* dst_mac, bool acked);
+
+/**
+ * @brief   Waits until every frame on the air has been delivered and acknowledged.
+ * @param   timeout_ms The maximum time to wait
+ * @return  Whether the radio became idle in time
+ */
+bool host_radio_wait_idle(uint32_t timeout_ms);
+
+/**
+ * @brief   Copies the counters of the virtual radio.
+ * @param   stats Where the counters are copied
+ */
+void host_radio_get_stats(host_radio_stats_t* stats);
+
+/**
+ * @brief   Zeroes the counters of the virtual radio.
+ */
+void host_radio_reset_stats();
+
+#endif
@@ -0,0 +1,266 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <cctype>
+#include <cstdarg>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+HostSerial Serial;
+
+/**************Time**************/
+int64_t esp_timer_get_time(){
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long millis(){
+    return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros(){
+    return (unsigned long)esp_timer_get_time();
+}
+
+void delay(unsigned long ms){
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us){
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield(){
+    std::this_thread::yield();
+}
+/********************************/
+
+/**************GPIO**************/
+static uint8_t pin_values[64];
+
+void pinMode(uint8_t pin, uint8_t mode){
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value){
+    if(pin < sizeof(pin_values)){
+        pin_values[pin] = value;
+    }
+}
+
+int digitalRead(uint8_t pin){
+    return pin < sizeof(pin_values) ? pin_values[pin] : LOW;
+}
+/********************************/
+
+/**************String**************/
+String::String(long value, int base){
+    if(base == DEC){
+        assign(std::to_string(value));
+    }else{
+        *this = String((unsigned long)value, base);
+    }
+}
+
+String::String(unsigned long value, int base){
+    if(base < 2 || base > 36){
+        base = DEC;
+    }
+    do{
+        int digit = value % base;
+        insert(begin(), (char)(digit < 10 ? '0' + digit : 'A' + digit - 10));
+        value /= base;
+    }while(value > 0);
+}
+
+String::String(double value, int decimals){
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    assign(text);
+}
+
+String String::substring(unsigned int from, unsigned int to) const{
+    if(from > to){
+        unsigned int temp = from;
+        from = to;
+        to = temp;
+    }
+    if(from >= length()){
+        return String();
+    }
+    return String(substr(from, to - from));
+}
+
+int String::indexOf(char ch, unsigned int from) const{
+    size_t found = find(ch, from);
+    return found == npos ? -1 : (int)found;
+}
+
+void String::toUpperCase(){
+    for(char& ch : *this){
+        ch = (char)toupper((unsigned char)ch);
+    }
+}
+
+void String::toLowerCase(){
+    for(char& ch : *this){
+        ch = (char)tolower((unsigned char)ch);
+    }
+}
+/**********************************/
+
+/**************Serial**************/
+size_t HostSerial::write(uint8_t ch){
+    return fputc(ch, stdout) == EOF ? 0 : 1;
+}
+
+size_t HostSerial::write(const uint8_t* buffer, size_t size){
+    return fwrite(buffer, 1, size, stdout);
+}
+
+size_t HostSerial::printf(const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written < 0 ? 0 : (size_t)written;
+}
+
+void HostSerial::flush(){
+    fflush(stdout);
+}
+/**********************************/
+
+/**************FreeRTOS tasks and semaphores**************/
+/**
+ * @struct  host_task
+ * @brief   A FreeRTOS task played by a detached thread, never freed so a stale handle stays safe to notify.
+ */
+struct host_task {
+    std::mutex lock;                        ///< Guards the notification value.
+    std::condition_variable notified;       ///< Wakes the task waiting in ulTaskNotifyTake.
+    uint32_t notifications = 0;             ///< The notification value.
+};
+
+// Thrown by vTaskDelete(NULL) to unwind the task's thread
+struct host_task_exit {};
+
+static thread_local host_task* current_task = nullptr;
+
+// The threads not started by xTaskCreate (main, the radio thread) get a task on first use, like loopTask on the ESP32
+static host_task* self(){
+    if(current_task == nullptr){
+        current_task = new host_task();
+    }
+    return current_task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core){
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+    (void)core;
+    host_task* task = new host_task();
+    if(handle != nullptr){
+        *handle = task;
+    }
+    std::thread([code, arg, task](){
+        current_task = task;
+        try{
+            code(arg);
+        }catch(const host_task_exit&){
+        }
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle){
+    return xTaskCreatePinnedToCore(code, name, stack_depth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task){
+    if(task == nullptr || task == current_task){
+        throw host_task_exit();
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(){
+    return self();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task){
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait){
+    host_task* task = self();
+    std::unique_lock<std::mutex> guard(task->lock);
+    auto ready = [task](){ return task->notifications > 0; };
+    if(ticks_to_wait == portMAX_DELAY){
+        task->notified.wait(guard, ready);
+    }else if(!task->notified.wait_for(guard, std::chrono::milliseconds(ticks_to_wait), ready)){
+        return 0;
+    }
+    uint32_t value = task->notifications;
+    task->notifications = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+void vTaskDelay(TickType_t ticks){
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+/**
+ * @struct  host_semaphore
+ * @brief   A binary semaphore.
+ */
+struct host_semaphore {
+    std::mutex lock;                        ///< Guards the state.
+    std::condition_variable given;          ///< Wakes the task waiting in xSemaphoreTake.
+    bool available = false;                 ///< Whether the semaphore was given and not taken yet.
+};
+
+SemaphoreHandle_t xSemaphoreCreateBinary(){
+    return new host_semaphore();
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore){
+    {
+        std::lock_guard<std::mutex> guard(semaphore->lock);
+        if(semaphore->available){
+            return pdFALSE;
+        }
+        semaphore->available = true;
+    }
+    semaphore->given.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait){
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    auto ready = [semaphore](){ return semaphore->available; };
+    if(ticks_to_wait == portMAX_DELAY){
+        semaphore->given.wait(guard, ready);
+    }else if(!semaphore->given.wait_for(guard, std::chrono::milliseconds(ticks_to_wait), ready)){
+        return pdFALSE;
+    }
+    semaphore->available = false;
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore){
+    delete semaphore;
+}
+/*********************************************************/
@@ -0,0 +1,29 @@
+#include <WiFi.h>
+
+HostWiFi WiFi;
+
+wifi_mode_t HostWiFi::getMode(){
+    wifi_mode_t mode = WIFI_MODE_NULL;
+    esp_wifi_get_mode(&mode);
+    return mode;
+}
+
+String HostWiFi::macAddress(){
+    uint8_t mac[6];
+    char text[18];
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return String(text);
+}
+
+uint8_t* HostWiFi::macAddress(uint8_t* mac){
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    return mac;
+}
+
+int32_t HostWiFi::channel(){
+    uint8_t primary = 0;
+    wifi_second_chan_t secondary;
+    esp_wifi_get_channel(&primary, &secondary);
+    return primary;
+}
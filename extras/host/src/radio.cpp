@@ -0,0 +1,703 @@
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include <host_radio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define LOCAL_NODE -1   // Receiver index of the node that runs the library
+
+/**
+ * @brief   A virtual node added with host_radio_add_node
+ */
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];      ///< MAC address of the node.
+    uint8_t channel;                    ///< Channel the node listens to.
+    host_node_recv_cb_t recv;           ///< Callback for the received frames.
+    void* arg;                          ///< Argument of the callback.
+    bool used;                          ///< Whether the entry holds a node.
+} radio_node;
+
+enum RADIO_EVENT {
+    EVENT_DELIVER,      ///< A copy of a frame reaches a receiver
+    EVENT_SENT          ///< A frame of the local node is done, its send callback is due
+};
+
+/**
+ * @brief   Something the radio thread has to do at a given time
+ */
+typedef struct {
+    uint64_t at;                            ///< Time (us) of the event.
+    uint64_t seq;                           ///< Order of events that share a time.
+    RADIO_EVENT kind;                       ///< What happens.
+    uint32_t generation;                    ///< ESP-NOW session of a local frame, stale after esp_now_deinit.
+    int receiver;                           ///< Index of the receiving node, LOCAL_NODE for the local one.
+    uint8_t src[ESP_NOW_ETH_ALEN];          ///< MAC address of the sender.
+    uint8_t dst[ESP_NOW_ETH_ALEN];          ///< MAC address the frame was sent to.
+    uint8_t channel;                        ///< Channel the frame was sent on.
+    bool acked;                             ///< Send status of a local frame.
+    int8_t rssi;                            ///< RSSI reported to the receiver.
+    int len;                                ///< Length of the frame.
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];     ///< The frame.
+} radio_event;
+
+struct radio_event_later {
+    bool operator()(const radio_event& a, const radio_event& b) const {
+        return a.at != b.at ? a.at > b.at : a.seq > b.seq;
+    }
+};
+
+static const uint8_t broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+/**************State of the virtual radio, guarded by radio_lock**************/
+static std::mutex radio_lock;
+static std::condition_variable radio_wake;     // The radio thread has new work
+static std::condition_variable radio_idle;     // The radio thread ran out of work
+static std::priority_queue<radio_event, std::vector<radio_event>, radio_event_later> events;
+static std::thread radio_thread;
+static bool running = false;
+static bool dispatching = false;
+static uint64_t next_seq = 0;
+
+static host_radio_config_t config = {0.0f, 200, 1000000, 850, 0, 16, -50, 0, 1};
+static host_radio_stats_t stats = {};
+static std::mt19937 rng(1);
+static uint64_t busy_until[HOST_RADIO_MAX_CHANNEL + 1] = {};
+static radio_node nodes[HOST_RADIO_MAX_NODES] = {};
+
+// The local node
+static uint8_t local_mac[ESP_NOW_ETH_ALEN] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+static uint8_t local_channel = 1;
+static wifi_mode_t local_mode = WIFI_MODE_NULL;
+static uint64_t switch_until = 0;
+
+// ESP-NOW on the local node
+static bool initialized = false;
+static uint32_t generation = 0;
+static esp_now_recv_cb_t recv_cb = nullptr;
+static esp_now_send_cb_t send_cb = nullptr;
+static esp_now_peer_info_t peers[ESP_NOW_MAX_TOTAL_PEER_NUM];
+static bool peer_used[ESP_NOW_MAX_TOTAL_PEER_NUM] = {};
+static int in_driver = 0;
+/*****************************************************************************/
+
+static uint64_t now_us(){
+    return (uint64_t)esp_timer_get_time();
+}
+
+static bool sameMAC(const uint8_t* a, const uint8_t* b){
+    return memcmp(a, b, ESP_NOW_ETH_ALEN) == 0;
+}
+
+static int findNode(const uint8_t* mac){
+    for(int i = 0; i < HOST_RADIO_MAX_NODES; i++){
+        if(nodes[i].used && sameMAC(nodes[i].mac, mac)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int findPeer(const uint8_t* mac){
+    for(int i = 0; i < ESP_NOW_MAX_TOTAL_PEER_NUM; i++){
+        if(peer_used[i] && sameMAC(peers[i].peer_addr, mac)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool rollLoss(){
+    return config.loss > 0.0f && std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) < config.loss;
+}
+
+static int8_t rollRSSI(){
+    if(config.rssi_jitter == 0){
+        return config.rssi;
+    }
+    return (int8_t)(config.rssi + std::uniform_int_distribution<int>(-config.rssi_jitter, config.rssi_jitter)(rng));
+}
+
+/**
+ * @brief   Body of the radio thread, plays the role of the WiFi task and runs every callback.
+ */
+static void radioLoop(){
+    std::unique_lock<std::mutex> guard(radio_lock);
+
+    while(running){
+        if(events.empty()){
+            radio_idle.notify_all();
+            radio_wake.wait(guard);
+            continue;
+        }
+
+        uint64_t now = now_us();
+        if(events.top().at > now){
+            radio_wake.wait_for(guard, std::chrono::microseconds(events.top().at - now));
+            continue;
+        }
+
+        radio_event ev = events.top();
+        events.pop();
+        dispatching = true;
+
+        if(ev.kind == EVENT_SENT){
+            if(ev.generation != generation){
+                dispatching = false;
+                continue; // Sent before esp_now_deinit
+            }
+            in_driver--;
+            esp_now_send_cb_t cb = send_cb;
+
+            guard.unlock();
+            if(cb != nullptr){
+            #if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
+                esp_now_send_info_t tx_info = {ev.dst, ev.src, WIFI_IF_STA, ev.data, (uint16_t)ev.len};
+                cb(&tx_info, ev.acked ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+            #else
+                cb(ev.dst, ev.acked ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+            #endif
+            }
+            guard.lock();
+        }else if(ev.receiver == LOCAL_NODE){
+            // The local radio must still be on the channel and not in the middle of a switch
+            esp_now_recv_cb_t cb = recv_cb;
+            if(!initialized || cb == nullptr || local_channel != ev.channel || ev.at < switch_until){
+                stats.frames_lost++;
+                dispatching = false;
+                continue;
+            }
+            stats.frames_delivered++;
+
+            guard.unlock();
+        #if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
+            wifi_pkt_rx_ctrl_t rx_ctrl = {};
+            rx_ctrl.rssi = ev.rssi;
+            rx_ctrl.noise_floor = -95;
+            rx_ctrl.channel = ev.channel;
+            rx_ctrl.timestamp = (uint32_t)ev.at;
+            rx_ctrl.sig_len = ev.len;
+            esp_now_recv_info_t info = {ev.src, ev.dst, &rx_ctrl};
+            cb(&info, ev.data, ev.len);
+        #else
+            cb(ev.src, ev.data, ev.len);
+        #endif
+            guard.lock();
+        }else{
+            radio_node* node = &nodes[ev.receiver];
+            if(!node->used || node->channel != ev.channel){
+                stats.frames_lost++;
+                dispatching = false;
+                continue;
+            }
+            stats.frames_delivered++;
+            host_node_recv_cb_t cb = node->recv;
+            void* arg = node->arg;
+
+            guard.unlock();
+            if(cb != nullptr){
+                cb(arg, ev.src, ev.data, ev.len);
+            }
+            guard.lock();
+        }
+        dispatching = false;
+    }
+}
+
+/**
+ * @brief   Starts the radio thread if it is not running (radio_lock held).
+ */
+static void startRadio(){
+    if(!running){
+        if(radio_thread.joinable()){
+            radio_thread.join();
+        }
+        running = true;
+        radio_thread = std::thread(radioLoop);
+    }
+}
+
+/**
+ * @brief   Stops the radio thread and drops the frames on the air (radio_lock not held).
+ */
+static void stopRadio(){
+    {
+        std::lock_guard<std::mutex> guard(radio_lock);
+        running = false;
+        events = decltype(events)();
+        dispatching = false;
+    }
+    radio_wake.notify_all();
+    radio_idle.notify_all();
+
+    if(radio_thread.joinable()){
+        if(radio_thread.get_id() == std::this_thread::get_id()){
+            radio_thread.detach(); // Called from a callback, the loop ends on its own
+        }else{
+            radio_thread.join();
+        }
+    }
+}
+
+// Stops the radio thread when the program exits
+static struct radio_shutdown {
+    ~radio_shutdown(){
+        stopRadio();
+    }
+} shutdown_radio;
+
+/**
+ * @brief   Puts a frame on the air and schedules its delivery (radio_lock held).
+ * @param   sender Index of the sending node, LOCAL_NODE for the local one
+ * @return  Whether a unicast frame will be acknowledged, always true for broadcast
+ */
+static bool transmit(int sender, const uint8_t* src, const uint8_t* dst, uint8_t channel, const uint8_t* data, int len){
+    // Frames on one channel go out one after the other
+    uint64_t start = std::max(now_us(), busy_until[channel]);
+    if(sender == LOCAL_NODE){
+        start = std::max(start, switch_until);
+    }
+    uint64_t airtime = config.overhead_us + (uint64_t)len * 8 * 1000000 / config.bitrate_bps;
+    busy_until[channel] = start + airtime;
+    stats.airtime_us[channel] += airtime;
+    stats.frames_sent++;
+
+    radio_event ev;
+    ev.at = start + airtime + config.latency_us;
+    ev.kind = EVENT_DELIVER;
+    ev.generation = generation;
+    memcpy(ev.src, src, ESP_NOW_ETH_ALEN);
+    memcpy(ev.dst, dst, ESP_NOW_ETH_ALEN);
+    ev.channel = channel;
+    ev.acked = false;
+    ev.len = len;
+    memcpy(ev.data, data, len);
+
+    bool broadcast = sameMAC(dst, broadcast_mac);
+    bool acked = false;
+
+    // Frames sent to the local MAC come back to the local node, which makes loopback tests possible
+    if(broadcast ? sender != LOCAL_NODE : sameMAC(dst, local_mac)){
+        if(rollLoss()){
+            stats.frames_lost++;
+        }else{
+            ev.receiver = LOCAL_NODE;
+            ev.rssi = rollRSSI();
+            ev.seq = next_seq++;
+            events.push(ev);
+            acked = local_channel == channel;
+        }
+    }
+
+    for(int i = 0; i < HOST_RADIO_MAX_NODES; i++){
+        if(!nodes[i].used || i == sender || !(broadcast || sameMAC(dst, nodes[i].mac))){
+            continue;
+        }
+        if(rollLoss()){
+            stats.frames_lost++;
+            continue;
+        }
+        ev.receiver = i;
+        ev.rssi = rollRSSI();
+        ev.seq = next_seq++;
+        events.push(ev);
+        acked = acked || nodes[i].channel == channel;
+    }
+
+    if(sender == LOCAL_NODE){
+        ev.kind = EVENT_SENT;
+        ev.acked = broadcast || acked;
+        ev.seq = next_seq++;
+        events.push(ev);
+        in_driver++;
+    }
+
+    startRadio();
+    radio_wake.notify_one();
+    return broadcast || acked;
+}
+
+/**************esp_wifi**************/
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    local_mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mode(wifi_mode_t* mode){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    *mode = local_mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mac(wifi_interface_t ifx, const uint8_t mac[6]){
+    (void)ifx; // The virtual radio has one interface
+    if(mac == nullptr || (mac[0] & 0x01)){
+        return ESP_ERR_INVALID_ARG; // Multicast addresses can not be used
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    memcpy(local_mac, mac, ESP_NOW_ETH_ALEN);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]){
+    (void)ifx;
+    std::lock_guard<std::mutex> guard(radio_lock);
+    memcpy(mac, local_mac, ESP_NOW_ETH_ALEN);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second){
+    (void)second; // ESP-NOW uses 20 MHz channels
+    if(primary < 1 || primary > HOST_RADIO_MAX_CHANNEL){
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    if(primary != local_channel){
+        local_channel = primary;
+        switch_until = now_us() + config.switch_us;
+        stats.channel_switches++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_channel(uint8_t* primary, wifi_second_chan_t* second){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    *primary = local_channel;
+    *second = WIFI_SECOND_CHAN_NONE;
+    return ESP_OK;
+}
+/************************************/
+
+/**************esp_now**************/
+esp_err_t esp_now_init(){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_deinit(){
+    {
+        std::lock_guard<std::mutex> guard(radio_lock);
+        initialized = false;
+        generation++;
+        recv_cb = nullptr;
+        send_cb = nullptr;
+        memset(peer_used, 0, sizeof(peer_used));
+        in_driver = 0;
+    }
+    stopRadio();
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    if(!initialized){
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    recv_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_unregister_recv_cb(){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    recv_cb = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    if(!initialized){
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    send_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_unregister_send_cb(){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    send_cb = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_send(const uint8_t* peer_addr, const uint8_t* data, size_t len){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    if(!initialized){
+        stats.frames_refused++;
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if(data == nullptr || len == 0 || len > ESP_NOW_MAX_DATA_LEN){
+        stats.frames_refused++;
+        return ESP_ERR_ESPNOW_ARG;
+    }
+
+    // Without an address the frame goes to every peer
+    int first = 0;
+    int last = ESP_NOW_MAX_TOTAL_PEER_NUM - 1;
+    if(peer_addr != nullptr){
+        first = last = findPeer(peer_addr);
+        if(first == -1){
+            stats.frames_refused++;
+            return ESP_ERR_ESPNOW_NOT_FOUND;
+        }
+    }
+
+    for(int i = first; i <= last; i++){
+        if(!peer_used[i] || (peer_addr == nullptr && sameMAC(peers[i].peer_addr, broadcast_mac))){
+            continue;
+        }
+        if(peers[i].channel != 0 && peers[i].channel != local_channel){
+            stats.frames_refused++;
+            return ESP_ERR_ESPNOW_CHAN;
+        }
+        if(in_driver >= config.driver_queue){
+            stats.frames_refused++;
+            return ESP_ERR_ESPNOW_NO_MEM;
+        }
+        transmit(LOCAL_NODE, local_mac, peers[i].peer_addr, local_channel, data, (int)len);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer){
+    if(peer == nullptr || peer->channel > HOST_RADIO_MAX_CHANNEL){
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    if(!initialized){
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if(findPeer(peer->peer_addr) != -1){
+        return ESP_ERR_ESPNOW_EXIST;
+    }
+
+    int free_slot = -1;
+    int encrypted = 0;
+    for(int i = 0; i < ESP_NOW_MAX_TOTAL_PEER_NUM; i++){
+        if(!peer_used[i]){
+            free_slot = free_slot == -1 ? i : free_slot;
+        }else if(peers[i].encrypt){
+            encrypted++;
+        }
+    }
+    if(free_slot == -1 || (peer->encrypt && encrypted >= ESP_NOW_MAX_ENCRYPT_PEER_NUM)){
+        return ESP_ERR_ESPNOW_FULL;
+    }
+
+    peers[free_slot] = *peer;
+    peer_used[free_slot] = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t* peer_addr){
+    if(peer_addr == nullptr){
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    int i = findPeer(peer_addr);
+    if(i == -1){
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    peer_used[i] = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_mod_peer(const esp_now_peer_info_t* peer){
+    if(peer == nullptr || peer->channel > HOST_RADIO_MAX_CHANNEL){
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    int i = findPeer(peer->peer_addr);
+    if(i == -1){
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    peers[i] = *peer;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_get_peer(const uint8_t* peer_addr, esp_now_peer_info_t* peer){
+    if(peer_addr == nullptr || peer == nullptr){
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    int i = findPeer(peer_addr);
+    if(i == -1){
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    *peer = peers[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_now_get_peer_num(esp_now_peer_num_t* num){
+    if(num == nullptr){
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    num->total_num = 0;
+    num->encrypt_num = 0;
+    for(int i = 0; i < ESP_NOW_MAX_TOTAL_PEER_NUM; i++){
+        if(peer_used[i]){
+            num->total_num++;
+            num->encrypt_num += peers[i].encrypt ? 1 : 0;
+        }
+    }
+    return ESP_OK;
+}
+
+bool esp_now_is_peer_exist(const uint8_t* peer_addr){
+    if(peer_addr == nullptr){
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    return findPeer(peer_addr) != -1;
+}
+
+esp_err_t esp_now_set_pmk(const uint8_t* pmk){
+    return pmk == nullptr ? ESP_ERR_ESPNOW_ARG : ESP_OK;
+}
+/***********************************/
+
+/**************host_radio**************/
+void host_radio_default_config(host_radio_config_t* cfg){
+    cfg->loss = 0.0f;
+    cfg->latency_us = 200;
+    cfg->bitrate_bps = 1000000;
+    cfg->overhead_us = 850;     // Long preamble, MAC header, SIFS and ACK at 1 Mbps
+    cfg->switch_us = 0;
+    cfg->driver_queue = 16;
+    cfg->rssi = -50;
+    cfg->rssi_jitter = 0;
+    cfg->seed = 1;
+}
+
+void host_radio_configure(const host_radio_config_t* cfg){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    config = *cfg;
+    if(config.bitrate_bps == 0){
+        config.bitrate_bps = 1000000;
+    }
+    rng.seed(config.seed);
+}
+
+esp_err_t host_radio_add_node(const uint8_t* mac, uint8_t channel, host_node_recv_cb_t recv, void* arg){
+    if(mac == nullptr || channel < 1 || channel > HOST_RADIO_MAX_CHANNEL){
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    if(findNode(mac) != -1 || sameMAC(mac, local_mac)){
+        return ESP_ERR_INVALID_ARG;
+    }
+    for(int i = 0; i < HOST_RADIO_MAX_NODES; i++){
+        if(!nodes[i].used){
+            memcpy(nodes[i].mac, mac, ESP_NOW_ETH_ALEN);
+            nodes[i].channel = channel;
+            nodes[i].recv = recv;
+            nodes[i].arg = arg;
+            nodes[i].used = true;
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+void host_radio_remove_node(const uint8_t* mac){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    int i = findNode(mac);
+    if(i != -1){
+        nodes[i].used = false;
+    }
+}
+
+void host_radio_set_node_channel(const uint8_t* mac, uint8_t channel){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    int i = findNode(mac);
+    if(i != -1 && channel >= 1 && channel <= HOST_RADIO_MAX_CHANNEL){
+        nodes[i].channel = channel;
+    }
+}
+
+esp_err_t host_radio_node_send(const uint8_t* src_mac, const uint8_t* dst_mac, const uint8_t* data, size_t len){
+    if(src_mac == nullptr || dst_mac == nullptr || data == nullptr || len == 0 || len > ESP_NOW_MAX_DATA_LEN){
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    std::lock_guard<std::mutex> guard(radio_lock);
+    int i = findNode(src_mac);
+    if(i == -1){
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    transmit(i, nodes[i].mac, dst_mac, nodes[i].channel, data, (int)len);
+    return ESP_OK;
+}
+
+esp_err_t host_radio_deliver(const uint8_t* src_mac, const uint8_t* data, size_t len){
+    std::unique_lock<std::mutex> guard(radio_lock);
+    esp_now_recv_cb_t cb = recv_cb;
+    if(!initialized || cb == nullptr){
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    uint8_t src[ESP_NOW_ETH_ALEN];
+    memcpy(src, src_mac, ESP_NOW_ETH_ALEN);
+#if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
+    uint8_t dst[ESP_NOW_ETH_ALEN];
+    memcpy(dst, local_mac, ESP_NOW_ETH_ALEN);
+    wifi_pkt_rx_ctrl_t rx_ctrl = {};
+    rx_ctrl.rssi = config.rssi;
+    rx_ctrl.noise_floor = -95;
+    rx_ctrl.channel = local_channel;
+    rx_ctrl.timestamp = (uint32_t)now_us();
+    rx_ctrl.sig_len = len;
+    guard.unlock();
+
+    esp_now_recv_info_t info = {src, dst, &rx_ctrl};
+    cb(&info, data, (int)len);
+#else
+    guard.unlock();
+    cb(src, data, (int)len);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t host_radio_report_sent(const uint8_t* dst_mac, bool acked){
+    std::unique_lock<std::mutex> guard(radio_lock);
+    esp_now_send_cb_t cb = send_cb;
+    if(!initialized || cb == nullptr){
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+#if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
+    uint8_t src[ESP_NOW_ETH_ALEN];
+    memcpy(src, local_mac, ESP_NOW_ETH_ALEN);
+    guard.unlock();
+
+    esp_now_send_info_t tx_info = {dst_mac, src, WIFI_IF_STA, nullptr, 0};
+    cb(&tx_info, acked ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+#else
+    guard.unlock();
+    cb(dst_mac, acked ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+#endif
+    return ESP_OK;
+}
+
+bool host_radio_wait_idle(uint32_t timeout_ms){
+    std::unique_lock<std::mutex> guard(radio_lock);
+    return radio_idle.wait_for(guard, std::chrono::milliseconds(timeout_ms), []{
+        return !running || (events.empty() && !dispatching);
+    });
+}
+
+void host_radio_get_stats(host_radio_stats_t* out){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    *out = stats;
+}
+
+void host_radio_reset_stats(){
+    std::lock_guard<std::mutex> guard(radio_lock);
+    stats = host_radio_stats_t();
+}
+/**************************************/
@@ -0,0 +1,12 @@
+#include <Arduino.h>
+
+// Entry point that runs an Arduino sketch on the host
+void setup();
+void loop();
+
+int main(){
+    setup();
+    for(;;){
+        loop();
+    }
+}
@@ -0,0 +1,170 @@
+/**
+ * Stress test of the single-producer/single-consumer hand-off on the host backend.
+ *
+ * One thread fills a Ring_Buffer and a Msg_Queue like the receive callback, the other drains them like loop().
+ * The consumer checks that every sequence number arrives once and in order, with its payload and checksum intact.
+ * The program exits with status 1 on the first failure. Build it as described in extras/host/README.md.
+ */
+#include <QuickESPNow.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#define RING_MESSAGES 2000000       // Records passed through the ring buffer
+#define QUEUE_MESSAGES 200000       // Messages passed through the receive queue
+#define RECORD_PAYLOAD 27           // Payload bytes of a ring record
+#define QUEUE_MAX_BYTES 200         // Longest array sent through the receive queue
+
+/**
+ * @brief   A ring record, its payload and checksum follow from its sequence number.
+ */
+typedef struct {
+    uint32_t sequence;
+    uint8_t payload[RECORD_PAYLOAD];
+    uint32_t checksum;
+} stress_record;
+
+static Ring_Buffer<stress_record, 64> ring;
+static Msg_Queue queue;
+
+// FNV-1a, so a torn or shifted payload does not add up to the same value
+static uint32_t checksum(const uint8_t* bytes, int len){
+    uint32_t hash = 2166136261u;
+    for(int i = 0; i < len; i++){
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint8_t pattern(uint32_t sequence, int i){
+    return (uint8_t)(sequence * 31 + i * 7);
+}
+
+static void fail(const char* test, uint32_t expected, const char* what){
+    fprintf(stderr, "%s: message %lu %s\n", test, (unsigned long)expected, what);
+    exit(1);
+}
+
+// The producer fills half the records in place and copies the other half, the consumer reads them the same two ways
+static void testRing(){
+    std::thread producer([]{
+        for(uint32_t sequence = 0; sequence < RING_MESSAGES; sequence++){
+            stress_record record;
+            stress_record* slot = (sequence & 1) ? ring.claim() : &record;
+            while(slot == nullptr){
+                std::this_thread::yield();
+                slot = ring.claim();
+            }
+            slot->sequence = sequence;
+            for(int i = 0; i < RECORD_PAYLOAD; i++){
+                slot->payload[i] = pattern(sequence, i);
+            }
+            slot->checksum = checksum(slot->payload, RECORD_PAYLOAD);
+            if(sequence & 1){
+                ring.commit();
+            }else{
+                while(!ring.push(record)){
+                    std::this_thread::yield();
+                }
+            }
+        }
+    });
+
+    for(uint32_t expected = 0; expected < RING_MESSAGES; expected++){
+        stress_record copy;
+        const stress_record* record = &copy;
+        if(expected & 1){
+            while((record = ring.front()) == nullptr){
+                std::this_thread::yield(); // Lets the producer run on a single core
+            }
+        }else{
+            while(!ring.pop(copy)){
+                std::this_thread::yield();
+            }
+        }
+        if(record->sequence != expected){
+            fail("ring", expected, "arrived out of order or twice");
+        }
+        if(record->checksum != checksum(record->payload, RECORD_PAYLOAD)){
+            fail("ring", expected, "has a bad checksum");
+        }
+        for(int i = 0; i < RECORD_PAYLOAD; i++){
+            if(record->payload[i] != pattern(expected, i)){
+                fail("ring", expected, "has a wrong payload");
+            }
+        }
+        if(expected & 1){
+            ring.drop();
+        }
+    }
+    producer.join();
+    if(!ring.isEmpty()){
+        fail("ring", RING_MESSAGES, "and more were left in the buffer");
+    }
+    printf("ring: %d records in order and intact\n", RING_MESSAGES);
+}
+
+// Arrays of 9 to QUEUE_MAX_BYTES bytes: the sequence number, the pattern and the checksum of both
+static int encodeStress(msg_struct* msg, uint32_t sequence){
+    uint8_t bytes[QUEUE_MAX_BYTES];
+    int len = 9 + sequence % (QUEUE_MAX_BYTES - 8);
+    memcpy(bytes, &sequence, sizeof(sequence));
+    for(int i = sizeof(sequence); i < len - 4; i++){
+        bytes[i] = pattern(sequence, i);
+    }
+    uint32_t sum = checksum(bytes, len - 4);
+    memcpy(bytes + len - 4, &sum, sizeof(sum));
+    return encodeMsg(msg, bytes, len);
+}
+
+static void testQueue(){
+    std::thread producer([]{
+        msg_struct msg;
+        for(uint32_t sequence = 0; sequence < QUEUE_MESSAGES; sequence++){
+            encodeStress(&msg, sequence);
+            while(!queue.add(&msg)){
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint8_t bytes[QUEUE_MAX_BYTES];
+    for(uint32_t expected = 0; expected < QUEUE_MESSAGES; expected++){
+        while(queue.isEmpty()){
+            std::this_thread::yield();
+        }
+        int len = (int)queue.data_size();
+        if(len != 9 + (int)(expected % (QUEUE_MAX_BYTES - 8)) || !queue.isFrontArray()){
+            fail("queue", expected, "has a wrong length or type");
+        }
+        queue.popArray(bytes);
+
+        uint32_t sequence;
+        uint32_t sum;
+        memcpy(&sequence, bytes, sizeof(sequence));
+        memcpy(&sum, bytes + len - 4, sizeof(sum));
+        if(sequence != expected){
+            fail("queue", expected, "arrived out of order or twice");
+        }
+        if(sum != checksum(bytes, len - 4)){
+            fail("queue", expected, "has a bad checksum");
+        }
+        for(int i = sizeof(sequence); i < len - 4; i++){
+            if(bytes[i] != pattern(expected, i)){
+                fail("queue", expected, "has a wrong payload");
+            }
+        }
+    }
+    producer.join();
+    if(!queue.isEmpty()){
+        fail("queue", QUEUE_MESSAGES, "and more were left in the queue");
+    }
+    printf("queue: %d messages in order and intact\n", QUEUE_MESSAGES);
+}
+
+int main(){
+    testRing();
+    testQueue();
+    return 0;
+}
@@ -3,7 +3,7 @@
 
 /**************Declaration of static variables and methods**************/
 uint8_t* QuickESPNow::getEspMAC(){
-    uint8_t *temp;
+    static uint8_t temp[MAC_LENGTH]; // Outlives the call, overwritten by the next one
     getSTRINGtoMAC(WiFi.macAddress(), temp);
     return temp;
 }
@@ -16,36 +16,153 @@ void QuickESPNow::getEspMAC(uint8_t* MAC){
 
 #if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
 void QuickESPNow::OnDataSent(const esp_now_send_info_t *tx_info, esp_now_send_status_t status){
-    Serial.print("\r\nLast Packet Send Status:\t");
-    Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
+    QEN_COUNT(status == ESP_NOW_SEND_SUCCESS ? PERF_FRAMES_DELIVERED : PERF_FRAMES_FAILED, 1);
+    if(QuickESPNow::track_sends){
+        QuickESPNow::send_tracker.complete(status == ESP_NOW_SEND_SUCCESS);
+    }
+    if(status != ESP_NOW_SEND_SUCCESS && QuickESPNow::deltas != nullptr){
+        QuickESPNow::deltas->resync(QuickESPNow::inboxes.find(tx_info->des_addr)); // The peer may have missed a delta
+    }
+    QEN_LOG_DEBUG(LOG_FROM_WIFI, status == ESP_NOW_SEND_SUCCESS ? LOG_DELIVERY_OK : LOG_DELIVERY_FAIL, tx_info->des_addr, 0);
 }
 #else
 void QuickESPNow::OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status){
-    Serial.print("\r\nLast Packet Send Status:\t");
-    Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
+    QEN_COUNT(status == ESP_NOW_SEND_SUCCESS ? PERF_FRAMES_DELIVERED : PERF_FRAMES_FAILED, 1);
+    if(QuickESPNow::track_sends){
+        QuickESPNow::send_tracker.complete(status == ESP_NOW_SEND_SUCCESS);
+    }
+    if(status != ESP_NOW_SEND_SUCCESS && QuickESPNow::deltas != nullptr){
+        QuickESPNow::deltas->resync(QuickESPNow::inboxes.find(mac_addr)); // The peer may have missed a delta
+    }
+    QEN_LOG_DEBUG(LOG_FROM_WIFI, status == ESP_NOW_SEND_SUCCESS ? LOG_DELIVERY_OK : LOG_DELIVERY_FAIL, mac_addr, 0);
 }
 #endif
 
 #if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
 void QuickESPNow::OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
-    msg_struct receivedData;
-    memcpy(&receivedData, incomingData, sizeof(receivedData));
-    QuickESPNow::recieved_msgs.add(&receivedData);
+    QuickESPNow::receiveFrame(info->src_addr, info->rx_ctrl, incomingData, len);
 }
 #elif ESP_ARDUINO_VERSION == ESP_ARDUINO_VERSION_VAL(2, 0, 17)
 void QuickESPNow::OnDataRecv(const uint8_t *mac_addr, const uint8_t *incomingData, int len) {
-    msg_struct receivedData;
-    memcpy(&receivedData, incomingData, sizeof(receivedData));
-    QuickESPNow::recieved_msgs.add(&receivedData);
+    QuickESPNow::receiveFrame(mac_addr, nullptr, incomingData, len); // The 2.x callback does not give the frame's metadata
 }
 #endif
+
+void QuickESPNow::receiveFrame(const uint8_t *mac_addr, const wifi_pkt_rx_ctrl_t *rx_ctrl, const uint8_t *incomingData, int len) {
+    int key = QuickESPNow::inboxes.find(mac_addr);
+    QuickESPNow::link_quality.record(key, rx_ctrl);
+    QEN_COUNT(PERF_FRAMES_RECEIVED, 1);
+    QEN_COUNT(PERF_BYTES_RECEIVED, len);
+    if(msgLength(incomingData, len) == CLOCK_OVERHEAD && ((const msg_header*)incomingData)->type == MSG_CLOCK_TYPE){
+        QuickESPNow::clock_sync.receive(key, incomingData, esp_timer_get_time());
+        return;
+    }
+    if(msgLength(incomingData, len) == GROUP_OVERHEAD && ((const msg_header*)incomingData)->type == MSG_GROUP_TYPE){
+        // The frames of the groups this board did not join never reach a queue
+        if(!QuickESPNow::groups.accept(key, incomingData)){
+            return;
+        }
+        incomingData += GROUP_OVERHEAD;
+        len -= GROUP_OVERHEAD;
+    }
+    if(msgLength(incomingData, len) == RELIABLE_OVERHEAD && ((const msg_header*)incomingData)->type == MSG_LINK_TYPE){
+        QuickESPNow::receiveReliable(mac_addr, key, incomingData, len);
+    }else{
+        Msg_Queue* queue = key != -1 ? QuickESPNow::inboxes.queue(key) : nullptr;
+        if(queue == nullptr){
+            queue = &QuickESPNow::recieved_msgs; // Unknown senders, and peers whose queue could not be allocated
+        }
+        QuickESPNow::deliverFrame(mac_addr, key, queue, incomingData, len);
+    }
+
+    // The waiting task checks the queues after it sets rx_waiting, so either it sees the message or it is woken
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(QuickESPNow::rx_waiting.load(std::memory_order_relaxed)){
+        xSemaphoreGive(QuickESPNow::rx_signal);
+    }
+}
+
+void QuickESPNow::receiveReliable(const uint8_t *mac_addr, int key, const uint8_t *incomingData, int len) {
+    // Both boards must enable reliable mode for each other, otherwise the frame is dropped
+    Reliable_Link* link = key != -1 ? QuickESPNow::links[key] : nullptr;
+    if(link == nullptr || !link->isEnabled()){
+        return;
+    }
+    link->receive(incomingData, len);
+    Msg_Queue* queue = QuickESPNow::inboxes.queue(key);
+    if(queue == nullptr){
+        queue = &QuickESPNow::recieved_msgs;
+    }
+
+    // A frame is only delivered when all its messages fit, otherwise it is not acknowledged and comes again
+    const uint8_t* msgs;
+    int msgs_len;
+    bool forced;
+    while((msgs = link->next(&msgs_len, &forced)) != nullptr){
+        int count = 0;
+        int used;
+        for(int pos = 0; pos < msgs_len && (used = msgLength(msgs + pos, msgs_len - pos)) > 0; pos += used){
+            count++;
+        }
+        if(count > queue->freeSlots() && !forced){
+            break;
+        }
+        QuickESPNow::deliverFrame(mac_addr, key, queue, msgs, msgs_len);
+        link->advance();
+    }
+}
+
+void QuickESPNow::deliverFrame(const uint8_t *mac_addr, int key, Msg_Queue* queue, const uint8_t *incomingData, int len) {
+    // A frame may carry several batched messages back to back, each is copied once into its slot
+    int used;
+    msg_struct rebuilt;
+    while(len > 0 && (used = msgLength(incomingData, len)) > 0){
+        uint8_t flags = ((const msg_header*)incomingData)->flags;
+        const uint8_t* msg = incomingData;
+        int msg_len = used;
+        if(flags & MSG_FLAG_DELTA){
+            // Rebuilt into a whole message, a delta that can not be applied is dropped
+            msg_len = QuickESPNow::deltas != nullptr ? QuickESPNow::deltas->decode(key, incomingData, used, &rebuilt) : 0;
+            msg = (const uint8_t*)&rebuilt;
+            if(msg_len == 0){
+                QEN_LOG_DEBUG(LOG_FROM_WIFI, LOG_DELTA_OUT_OF_SYNC, mac_addr, ((const msg_header*)incomingData)->type);
+            }
+        }
+
+        if(flags & MSG_FLAG_FRAGMENT){
+            if(QuickESPNow::reassembler != nullptr){
+                QuickESPNow::reassembler->add(mac_addr, incomingData, used, queue);
+            }
+        }else if(msg_len > 0 && !(flags & MSG_FLAG_LARGE) && !QuickESPNow::mailboxes.write(key, msg, msg_len) && // Only the reassembler may queue references to the arena
+                 (QuickESPNow::dispatcher == nullptr || !QuickESPNow::dispatcher->post(queue->sender(), msg, msg_len))){
+            queue->add(msg, msg_len);
+        }
+        incomingData += used;
+        len -= used;
+    }
+}
 uint8_t QuickESPNow::Local_MAC[MAC_LENGTH];
 
 Msg_Queue QuickESPNow::recieved_msgs;
+Rx_Demux QuickESPNow::inboxes;
+int QuickESPNow::read_cursor = 0;
+bool QuickESPNow::read_chosen = false;
+Mailbox_Table QuickESPNow::mailboxes;
+Send_Tracker QuickESPNow::send_tracker;
+bool QuickESPNow::track_sends = false;
+Frag_Reassembler* QuickESPNow::reassembler = nullptr;
+Reliable_Link* QuickESPNow::links[MAX_PEERS];
+Delta_Table* QuickESPNow::deltas = nullptr;
+Group_Table QuickESPNow::groups;
+Msg_Dispatcher* QuickESPNow::dispatcher = nullptr;
+SemaphoreHandle_t QuickESPNow::rx_signal = nullptr;
+std::atomic<bool> QuickESPNow::rx_waiting(false);
+Link_Stats_Table QuickESPNow::link_quality;
+Clock_Sync QuickESPNow::clock_sync;
 /***********************************************************************/
 
 /**************Constructors**************/
-QuickESPNow::QuickESPNow(const COMMUNICATION communication, const int peers_crowd, const uint8_t* new_local_MAC){
+QuickESPNow::QuickESPNow(const COMMUNICATION communication, const int peers_crowd, const uint8_t* new_local_MAC) : peers(peers_crowd){
     if(communication == SENDER || communication == RECEIVER || communication == TWO_WAY_COMMUNICATION){
         this->ESP_COM = communication;
     }else{
@@ -53,10 +170,9 @@ QuickESPNow::QuickESPNow(const COMMUNICATION communication, const int peers_crow
         this->error_counter++;
     }
 
-    this->ids = (int*)malloc(peers_crowd*sizeof(int));
-    this->Peers_MAC = (uint8_t**)malloc(peers_crowd*sizeof(uint8_t*));
-    for(int i=0; i<MAC_LENGTH; i++){
-        this->Peers_MAC[i] = (uint8_t*)malloc(MAC_LENGTH*sizeof(uint8_t));
+    if(this->peers.capacity() != peers_crowd){
+        this->setup_errors[this->error_counter] = MEMORY_ALLOCATION_ERROR;
+        this->error_counter++;
     }
 
     this->Encryption = false;
@@ -64,7 +180,7 @@ QuickESPNow::QuickESPNow(const COMMUNICATION communication, const int peers_crow
     memcpy(QuickESPNow::Local_MAC, new_local_MAC, MAC_LENGTH);
 }
 
-QuickESPNow::QuickESPNow(const COMMUNICATION communication, const int peers_crowd, const uint8_t* new_local_MAC, const char* new_PMK_key){
+QuickESPNow::QuickESPNow(const COMMUNICATION communication, const int peers_crowd, const uint8_t* new_local_MAC, const char* new_PMK_key) : peers(peers_crowd){
     if(communication == SENDER || communication == RECEIVER || communication == TWO_WAY_COMMUNICATION){
         this->ESP_COM = communication;
     }else{
@@ -72,10 +188,9 @@ QuickESPNow::QuickESPNow(const COMMUNICATION communication, const int peers_crow
         this->error_counter++;
     }
 
-    this->ids = (int*)malloc(peers_crowd*sizeof(int));
-    this->Peers_MAC = (uint8_t**)malloc(peers_crowd*sizeof(uint8_t*));
-    for(int i=0; i<MAC_LENGTH; i++){
-        this->Peers_MAC[i] = (uint8_t*)malloc(MAC_LENGTH*sizeof(uint8_t));
+    if(this->peers.capacity() != peers_crowd){
+        this->setup_errors[this->error_counter] = MEMORY_ALLOCATION_ERROR;
+        this->error_counter++;
     }
 
     this->Encryption = true;
@@ -105,10 +220,6 @@ void QuickESPNow::addPeer(int id, uint8_t* Peers_MAC, int Ch, wifi_interface_t m
         this->error_counter++;
     }
 
-    this->ids[this->id_counter] = id;
-    memcpy(this->Peers_MAC[this->id_counter], Peers_MAC, MAC_LENGTH);
-    this->id_counter++;
-
     // Initialize the peerInfo structure
     esp_now_peer_info_t peerInfo = {};
     memcpy(peerInfo.peer_addr, Peers_MAC, MAC_LENGTH);
@@ -116,13 +227,7 @@ void QuickESPNow::addPeer(int id, uint8_t* Peers_MAC, int Ch, wifi_interface_t m
     peerInfo.encrypt = false;
     peerInfo.ifidx = mode;  // Use station interface (most common for ESP-NOW)
 
-    // Add receiver as peer        
-    if (esp_now_add_peer(&peerInfo) != ESP_OK) {
-        Serial.println("[Error] Failed to add peer");
-        return;
-    }else{
-        Serial.println("[SUCCESS] peer has been added succesfuly");
-    }
+    addPeer(id, &peerInfo);
 }
 
 
@@ -135,10 +240,6 @@ void QuickESPNow::addPeer(int id, uint8_t* Peers_MAC, int Ch, wifi_interface_t m
         this->error_counter++;
     }
 
-    this->ids[this->id_counter] = id;
-    memcpy(this->Peers_MAC[this->id_counter], Peers_MAC, MAC_LENGTH);
-    this->id_counter++;
-
     // Initialize the peerInfo structure
     esp_now_peer_info_t peerInfo = {};
     memcpy(peerInfo.peer_addr, Peers_MAC, MAC_LENGTH);
@@ -151,29 +252,77 @@ void QuickESPNow::addPeer(int id, uint8_t* Peers_MAC, int Ch, wifi_interface_t m
         peerInfo.lmk[i] = LMK_keys_array[i];
     }
 
-
-    // Add receiver as peer        
-    if (esp_now_add_peer(&peerInfo) != ESP_OK){
-        Serial.println("Failed to add peer");
-        return;
-    }else{
-        Serial.println("[SUCCESS] peer has been added succesfuly");
-    }
+    addPeer(id, &peerInfo);
 }
 
 
 void QuickESPNow::addPeer(int id, esp_now_peer_info_t* Peer){
-    this->ids[this->id_counter] = id;
-    memcpy(this->Peers_MAC[this->id_counter], Peer->peer_addr, MAC_LENGTH);
-    this->id_counter++;
+    // Forget the old MAC if the ID is being reassigned to another ESP
+    const peer_entry* old_peer = this->peers.get(this->peers.find(id));
+    bool new_link = old_peer == nullptr || memcmp(old_peer->mac, Peer->peer_addr, MAC_LENGTH) != 0;
+    if(old_peer != nullptr && new_link){
+        esp_now_del_peer(old_peer->mac);
+    }
 
-    // Add receiver as peer        
-    if (esp_now_add_peer(Peer) != ESP_OK){
-        Serial.println("Failed to add peer");
+    // Add receiver as peer, or update it if the driver already knows its MAC
+    esp_err_t result = esp_now_is_peer_exist(Peer->peer_addr) ? esp_now_mod_peer(Peer) : esp_now_add_peer(Peer);
+    if (result != ESP_OK){
+        QEN_LOG_ERROR(LOG_FROM_APP, LOG_PEER_ADD_FAIL, Peer->peer_addr, id);
+        this->setup_errors[this->error_counter] = ADD_PEER_INITIALIZATION_ERROR;
+        this->error_counter++;
         return;
-    }else{
-        Serial.println("[SUCCESS] peer has been added succesfuly");
     }
+
+    // Cache the driver state so that Send does not have to query it
+    if(this->peers.add(id, Peer) == -1){
+        QEN_LOG_ERROR(LOG_FROM_APP, LOG_TOO_MANY_PEERS, Peer->peer_addr, id);
+        esp_now_del_peer(Peer->peer_addr);
+        this->setup_errors[this->error_counter] = ADD_PEER_INITIALIZATION_ERROR;
+        this->error_counter++;
+        return;
+    }
+    if(new_link){
+        QuickESPNow::link_quality.reset(this->peers.find(id)); // Before the receive callback can find the slot
+        QuickESPNow::clock_sync.reset(this->peers.find(id));
+    }
+    QuickESPNow::inboxes.open(this->peers.find(id), id, Peer->peer_addr); // The frames of the peer go to its own queue
+    QEN_LOG_INFO(LOG_FROM_APP, LOG_PEER_ADDED, Peer->peer_addr, id);
+    QEN_LOG_DRAIN(2 * LOG_BUFFER_CAPACITY);
+}
+
+void QuickESPNow::removePeer(int id){
+    int key = this->peers.find(id);
+    if(key == -1){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return;
+    }
+
+    if(this->batches != nullptr){
+        this->batches[key].length = 0;
+    }
+    if(this->scheduler != nullptr){
+        // The frames already in flight free their window slots when their send callbacks come
+        int handles[TX_QUEUE_CAPACITY];
+        int dropped = this->scheduler->dropPeer(key, handles);
+        for(int i = 0; i < dropped; i++){
+            QuickESPNow::send_tracker.release(key, handles[i]);
+        }
+    }
+    QuickESPNow::inboxes.close(key); // Its queued messages can still be read without an ID
+    QuickESPNow::mailboxes.closeAll(key);
+    QuickESPNow::groups.forgetPeer(key);
+    QuickESPNow::clock_sync.setInterval(key, 0);
+    if(key < MAX_PEERS){
+        this->compressed_peers &= ~(1u << key);
+    }
+    if(QuickESPNow::deltas != nullptr){
+        QuickESPNow::deltas->disable(key);
+    }
+    if(reliableLink(key) != nullptr){
+        QuickESPNow::links[key]->setEnabled(false);
+    }
+    esp_now_del_peer(this->peers.get(key)->mac);
+    this->peers.remove(id);
 }
 
 void QuickESPNow::begin(){
@@ -190,6 +339,7 @@ void QuickESPNow::begin(){
         case SENDER:
             // Register for Send CB to get the status of Transmitted packet
             esp_now_register_send_cb(QuickESPNow::OnDataSent);
+            QuickESPNow::track_sends = true;
             break;
         case RECEIVER:
             esp_now_register_recv_cb(QuickESPNow::OnDataRecv);
@@ -197,13 +347,15 @@ void QuickESPNow::begin(){
         case TWO_WAY_COMMUNICATION:
             esp_now_register_send_cb(QuickESPNow::OnDataSent);
             esp_now_register_recv_cb(QuickESPNow::OnDataRecv);
+            QuickESPNow::track_sends = true;
             break;
     }
 
 
     // Read the old MAC
-    Serial.print("[OLD] ESP32 Board MAC Address:  ");
-    Serial.println(WiFi.macAddress());
+    uint8_t MAC[MAC_LENGTH];
+    getSTRINGtoMAC(WiFi.macAddress(), MAC);
+    QEN_LOG_INFO(LOG_FROM_APP, LOG_OLD_MAC, MAC, 0);
 
     delay(100);
 
@@ -212,13 +364,13 @@ void QuickESPNow::begin(){
 
     delay(100);
     
-    Serial.print("\r[NEW] ESP32 Board MAC Address:  ");
-    Serial.println(WiFi.macAddress());
+    getSTRINGtoMAC(WiFi.macAddress(), MAC);
+    QEN_LOG_INFO(LOG_FROM_APP, LOG_NEW_MAC, MAC, 0);
 
     // Verify that the new MAC is set correctly
 
     if (!WiFi.macAddress().equals(getMACtoSTRING(this->Local_MAC))) {
-        Serial.println("\r[Error] Failed to change MAC");
+        QEN_LOG_ERROR(LOG_FROM_APP, LOG_MAC_CHANGE_FAIL, this->Local_MAC, 0);
         this->setup_errors[this->error_counter] = NEW_MAC_INITIALIZATION_ERROR;
         this->error_counter++;
     }
@@ -226,49 +378,954 @@ void QuickESPNow::begin(){
     if(this->Encryption){
         esp_now_set_pmk((uint8_t *)this->PMK_key);
     }
+    this->current_channel = WiFi.channel();
     delay(100);
+    QEN_LOG_DRAIN(2 * LOG_BUFFER_CAPACITY);
 }
 /**********************************************************/
 
 void QuickESPNow::setChannel(int ch){
+    switchChannel(ch);
+    delay(100);
+}
+
+void QuickESPNow::switchChannel(int ch){
+    if(ch != this->current_channel){
+        QEN_COUNT(PERF_CHANNEL_SWITCHES, 1);
+    }
+    this->current_channel = ch;
     #if ESP_ARDUINO_VERSION >= ESP_ARDUINO_VERSION_VAL(3, 0, 0)
     WiFi.setChannel(ch);
-    delay(100);
     #elif ESP_ARDUINO_VERSION == ESP_ARDUINO_VERSION_VAL(2, 0, 17)
     WiFi.channel(ch);
-    delay(100);
     #endif
 }
+/**************Sending of the messages**************/
+void QuickESPNow::sendFrame(const int id, const msg_struct* msg, int len){
+    int key = this->peers.find(id);
+    if(key == -1){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return;
+    }
+
+    // A reliable frame has less room for messages, the largest ones are sent in fragments
+    int room = ESPNOW_MTU - (reliableLink(key) != nullptr ? RELIABLE_OVERHEAD : 0);
+    if(len > room){
+        sendLarge(id, msg->header.type, msg->header.flags, msg->payload, msg->header.length);
+        return;
+    }
+
+    // Only the changed bytes are sent, if they still fit in the frame with the sequence numbers
+    msg_struct delta_msg;
+    if(QuickESPNow::deltas != nullptr && QuickESPNow::deltas->isEnabled(key) && len + DELTA_OVERHEAD <= room){
+        memcpy(&delta_msg, msg, len);
+        len = QuickESPNow::deltas->encode(key, &delta_msg, len);
+        msg = &delta_msg;
+    }
+
+    // Urgent messages do not wait for the batch deadline
+    MSG_PRIORITY priority = msgPriority(msg->header.flags);
+    if(this->batches == nullptr || priority > PRIORITY_NORMAL){
+        if(!transmit(key, (const uint8_t*)msg, len, 0, priority) && QuickESPNow::deltas != nullptr){
+            QuickESPNow::deltas->resync(key); // The peer never gets this delta, the next message must be a keyframe
+        }
+        return;
+    }
+
+    frame_batch* batch = &this->batches[key];
+    if(batch->length + len > room){
+        flushBatch(key);
+    }
+
+    if(batch->length == 0){
+        batch->opened_at = millis();
+    }
+    memcpy(batch->frame + batch->length, msg, len);
+    batch->length += len;
+
+    if(room - batch->length < MSG_HEADER_SIZE + 1){
+        flushBatch(key); // No other message fits
+    }
+
+    update();
+}
+
+void QuickESPNow::flushBatch(int key){
+    frame_batch* batch = &this->batches[key];
+    if(batch->length == 0){
+        return;
+    }
+
+    if(!transmit(key, batch->frame, batch->length) && QuickESPNow::deltas != nullptr){
+        QuickESPNow::deltas->resync(key); // The batch may hold deltas
+    }
+    batch->length = 0;
+}
+
+int QuickESPNow::sendFrameAsync(const int id, const msg_struct* msg, int len){
+    int key = this->peers.find(id);
+    if(key == -1){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return -1;
+    }
+
+    if(!QuickESPNow::track_sends){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_NO_SEND_CALLBACK, nullptr, 0);
+        return -1;
+    }
+
+    if(reliableLink(key) != nullptr && len > ESPNOW_MTU - RELIABLE_OVERHEAD){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_ARRAY_TOO_LARGE, nullptr, msg->header.length);
+        return -1;
+    }
+
+    int handle = QuickESPNow::send_tracker.reserve(key);
+    if(handle == -1){
+        return -1; // Too many messages in flight to this peer
+    }
+
+    if(!transmit(key, (const uint8_t*)msg, len, handle, msgPriority(msg->header.flags))){
+        QuickESPNow::send_tracker.release(key, handle);
+        return -1;
+    }
+    return handle;
+}
+
+bool QuickESPNow::transmit(int key, const uint8_t* frame, int len, int handle, MSG_PRIORITY priority){
+    Reliable_Link* link = reliableLink(key);
+    if(link == nullptr){
+        return transmitRaw(key, frame, len, handle, priority);
+    }
+
+    // Waits for the acknowledgments that make room in the window
+    unsigned long started = millis();
+    while(!link->canSend()){
+        if(millis() - started >= RELIABLE_SEND_TIMEOUT_MS){
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_TX_QUEUE_FULL, this->peers.get(key)->mac, this->peers.get(key)->id);
+            return false;
+        }
+        serviceLinks();
+        if(this->scheduler != nullptr){
+            drainScheduler();
+        }
+        delay(1);
+    }
+
+    int frame_len;
+    const uint8_t* reliable_frame = link->push(frame, len, micros(), &frame_len);
+    if(!transmitRaw(key, reliable_frame, frame_len, handle, priority) && handle != 0){
+        QuickESPNow::send_tracker.release(key, handle); // The frame is sent again on timeout, but without its handle
+    }
+    return true;
+}
+
+bool QuickESPNow::transmitRaw(int key, const uint8_t* frame, int len, int handle, MSG_PRIORITY priority){
+    const peer_entry* peer = this->peers.get(key);
+
+    if(this->scheduler != nullptr){
+        if(!this->scheduler->push(key, peer->channel, frame, len, handle, priority)){
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_TX_QUEUE_FULL, peer->mac, peer->id);
+            return false;
+        }
+        return true;
+    }
+
+    // Channel 0 means that the peer follows the current channel
+    if(peer->channel != 0 && peer->channel != this->current_channel){
+        setChannel(peer->channel);
+    }
+
+    esp_err_t result = sendToDriver(key, frame, len, handle);
+    if(result == ESP_OK){
+        QEN_LOG_DEBUG(LOG_FROM_APP, LOG_SEND_OK, peer->mac, 0);
+    }else{
+        QEN_LOG_ERROR(LOG_FROM_APP, LOG_SEND_FAIL, peer->mac, result);
+    }
+    return result == ESP_OK;
+}
+
+esp_err_t QuickESPNow::sendToDriver(int key, const uint8_t* frame, int len, int handle){
+    const peer_entry* peer = this->peers.get(key);
+    if(!QuickESPNow::track_sends){
+        esp_err_t result = esp_now_send(peer->mac, frame, len);
+        countSend(result, len);
+        return result;
+    }
+
+    // Recorded first, the send callback may run before esp_now_send returns
+    int position = QuickESPNow::send_tracker.add(key, peer->id, handle);
+    if(position == -1){
+        return ESP_ERR_ESPNOW_NO_MEM;
+    }
+
+    esp_err_t result = esp_now_send(peer->mac, frame, len);
+    if(result != ESP_OK){
+        QuickESPNow::send_tracker.cancel(position);
+    }
+    countSend(result, len);
+    return result;
+}
+
+void QuickESPNow::countSend(esp_err_t result, int len){
+    if(result == ESP_OK){
+        QEN_COUNT(PERF_FRAMES_SENT, 1);
+        QEN_COUNT(PERF_BYTES_SENT, len);
+    }else{
+        QEN_COUNT(PERF_SEND_ERRORS, 1);
+    }
+    (void)len;
+}
+
+void QuickESPNow::sendLarge(const int id, uint8_t type, uint8_t flags, const uint8_t* bytes, uint32_t total){
+    int key = this->peers.find(id);
+    if(key == -1){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return;
+    }
+    if(total > (uint32_t)FRAG_CHUNK * UINT16_MAX){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_ARRAY_TOO_LARGE, nullptr, total);
+        return;
+    }
+
+    if(this->batches != nullptr){
+        flushBatch(key); // The earlier messages to the peer go first
+    }
+
+    // Compressed once for all the fragments, it is not worth it unless it saves an eighth
+    if(this->compressor != nullptr && key < MAX_PEERS && (this->compressed_peers & (1u << key))){
+        uint32_t capacity = total - total / 8;
+        uint8_t* packed = (uint8_t*)malloc(capacity);
+        uint32_t packed_size = packed != nullptr ? this->compressor->compress(bytes, total, packed, capacity) : 0;
+        if(packed_size > 0){
+            sendFragments(key, type, flags | MSG_FLAG_COMPRESSED, packed, packed_size);
+            free(packed);
+            return;
+        }
+        free(packed);
+    }
+    sendFragments(key, type, flags, bytes, total);
+}
+
+void QuickESPNow::sendFragments(int key, uint8_t type, uint8_t flags, const uint8_t* bytes, uint32_t total){
+    const peer_entry* peer = this->peers.get(key);
+    MSG_PRIORITY priority = msgPriority(flags);
+    uint16_t msg_id = this->next_msg_id++;
+    uint16_t count = (total + FRAG_CHUNK - 1) / FRAG_CHUNK;
+    msg_struct fragment;
+
+    for(uint16_t index = 0; index < count; index++){
+        int len = encodeFragment(&fragment, type, flags, msg_id, bytes, total, index);
+
+        if(reliableLink(key) != nullptr){
+            if(!transmit(key, (const uint8_t*)&fragment, len, 0, priority)){ // Waits for room in the window
+                QEN_LOG_ERROR(LOG_FROM_APP, LOG_FRAGMENT_SEND_FAIL, peer->mac, index);
+                return;
+            }
+            continue;
+        }
+
+        // Unlike single messages, a fragment waits for room instead of being dropped
+        unsigned long started = millis();
+        esp_err_t result;
+        while(true){
+            if(this->scheduler != nullptr){
+                result = this->scheduler->push(key, peer->channel, (const uint8_t*)&fragment, len, 0, priority) ? ESP_OK : ESP_ERR_ESPNOW_NO_MEM;
+            }else{
+                if(peer->channel != 0 && peer->channel != this->current_channel){
+                    setChannel(peer->channel);
+                }
+                result = sendToDriver(key, (const uint8_t*)&fragment, len, 0);
+            }
+            if(result != ESP_ERR_ESPNOW_NO_MEM || millis() - started >= FRAG_SEND_TIMEOUT_MS){
+                break;
+            }
+            update();
+            delay(1);
+        }
+
+        if(result != ESP_OK){
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_FRAGMENT_SEND_FAIL, peer->mac, index);
+            return;
+        }
+    }
+    QEN_LOG_DEBUG(LOG_FROM_APP, LOG_SEND_OK, peer->mac, 0);
+
+    update();
+}
+
+void QuickESPNow::sendGroupFrame(int group, const msg_struct* msg, int len){
+    if(len > ESPNOW_MTU - GROUP_OVERHEAD){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_ARRAY_TOO_LARGE, nullptr, msg->header.length);
+        return;
+    }
+    uint8_t frame[ESPNOW_MTU];
+    int header_len = QuickESPNow::groups.encode(group, frame);
+    if(header_len == 0){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_GROUP, nullptr, group);
+        return;
+    }
+    memcpy(frame + header_len, msg, len);
+
+    if(this->batches != nullptr){
+        uint32_t members = QuickESPNow::groups.members(group);
+        // Only the first MAX_PEERS slots have a bit in the member mask
+        for(int key = 0; key < std::min(this->peers.capacity(), MAX_PEERS); key++){
+            if(members & (1u << key)){
+                flushBatch(key); // The earlier messages to the members go first
+            }
+        }
+    }
+
+    // The driver only sends to known addresses, the broadcast one is added once and follows the current channel
+    uint8_t broadcast_mac[MAC_LENGTH];
+    memset(broadcast_mac, 0xFF, MAC_LENGTH);
+    if(!this->broadcast_added){
+        esp_now_peer_info_t info = {};
+        memcpy(info.peer_addr, broadcast_mac, MAC_LENGTH);
+        info.channel = 0;
+        info.ifidx = WIFI_IF_STA;
+        this->broadcast_added = esp_now_is_peer_exist(broadcast_mac) || esp_now_add_peer(&info) == ESP_OK;
+        if(!this->broadcast_added){
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_PEER_ADD_FAIL, broadcast_mac, group);
+            return;
+        }
+    }
+
+    // Tracked like the other frames so the send callbacks stay matched, no peer window is used
+    int position = QuickESPNow::track_sends ? QuickESPNow::send_tracker.add(-1, -1, 0) : -1;
+    esp_err_t result = ESP_ERR_ESPNOW_NO_MEM;
+    if(!QuickESPNow::track_sends || position != -1){
+        result = esp_now_send(broadcast_mac, frame, header_len + len);
+        if(result != ESP_OK && position != -1){
+            QuickESPNow::send_tracker.cancel(position);
+        }
+        countSend(result, header_len + len);
+    }
+    if(result == ESP_OK){
+        QEN_LOG_DEBUG(LOG_FROM_APP, LOG_SEND_OK, broadcast_mac, 0);
+    }else{
+        QEN_LOG_ERROR(LOG_FROM_APP, LOG_SEND_FAIL, broadcast_mac, result);
+    }
+
+    update();
+}
+
+void QuickESPNow::serviceGroups(){
+    int key;
+    uint8_t reply[GROUP_OVERHEAD];
+    while(QuickESPNow::groups.nextReply(&key, reply)){
+        if(this->peers.get(key) != nullptr){
+            transmitRaw(key, reply, GROUP_OVERHEAD);
+        }
+    }
+}
+
+bool QuickESPNow::probeChannel(int key){
+    const peer_entry* peer = this->peers.get(key);
+    if(peer == nullptr){
+        return false;
+    }
+    if(peer->channel == 0 || peer->channel == this->current_channel){
+        return true;
+    }
+    if(this->scheduler != nullptr){
+        return false; // The scheduler hops on its own, a hop for the probe would count in the round trip anyway
+    }
+    setChannel(peer->channel);
+    return true;
+}
+
+bool QuickESPNow::sendPing(int key){
+    if(!probeChannel(key)){
+        return false;
+    }
+    uint8_t probe[CLOCK_OVERHEAD];
+    QuickESPNow::clock_sync.ping(key, probe);
+    return sendToDriver(key, probe, CLOCK_OVERHEAD, 0) == ESP_OK;
+}
+
+void QuickESPNow::serviceClock(){
+    // The probes go straight to the driver, their timestamps are only good if the frame leaves right after them
+    int key;
+    uint8_t pong[CLOCK_OVERHEAD];
+    while(QuickESPNow::clock_sync.nextReply(&key, pong)){
+        if(probeChannel(key)){
+            Clock_Sync::stamp(pong);
+            sendToDriver(key, pong, CLOCK_OVERHEAD, 0);
+        }
+    }
+
+    uint32_t now = micros();
+    for(key = 0; key < MAX_PEERS; key++){
+        if(QuickESPNow::clock_sync.due(key, now)){
+            sendPing(key);
+        }
+    }
+}
+
+bool QuickESPNow::enableClockSync(int id, uint32_t interval_ms){
+    int key = this->peers.find(id);
+    if(key == -1 || key >= MAX_PEERS){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return false;
+    }
+    QuickESPNow::clock_sync.open(key);
+    QuickESPNow::clock_sync.setInterval(key, interval_ms * 1000);
+    return true;
+}
+
+void QuickESPNow::disableClockSync(int id){
+    QuickESPNow::clock_sync.setInterval(this->peers.find(id), 0);
+}
+
+bool QuickESPNow::ping(int id){
+    int key = this->peers.find(id);
+    if(key == -1 || key >= MAX_PEERS){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return false;
+    }
+    QuickESPNow::clock_sync.open(key);
+    return sendPing(key);
+}
+
+bool QuickESPNow::peerLatency(int id, clock_stats& output) const{
+    return QuickESPNow::clock_sync.snapshot(this->peers.find(id), &output);
+}
+
+int64_t QuickESPNow::peerClockOffset(int id) const{
+    clock_stats clock;
+    return QuickESPNow::clock_sync.snapshot(this->peers.find(id), &clock) ? clock.offset_us : 0;
+}
+
+int64_t QuickESPNow::peerTime(int id) const{
+    return esp_timer_get_time() + peerClockOffset(id);
+}
+
+bool QuickESPNow::addToGroup(int group, int id){
+    int key = this->peers.find(id);
+    if(key == -1){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return false;
+    }
+    return QuickESPNow::groups.addMember(group, key);
+}
+
+void QuickESPNow::removeFromGroup(int group, int id){
+    QuickESPNow::groups.removeMember(group, this->peers.find(id));
+}
+
+bool QuickESPNow::joinGroup(int group){
+    return QuickESPNow::groups.setJoined(group, true);
+}
+
+void QuickESPNow::leaveGroup(int group){
+    QuickESPNow::groups.setJoined(group, false);
+}
+
+void QuickESPNow::enableGroupAcks(int group){
+    if(!QuickESPNow::groups.setAcks(group, true)){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_GROUP, nullptr, group);
+    }
+}
+
+void QuickESPNow::disableGroupAcks(int group){
+    QuickESPNow::groups.setAcks(group, false);
+}
+
+int QuickESPNow::groupAcks(int group) const{
+    if(!QuickESPNow::groups.collectsAcks(group)){
+        return -1;
+    }
+    uint32_t acked = QuickESPNow::groups.acknowledged(group);
+    int count = 0;
+    for(; acked != 0; acked &= acked - 1){
+        count++;
+    }
+    return count;
+}
+
+bool QuickESPNow::groupDelivered(int group) const{
+    return QuickESPNow::groups.collectsAcks(group) &&
+           QuickESPNow::groups.acknowledged(group) == QuickESPNow::groups.members(group);
+}
+
+Reliable_Link* QuickESPNow::reliableLink(int key) const{
+    Reliable_Link* link = key >= 0 && key < MAX_PEERS ? QuickESPNow::links[key] : nullptr;
+    return link != nullptr && link->isEnabled() ? link : nullptr;
+}
+
+void QuickESPNow::serviceLinks(){
+    uint32_t now = micros();
+    for(int key = 0; key < MAX_PEERS; key++){
+        Reliable_Link* link = reliableLink(key);
+        if(link == nullptr){
+            continue;
+        }
+        link->processAcks(now);
+
+        const uint8_t* frame;
+        int value;
+        int due;
+        while((due = link->expired(now, &frame, &value)) != 0){
+            if(due > 0){
+                // The first message after the link header tells the priority of the frame
+                uint8_t flags = value > RELIABLE_OVERHEAD ? ((const msg_header*)(frame + RELIABLE_OVERHEAD))->flags : 0;
+                transmitRaw(key, frame, value, 0, msgPriority(flags));
+            }else{
+                QEN_LOG_ERROR(LOG_FROM_APP, LOG_RELIABLE_GIVE_UP, this->peers.get(key)->mac, value);
+            }
+        }
+
+        // Acknowledgments that no data frame carried go on their own
+        uint8_t ack[RELIABLE_OVERHEAD];
+        int len = link->ackFrame(now, ack);
+        if(len > 0){
+            transmitRaw(key, ack, len);
+        }
+    }
+}
+
+void QuickESPNow::enableReliable(int id, int window){
+    int key = this->peers.find(id);
+    if(key == -1 || key >= MAX_PEERS){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return;
+    }
+    const peer_entry* peer = this->peers.get(key);
+
+    Reliable_Link* link = QuickESPNow::links[key];
+    if(link == nullptr){
+        link = new Reliable_Link(peer->mac, window);
+        QuickESPNow::links[key] = link;
+    }else if(!link->matches(peer->mac)){
+        link->setEnabled(false);
+        link->reset(peer->mac, window); // The slot was given to another peer
+    }else{
+        link->setWindow(window);
+    }
+
+    if(this->batches != nullptr){
+        flushBatch(key); // The pending batch may not leave room for the link header
+    }
+    link->setEnabled(true);
+}
+
+void QuickESPNow::disableReliable(int id){
+    int key = this->peers.find(id);
+    Reliable_Link* link = reliableLink(key);
+    if(link != nullptr){
+        link->setEnabled(false);
+    }
+}
+
+int QuickESPNow::unacknowledged(int id) const{
+    Reliable_Link* link = reliableLink(this->peers.find(id));
+    return link != nullptr ? link->unacknowledged() : 0;
+}
+
+void QuickESPNow::enableDelta(int id, int keyframe_interval){
+    int key = this->peers.find(id);
+    if(key == -1 || key >= MAX_PEERS){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return;
+    }
+    if(QuickESPNow::deltas == nullptr){
+        QuickESPNow::deltas = new Delta_Table();
+    }
+    QuickESPNow::deltas->enable(key, keyframe_interval);
+}
+
+void QuickESPNow::disableDelta(int id){
+    if(QuickESPNow::deltas != nullptr){
+        QuickESPNow::deltas->disable(this->peers.find(id));
+    }
+}
+
+void QuickESPNow::enableCompression(int id){
+    int key = this->peers.find(id);
+    if(key == -1 || key >= MAX_PEERS){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_UNKNOWN_ID, nullptr, id);
+        return;
+    }
+    if(this->compressor == nullptr){
+        Lz_Codec* created = new Lz_Codec();
+        if(!created->isValid()){
+            delete created;
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_ALLOCATION_FAIL, nullptr, 0);
+            return;
+        }
+        this->compressor = created;
+    }
+    this->compressed_peers |= 1u << key;
+}
+
+void QuickESPNow::disableCompression(int id){
+    int key = this->peers.find(id);
+    if(key != -1 && key < MAX_PEERS){
+        this->compressed_peers &= ~(1u << key);
+    }
+}
+
+void QuickESPNow::enableFragmentation(size_t arena_size, unsigned long timeout_ms){
+    if(QuickESPNow::reassembler == nullptr){
+        Frag_Reassembler* created = new Frag_Reassembler(arena_size, timeout_ms);
+        if(!created->isValid()){
+            delete created;
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_ALLOCATION_FAIL, nullptr, 0);
+            return;
+        }
+        QuickESPNow::recieved_msgs.setLargeStore(created);
+        QuickESPNow::inboxes.setLargeStore(created);
+        QuickESPNow::reassembler = created;
+        return;
+    }
+    // The arena is allocated once, only the timeout can change
+    QuickESPNow::reassembler->setTimeout(timeout_ms);
+    QuickESPNow::reassembler->setEnabled(true);
+}
+
+void QuickESPNow::disableFragmentation(){
+    if(QuickESPNow::reassembler != nullptr){
+        QuickESPNow::reassembler->setEnabled(false);
+    }
+}
+
+void QuickESPNow::enableBatching(unsigned long deadline_ms){
+    if(this->batches == nullptr){
+        this->batches = (frame_batch*)malloc(this->peers.capacity()*sizeof(frame_batch));
+        if(this->batches == nullptr){
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_ALLOCATION_FAIL, nullptr, 0);
+            return;
+        }
+        for(int i = 0; i < this->peers.capacity(); i++){
+            this->batches[i].length = 0;
+        }
+    }
+    this->batch_deadline = deadline_ms;
+}
+
+void QuickESPNow::disableBatching(){
+    flush();
+    free(this->batches);
+    this->batches = nullptr;
+}
+
+void QuickESPNow::flush(){
+    if(this->batches == nullptr){
+        return;
+    }
+    for(int i = 0; i < this->peers.capacity(); i++){
+        if(this->peers.get(i) != nullptr){
+            flushBatch(i);
+        }
+    }
+}
+
+void QuickESPNow::enableTxScheduler(unsigned long settle_ms, int starvation_limit){
+    if(this->scheduler == nullptr){
+        this->scheduler = new Tx_Scheduler(settle_ms, starvation_limit);
+    }
+}
+
+void QuickESPNow::disableTxScheduler(){
+    if(this->scheduler == nullptr){
+        return;
+    }
+    flush();
+    while(!this->scheduler->isEmpty()){
+        drainScheduler();
+        delay(1);
+    }
+    delete this->scheduler;
+    this->scheduler = nullptr;
+}
+
+void QuickESPNow::drainScheduler(){
+    int hop_to;
+    const tx_frame* next;
+    while((next = this->scheduler->front(this->current_channel, millis(), &hop_to)) != nullptr){
+        // The driver sends in order, the frames kept here can still be overtaken by urgent ones
+        if(QuickESPNow::track_sends && QuickESPNow::send_tracker.inFlight() >= TX_DRIVER_DEPTH){
+            return;
+        }
+        esp_err_t result = sendToDriver(next->key, next->frame, next->length, next->handle);
+        if(result == ESP_ERR_ESPNOW_NO_MEM){
+            return; // The driver's queue is full, retry on the next update
+        }
+        if(result == ESP_OK){
+            QEN_LOG_DEBUG(LOG_FROM_APP, LOG_SEND_OK, this->peers.get(next->key)->mac, 0);
+        }else{
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_SEND_FAIL, this->peers.get(next->key)->mac, result);
+            if(QuickESPNow::deltas != nullptr){
+                QuickESPNow::deltas->resync(next->key);
+            }
+        }
+        if(result != ESP_OK && next->handle != 0){
+            QuickESPNow::send_tracker.release(next->key, next->handle);
+        }
+        this->scheduler->pop();
+    }
+
+    if(hop_to != -1){
+        switchChannel(hop_to);
+        this->scheduler->hopped(millis());
+    }
+}
+
+void QuickESPNow::update(){
+    if(this->batches != nullptr){
+        unsigned long now = millis();
+        for(int i = 0; i < this->peers.capacity(); i++){
+            if(this->batches[i].length > 0 && now - this->batches[i].opened_at >= this->batch_deadline){
+                flushBatch(i);
+            }
+        }
+    }
+
+    serviceLinks();
+    serviceGroups();
+    serviceClock();
+
+    if(this->scheduler != nullptr){
+        drainScheduler();
+    }
+
+    QEN_LOG_DRAIN(LOG_DRAIN_PER_UPDATE);
+}
+/***************************************************/
+
 /**************Checking for istalisation errors**************/
 bool QuickESPNow::FAIL_CHECK() {
     if(this->error_counter == 0) {
-        Serial.println("\r[SUCCESS] THERE WERE NO INITIALIZATION ERROR");
+        QEN_LOG_INFO(LOG_FROM_APP, LOG_SETUP_OK, nullptr, 0);
+        QEN_LOG_DRAIN(2 * LOG_BUFFER_CAPACITY);
         return false;
     }
     for(int i = 0; i < this->error_counter; i++) {
-        if(this->setup_errors[i]==ESP_NOW_INITIALIZATION_ERROR) Serial.println("\r[Error] initializing ESP-NOW");
-        else if(this->setup_errors[i]==ESP_NOW_COMMUNICATION_SETUP_ERROR ) Serial.println("\r[Error] in the consructors communication parameter");
-        else if(this->setup_errors[i]==CHANNEL_OUT_OF_RANGRE) Serial.println("\r[Error] in the value of the channel (channel ranges 0-13)");        
-        else if(this->setup_errors[i]==NEW_MAC_INITIALIZATION_ERROR) Serial.println("\r[Error] setting new MAC address");
-        else if(this->setup_errors[i]==ADD_PEER_INITIALIZATION_ERROR) Serial.println("\r[Error] adding peer");
-        else if(this->setup_errors[i]==MEMORY_ALLOCATION_ERROR) Serial.println("\r[Error] allocating memory");
-    }
-    Serial.println();
+        QEN_LOG_ERROR(LOG_FROM_APP, LOG_SETUP_ERROR, nullptr, this->setup_errors[i]);
+    }
+    QEN_LOG_DRAIN(2 * LOG_BUFFER_CAPACITY);
     return true;
 }
 /***********************************************************/
 
+/**************Status of the asynchronous messages**************/
+SEND_STATUS QuickESPNow::sendStatus(int handle) const{
+    return QuickESPNow::send_tracker.status(handle);
+}
+
+void QuickESPNow::onSendComplete(send_complete_cb_t custom){
+    QuickESPNow::send_tracker.setCallback(custom);
+}
+/***************************************************************/
+
 /**************Checking if the esp has recieved any msg**************/
+Msg_Queue* QuickESPNow::inboxAt(int position){
+    return position == MAX_PEERS ? &QuickESPNow::recieved_msgs : QuickESPNow::inboxes.queue(position);
+}
+
+Msg_Queue* QuickESPNow::frontQueue(){
+    // Stays on the same queue until its front is read, so data_type() and read() refer to the same message
+    Msg_Queue* queue = inboxAt(QuickESPNow::read_cursor);
+    if(QuickESPNow::read_chosen && queue != nullptr && !queue->isEmpty()){
+        return queue;
+    }
+
+    // The highest priority wins, the first queue after the last one read wins a tie
+    int best = -1;
+    int best_priority = -1;
+    for(int step = 0; step <= MAX_PEERS; step++){
+        int position = (QuickESPNow::read_cursor + step) % (MAX_PEERS + 1);
+        queue = inboxAt(position);
+        int priority = queue != nullptr ? queue->frontPriority() : -1;
+        if(priority > best_priority){
+            best = position;
+            best_priority = priority;
+        }
+    }
+    if(best == -1){
+        return &QuickESPNow::recieved_msgs;
+    }
+    QuickESPNow::read_cursor = best;
+    QuickESPNow::read_chosen = true;
+    return inboxAt(best);
+}
+
+void QuickESPNow::nextInbox(){
+    QuickESPNow::read_cursor = (QuickESPNow::read_cursor + 1) % (MAX_PEERS + 1);
+    QuickESPNow::read_chosen = false;
+}
+
+Msg_Queue* QuickESPNow::inbox(int id) const{
+    int key = this->peers.find(id);
+    return key != -1 ? QuickESPNow::inboxes.queue(key) : nullptr;
+}
+
 bool QuickESPNow::available() const{
-    return !this->recieved_msgs.isEmpty();
+    return !frontQueue()->isEmpty();
+}
+
+bool QuickESPNow::available(int id) const{
+    Msg_Queue* queue = inbox(id);
+    return queue != nullptr && !queue->isEmpty();
+}
+
+int QuickESPNow::from() const{
+    Msg_Queue* queue = frontQueue();
+    return queue->isEmpty() ? -1 : queue->sender();
+}
+
+bool QuickESPNow::waitMessage(Msg_Queue* queue, unsigned long timeout_ms){
+    auto ready = [queue](){ return !(queue != nullptr ? queue : frontQueue())->isEmpty(); };
+    if(ready()){
+        return true;
+    }
+    if(QuickESPNow::rx_signal == nullptr){
+        QuickESPNow::rx_signal = xSemaphoreCreateBinary();
+        if(QuickESPNow::rx_signal == nullptr){
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_ALLOCATION_FAIL, nullptr, 0);
+            return false;
+        }
+    }
+
+    // A give left over from an earlier wait only costs one more check
+    QuickESPNow::rx_waiting.store(true, std::memory_order_seq_cst);
+    unsigned long start = millis();
+    bool found;
+    while(!(found = ready())){
+        unsigned long elapsed = millis() - start;
+        if(elapsed >= timeout_ms || xSemaphoreTake(QuickESPNow::rx_signal, pdMS_TO_TICKS(timeout_ms - elapsed)) != pdTRUE){
+            found = ready();
+            break;
+        }
+    }
+    QuickESPNow::rx_waiting.store(false, std::memory_order_relaxed);
+    return found;
+}
+
+bool QuickESPNow::waitAvailable(unsigned long timeout_ms){
+    return waitMessage(nullptr, timeout_ms);
+}
+
+bool QuickESPNow::waitAvailable(int id, unsigned long timeout_ms){
+    Msg_Queue* queue = inbox(id);
+    return queue != nullptr && waitMessage(queue, timeout_ms);
+}
+
+void QuickESPNow::setOverflowPolicy(OVERFLOW_POLICY policy){
+    QuickESPNow::recieved_msgs.setOverflowPolicy(policy);
+    QuickESPNow::inboxes.setOverflowPolicy(policy);
+}
+
+void QuickESPNow::setOverflowPolicy(int id, OVERFLOW_POLICY policy){
+    Msg_Queue* queue = inbox(id);
+    if(queue != nullptr){
+        queue->setOverflowPolicy(policy);
+    }
+}
+
+uint32_t QuickESPNow::dropped() const{
+    uint32_t total = 0;
+    for(int position = 0; position <= MAX_PEERS; position++){
+        Msg_Queue* queue = inboxAt(position);
+        if(queue != nullptr){
+            total += queue->dropped();
+        }
+    }
+    if(QuickESPNow::dispatcher != nullptr){
+        total += QuickESPNow::dispatcher->dropped();
+    }
+    return total;
+}
+
+uint32_t QuickESPNow::dropped(int id) const{
+    Msg_Queue* queue = inbox(id);
+    return queue != nullptr ? queue->dropped() : 0;
+}
+
+bool QuickESPNow::setHandler(uint8_t type, bool array, handler_invoke_t invoke, void* handler){
+    if(QuickESPNow::dispatcher == nullptr){
+        if(invoke == nullptr){
+            return true;
+        }
+        QuickESPNow::dispatcher = new Msg_Dispatcher();
+    }
+    QuickESPNow::dispatcher->setHandler(type, array, invoke, handler);
+    if(invoke != nullptr && !QuickESPNow::dispatcher->start()){
+        QuickESPNow::dispatcher->setHandler(type, array, nullptr, nullptr);
+        QEN_LOG_ERROR(LOG_FROM_APP, LOG_ALLOCATION_FAIL, nullptr, 0);
+        return false;
+    }
+    return true;
+}
+
+void QuickESPNow::disableDispatch(){
+    if(QuickESPNow::dispatcher != nullptr){
+        QuickESPNow::dispatcher->stop();
+    }
+}
+
+bool QuickESPNow::linkStats(int id, link_stats& output) const{
+    return QuickESPNow::link_quality.snapshot(this->peers.find(id), &output);
+}
+
+void QuickESPNow::metrics(perf_snapshot& output) const{
+    memset(&output, 0, sizeof(perf_snapshot));
+    Perf_Counters::snapshot(&output);
+    output.queue_drops = dropped();
+    for(int position = 0; position <= MAX_PEERS; position++){
+        Msg_Queue* queue = inboxAt(position);
+        if(queue != nullptr){
+            output.queue_high_water = std::max(output.queue_high_water, queue->highWater());
+        }
+    }
+}
+
+size_t QuickESPNow::metricsJson(char* buffer, size_t size) const{
+    perf_snapshot snapshot;
+    metrics(snapshot);
+    return Perf_Counters::toJson(&snapshot, buffer, size);
+}
+
+void QuickESPNow::resetMetrics(){
+    Perf_Counters::reset();
+    for(int position = 0; position <= MAX_PEERS; position++){
+        Msg_Queue* queue = inboxAt(position);
+        if(queue != nullptr){
+            queue->resetHighWater();
+        }
+    }
+}
+
+Msg_View QuickESPNow::peek(){
+    Msg_Queue* queue = frontQueue();
+    Msg_View view = queue->peek();
+    if(view){
+        nextInbox();
+    }
+    return view;
+}
+
+Msg_View QuickESPNow::peek(int id){
+    Msg_Queue* queue = inbox(id);
+    return queue != nullptr ? queue->peek() : Msg_View();
 }
 
 bool QuickESPNow::isArray() const{
-    return QuickESPNow::recieved_msgs.isFrontArray();
+    return frontQueue()->isFrontArray();
 }
 
 MSG_VARIABLE_TYPE QuickESPNow::data_type() const{
-    return QuickESPNow::recieved_msgs.data_type();
+    return frontQueue()->data_type();
+}
+
+size_t QuickESPNow::data_size() const{
+    return frontQueue()->data_size();
+}
+
+size_t QuickESPNow::data_size(int id) const{
+    Msg_Queue* queue = inbox(id);
+    return queue != nullptr ? queue->data_size() : 0;
 }
 /********************************************************************/
 
@@ -290,26 +1347,56 @@ void QuickESPNow::setWiFi_to_APSTA() {
 }
 
 QuickESPNow::~QuickESPNow(){
-    QuickESPNow::recieved_msgs.~Msg_Queue();
-    for(int i=0; i<this->id_counter; i++){
-        free(this->Peers_MAC[i]);
-    }
-    free(this->Peers_MAC);
+    disableBatching();
+    disableTxScheduler();
     free(this->PMK_key);
-    free(ids);
 
-    for(int i=0; i<this->id_counter; i++){
-        esp_now_del_peer(this->Peers_MAC[i]);
-        delay(10);
+    for(int i=0; i<this->peers.capacity(); i++){
+        const peer_entry* peer = this->peers.get(i);
+        if(peer != nullptr){
+            esp_now_del_peer(peer->mac);
+            delay(10);
+        }
     }
     esp_now_deinit();
+    QuickESPNow::track_sends = false;
+    delete QuickESPNow::dispatcher; // Stops the task, the receive callback is gone
+    QuickESPNow::dispatcher = nullptr;
+    if(QuickESPNow::rx_signal != nullptr){
+        vSemaphoreDelete(QuickESPNow::rx_signal);
+        QuickESPNow::rx_signal = nullptr;
+    }
     
-    QuickESPNow::recieved_msgs.~Msg_Queue();
-    QuickESPNow::recieved_msgs = Msg_Queue();
+    QuickESPNow::recieved_msgs.clear();
+    for(int key = 0; key < MAX_PEERS; key++){
+        if(QuickESPNow::inboxes.queue(key) != nullptr){
+            QuickESPNow::inboxes.queue(key)->clear();
+        }
+        QuickESPNow::mailboxes.closeAll(key);
+    }
+
+    // The receive callback is gone, nothing refers to the arena, the queues or the links anymore
+    QuickESPNow::recieved_msgs.setLargeStore(nullptr);
+    QuickESPNow::inboxes.setLargeStore(nullptr);
+    QuickESPNow::inboxes.reset();
+    QuickESPNow::read_cursor = 0;
+    QuickESPNow::read_chosen = false;
+    delete QuickESPNow::reassembler;
+    QuickESPNow::reassembler = nullptr;
+    delete QuickESPNow::deltas;
+    QuickESPNow::deltas = nullptr;
+    delete this->compressor;
+    QuickESPNow::groups.clear();
+    QuickESPNow::clock_sync.clear();
+    for(int key = 0; key < MAX_PEERS; key++){
+        delete QuickESPNow::links[key];
+        QuickESPNow::links[key] = nullptr;
+    }
 }
 
 
 void QuickESPNow::setCustomSendCallback(esp_now_send_cb_t custom){
+    QuickESPNow::track_sends = false; // The custom callback does not complete the tracked frames
     esp_now_unregister_send_cb();
     esp_now_register_send_cb(custom);
 }
@@ -21,11 +21,28 @@
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 
 #include "QuickESPNow_enums.h"
 #include "QuickESPNow_utils.h"
 #include "QuickESPNow_Queue.h"
+#include "QuickESPNow_RxDemux.h"
+#include "QuickESPNow_Mailbox.h"
+#include "QuickESPNow_Delta.h"
+#include "QuickESPNow_Compress.h"
+#include "QuickESPNow_Group.h"
+#include "QuickESPNow_Dispatch.h"
+#include "QuickESPNow_LinkStats.h"
+#include "QuickESPNow_ClockSync.h"
+#include "QuickESPNow_Metrics.h"
+#include "QuickESPNow_PeerTable.h"
+#include "QuickESPNow_TxScheduler.h"
+#include "QuickESPNow_SendTracker.h"
+#include "QuickESPNow_Fragment.h"
+#include "QuickESPNow_Reliable.h"
+#include "QuickESPNow_Log.h"
 
 
 /**
@@ -34,7 +51,22 @@
  */
 class QuickESPNow {
   private:
-    static Msg_Queue recieved_msgs; 
+    static Msg_Queue recieved_msgs;                     ///< The messages of senders that are not peers.
+    static Rx_Demux inboxes;                            ///< The messages of each peer, sorted by the sender's MAC.
+    static int read_cursor;                             ///< The queue read by the calls without an ID, MAX_PEERS for recieved_msgs.
+    static bool read_chosen;                            ///< Whether the front message of the read_cursor queue was chosen.
+    static Mailbox_Table mailboxes;                     ///< The newest message of the (peer, type) pairs that skip the queues.
+    static Send_Tracker send_tracker;                   ///< The frames waiting for their send callback.
+    static bool track_sends;                            ///< Whether OnDataSent is registered and frames are tracked.
+    static Frag_Reassembler* reassembler;               ///< Puts the fragmented messages back together, nullptr until enableFragmentation().
+    static Reliable_Link* links[MAX_PEERS];             ///< The reliable link of each peer slot, nullptr until enableReliable().
+    static Delta_Table* deltas;                         ///< The states of the delta encoded messages, nullptr until enableDelta().
+    static Group_Table groups;                          ///< The groups this board sends to or belongs to.
+    static Msg_Dispatcher* dispatcher;                  ///< Runs the handlers of the received messages, nullptr until onMessage().
+    static SemaphoreHandle_t rx_signal;                 ///< Given by the receive callback while a task waits for a message, nullptr until the first wait.
+    static std::atomic<bool> rx_waiting;                ///< Whether a task waits in waitAvailable().
+    static Link_Stats_Table link_quality;               ///< The quality of the link with each peer, from the metadata of the received frames.
+    static Clock_Sync clock_sync;                       ///< The round trips and clock offsets to the peers, and the pongs owed to them.
     /********The callback_fuctions for sending and reiciving messages********/
 
     /**
@@ -69,6 +101,33 @@ class QuickESPNow {
         #error unsapported board 
     #endif
 
+    /**
+     * @brief   Queues the messages of a received frame in the queue of its sender, fragments go to the reassembler
+     * @param   mac_addr MAC address of the peer that sent the frame.
+     * @param   incomingData The raw data received.
+     * @param   len The length of the received data.
+     */
+    static void receiveFrame(const uint8_t *mac_addr, const wifi_pkt_rx_ctrl_t *rx_ctrl, const uint8_t *incomingData, int len);
+
+    /**
+     * @brief   Passes a reliable frame to the link of its sender and delivers its frames in order
+     * @param   mac_addr MAC address of the peer that sent the frame.
+     * @param   key The slot of the peer that sent the frame.
+     * @param   incomingData The raw data received, starting with the link message.
+     * @param   len The length of the received data.
+     */
+    static void receiveReliable(const uint8_t *mac_addr, int key, const uint8_t *incomingData, int len);
+
+    /**
+     * @brief   Queues the messages of a frame, fragments go to the reassembler and mailbox messages to their mailbox
+     * @param   mac_addr MAC address of the peer that sent the frame.
+     * @param   key The slot of the peer that sent the frame, -1 if it is not a peer.
+     * @param   queue The queue of the sender.
+     * @param   incomingData The messages.
+     * @param   len The length of the messages.
+     */
+    static void deliverFrame(const uint8_t *mac_addr, int key, Msg_Queue* queue, const uint8_t *incomingData, int len);
+
     /************************************************************************/
 
     int error_counter = 0;                              ///< Counter to track the number of errors during initialization.
@@ -79,12 +138,233 @@ class QuickESPNow {
     static uint8_t Local_MAC[MAC_LENGTH];               ///< Array to hold the local MAC address of the ESP.
     char* PMK_key = nullptr;                            ///< Pointer to hold the PMK encryption key for secure communication.
     
-    int id_counter = 0;                                 ///< Counter to assign unique IDs to peers.
-    int* ids;                                           ///< Pointer to an array storing IDs of peers.
-    
-    uint8_t** Peers_MAC;                                ///< Pointer to a 2D array storing MAC addresses of peers.
+    Peer_Table peers;                                   ///< The registered peers and their cached driver state.
+    int current_channel = 0;                            ///< The channel the radio is currently set to.
     bool Encryption;                                    ///< Flag indicating whether encryption is enabled or not.
-    char** LMK_key;                                     ///< Pointer to an array of LMK encryption keys for each peer.
+
+    /**
+     * @struct  frame_batch
+     * @brief   Messages waiting to be sent to a peer in a single frame.
+     */
+    struct frame_batch {
+        uint8_t frame[ESPNOW_MTU];                      ///< The messages packed back to back.
+        int length;                                     ///< Number of used bytes in the frame.
+        unsigned long opened_at;                        ///< Time (ms) the first message was added.
+    };
+
+    frame_batch* batches = nullptr;                     ///< One batch per peer, nullptr while batching is disabled.
+    unsigned long batch_deadline = 0;                   ///< Maximum time (ms) a message waits in a batch.
+
+    Tx_Scheduler* scheduler = nullptr;                  ///< The outgoing frames, nullptr while the scheduler is disabled.
+    uint16_t next_msg_id = 0;                           ///< ID of the next fragmented message.
+    Lz_Codec* compressor = nullptr;                     ///< Compresses the fragmented messages, nullptr until enableCompression().
+    uint32_t compressed_peers = 0;                      ///< Bit of each peer slot whose fragmented messages are compressed.
+    bool broadcast_added = false;                       ///< Whether the broadcast address was added to the driver for the group frames.
+
+    /**
+     * @brief   Switches the radio to a channel without waiting for it to settle
+     * @param   ch The channel that the ESP will be set
+     */
+    void switchChannel(int ch);
+
+    /**
+     * @brief   Sends the scheduled frames that can be sent without waiting, keeping at most TX_DRIVER_DEPTH in the driver
+     */
+    void drainScheduler();
+
+    /**
+     * @brief   Sends an encoded message to a peer, or adds it to the peer's batch
+     * @note    A message above PRIORITY_NORMAL is never batched, it goes in its own frame
+     * @param   id Peers's setted ID
+     * @param   msg The encoded message
+     * @param   len The number of bytes of the encoded message
+     */
+    void sendFrame(const int id, const msg_struct* msg, int len);
+
+    /**
+     * @brief   Sends an encoded asynchronous message to a peer
+     * @param   id Peers's setted ID
+     * @param   msg The encoded message
+     * @param   len The number of bytes of the encoded message
+     * @return  The handle of the message, -1 if it could not be sent
+     */
+    int sendFrameAsync(const int id, const msg_struct* msg, int len);
+
+    /**
+     * @brief   Sends the pending batch of a peer
+     * @param   key The slot of the peer
+     */
+    void flushBatch(int key);
+
+    /**
+     * @brief   Sends a raw frame to a peer, in a reliable frame if the peer's link is enabled
+     * @note    A full reliable window blocks until acknowledgments make room, up to RELIABLE_SEND_TIMEOUT_MS
+     * @param   key The slot of the peer
+     * @param   frame The raw bytes of the frame
+     * @param   len The length of the frame
+     * @param   handle The handle of an asynchronous message, 0 otherwise
+     * @param   priority The priority of the frame in the scheduler
+     * @return
+     *          - true : The frame was sent or queued
+     *          - false : The frame was dropped
+     */
+    bool transmit(int key, const uint8_t* frame, int len, int handle = 0, MSG_PRIORITY priority = PRIORITY_NORMAL);
+
+    /**
+     * @brief   Sends a raw frame to a peer as it is, switching to the peer's channel if needed
+     * @note    With the scheduler enabled the frame is queued instead
+     * @param   key The slot of the peer
+     * @param   frame The raw bytes of the frame
+     * @param   len The length of the frame
+     * @param   handle The handle of an asynchronous message, 0 otherwise
+     * @param   priority The priority of the frame in the scheduler
+     * @return
+     *          - true : The frame was sent or queued
+     *          - false : The frame was dropped
+     */
+    bool transmitRaw(int key, const uint8_t* frame, int len, int handle = 0, MSG_PRIORITY priority = PRIORITY_NORMAL);
+
+    /**
+     * @brief   Gives the reliable link of a peer
+     * @param   key The slot of the peer
+     * @return  The link, nullptr if reliable mode is not enabled for the peer
+     */
+    Reliable_Link* reliableLink(int key) const;
+
+    /**
+     * @brief   Handles the acknowledgments, retransmissions and standalone acknowledgments of the reliable links
+     */
+    void serviceLinks();
+
+    /**
+     * @brief   Hands a frame to the driver and records it for the send callback
+     * @param   key The slot of the peer
+     * @param   frame The raw bytes of the frame
+     * @param   len The length of the frame
+     * @param   handle The handle of an asynchronous message, 0 otherwise
+     * @return  The result of esp_now_send, ESP_ERR_ESPNOW_NO_MEM if too many frames are in flight
+     */
+    esp_err_t sendToDriver(int key, const uint8_t* frame, int len, int handle);
+
+    /**
+     * @brief   Counts a frame handed to the driver in the performance counters
+     * @param   result The result of esp_now_send
+     * @param   len The length of the frame
+     */
+    static void countSend(esp_err_t result, int len);
+
+    /**
+     * @brief   Sends a message that does not fit in a frame as a sequence of fragments, compressed first if the peer allows it
+     * @note    Blocks until every fragment is handed to the driver (or the scheduler)
+     * @param   id Peers's setted ID
+     * @param   type The type tag of the message
+     * @param   flags The flags of the message
+     * @param   bytes The message
+     * @param   total The size of the message in bytes
+     */
+    void sendLarge(const int id, uint8_t type, uint8_t flags, const uint8_t* bytes, uint32_t total);
+
+    /**
+     * @brief   Sends the fragments of a message
+     * @param   key The slot of the peer
+     * @param   type The type tag of the message
+     * @param   flags The flags of the message
+     * @param   bytes The message
+     * @param   total The size of the message in bytes
+     */
+    void sendFragments(int key, uint8_t type, uint8_t flags, const uint8_t* bytes, uint32_t total);
+
+    /**
+     * @brief   Sends an encoded message to the members of a group in a single broadcast frame
+     * @param   group The ID of the group
+     * @param   msg The encoded message
+     * @param   len The number of bytes of the encoded message
+     */
+    void sendGroupFrame(int group, const msg_struct* msg, int len);
+
+    /**
+     * @brief   Sends the acknowledgments owed to the senders of group frames
+     */
+    void serviceGroups();
+
+    /**
+     * @brief   Tunes the radio to the channel of a peer for a clock probe
+     * @param   key The slot of the peer
+     * @return  false if the transmit scheduler is on another channel, the probe waits for it
+     */
+    bool probeChannel(int key);
+
+    /**
+     * @brief   Sends a ping to a peer, stamped right before it is handed to the driver
+     * @param   key The slot of the peer
+     * @return  Whether the driver took the ping
+     */
+    bool sendPing(int key);
+
+    /**
+     * @brief   Sends the pongs owed to the peers and the periodic pings that are due
+     */
+    void serviceClock();
+
+    /**
+     * @brief   Gives the queue of a position of the read cursor
+     * @param   position The slot of a peer, MAX_PEERS for the senders that are not peers
+     * @return  The queue, nullptr if the slot was never opened
+     */
+    static Msg_Queue* inboxAt(int position);
+
+    /**
+     * @brief   Gives the queue read by the calls without an ID
+     * @note    The queue whose front message has the highest priority is chosen, the queues of the same
+     *          priority take turns, one message each, so a busy peer can not hold up the others.
+     *          The same queue is kept until its front message is read.
+     * @return  The queue, an empty one if no message was received
+     */
+    static Msg_Queue* frontQueue();
+
+    /**
+     * @brief   Moves the read cursor to the next queue once a message was read from the front queue
+     */
+    static void nextInbox();
+
+    /**
+     * @brief   Gives the queue of a peer
+     * @param   id Peers's setted ID
+     * @return  The queue, nullptr if there is no peer with this ID
+     */
+    Msg_Queue* inbox(int id) const;
+
+    /**
+     * @brief   Removes the front value of a queue, a value of another registered type is dropped
+     * @return  Same as Msg_Queue::tryPop
+     */
+    template<typename T>
+    static int popValue(Msg_Queue* queue, T* value);
+
+    /**
+     * @brief   Removes the front array of a queue, an array of another registered type is dropped
+     * @return  Same as Msg_Queue::tryPopArray
+     */
+    template<typename T>
+    static int popArray(Msg_Queue* queue, T* output);
+
+    /**
+     * @brief   Sets or removes the handler of a type tag, the dispatch task is started with the first handler
+     * @param   type The type tag
+     * @param   array Whether the handler is for arrays
+     * @param   invoke The caller of the handler, nullptr to remove it
+     * @param   handler The function registered by the application
+     * @return  false if the dispatch task could not be started
+     */
+    bool setHandler(uint8_t type, bool array, handler_invoke_t invoke, void* handler);
+
+    /**
+     * @brief   Blocks until a queue has a message, the receive callback wakes the task
+     * @param   queue The queue to wait for, nullptr for the queues read by the calls without an ID
+     * @param   timeout_ms The maximum time to wait (ms)
+     * @return  Whether the queue has a message
+     */
+    bool waitMessage(Msg_Queue* queue, unsigned long timeout_ms);
 
   public:
     /********Constructors********/
@@ -146,6 +426,12 @@ class QuickESPNow {
      */
     void addPeer(int id, esp_now_peer_info_t* Peer);
 
+    /**
+     * @brief   Removes a peer and forgets its cached information
+     * @param   id The ID number that was assigned to this peer
+     */
+    void removePeer(int id);
+
     /**
      * @brief   Set custom send callback function
      * @param   custom The function to be called when a message is sent
@@ -160,6 +446,7 @@ class QuickESPNow {
 
     /**
      * @brief   Prints all the possible initialization errors
+     * @note    Also prints every buffered log record
      * 
      * @return
      *          - true : There were no errors
@@ -169,6 +456,192 @@ class QuickESPNow {
     /********Setting up the esps network********/
     
     /********Msg sending and recieving methods********/
+    /**
+     * @brief   Packs the messages sent to the same peer into a single frame
+     * @param   deadline_ms The maximum time (ms) a message waits before its frame is sent
+     * @note    A frame is sent when it is full, when the deadline expires or when flush() is called
+     * @note    The deadline is checked on every Send() and update() call
+     */
+    void enableBatching(unsigned long deadline_ms);
+
+    /**
+     * @brief   Sends the pending frames and goes back to one frame per message
+     */
+    void disableBatching();
+
+    /**
+     * @brief   Sends every pending batched frame
+     */
+    void flush();
+
+    /**
+     * @brief   Queues the outgoing frames and sends them grouped by the channel of their peer
+     * @param   settle_ms The time (ms) the radio needs after a channel switch
+     * @param   starvation_limit The number of frames sent on a channel before the other channels get a turn
+     * @note    Send() no longer blocks on a channel switch, the frames are sent by update()
+     */
+    void enableTxScheduler(unsigned long settle_ms, int starvation_limit);
+
+    /**
+     * @brief   Sends the pending frames and goes back to sending each frame immediately
+     * @note    This waits for the channel switches that are still needed
+     */
+    void disableTxScheduler();
+
+    /**
+     * @brief   Accepts arrays larger than a frame, they are received in fragments and put back together
+     * @param   arena_size The memory (bytes) reserved for the messages being reassembled or waiting to be read
+     * @param   timeout_ms The time (ms) without fragments after which an incomplete message is dropped
+     * @note    Up to FRAG_CONTEXTS messages can be reassembled at the same time, the arena is allocated once
+     * @note    Sending large arrays does not need it, only receiving them
+     */
+    void enableFragmentation(size_t arena_size, unsigned long timeout_ms);
+
+    /**
+     * @brief   Stops accepting fragments, the messages already reassembled can still be read
+     */
+    void disableFragmentation();
+
+    /**
+     * @brief   Compresses the messages sent to a peer in fragments, such as large arrays
+     * @param   id Peers's setted ID
+     * @note    A message that does not shrink by at least an eighth is sent as it is, messages that fit in a frame are never compressed
+     * @note    The receiver restores the message after reassembly, which needs room in its arena for both sizes
+     * @note    The compressor takes 4 * 2^COMPRESS_HASH_BITS bytes, plus a buffer of the message size while it is sent
+     */
+    void enableCompression(int id);
+
+    /**
+     * @brief   Sends the fragmented messages to a peer as they are again
+     * @param   id Peers's setted ID
+     */
+    void disableCompression(int id);
+
+    /**
+     * @brief   Makes sure every frame sent to a peer is received and delivered in order
+     * @param   id Peers's setted ID
+     * @param   window The number of frames that can wait for their acknowledgment, 1 to RELIABLE_WINDOW (1 is stop-and-wait)
+     * @attention   Both boards must enable reliable mode for each other and call update() often,
+     *              it sends the acknowledgments and the retransmissions
+     * @note    A frame is acknowledged only once its messages are in the receive queue, so a full queue
+     *          slows the sender down instead of losing messages
+     * @note    Send() blocks while the window is full, messages larger than ESPNOW_MTU - RELIABLE_OVERHEAD are sent in fragments
+     */
+    void enableReliable(int id, int window);
+
+    /**
+     * @brief   Goes back to sending the frames of a peer once, without acknowledgments
+     * @param   id Peers's setted ID
+     */
+    void disableReliable(int id);
+
+    /**
+     * @brief   Gives the number of reliable frames sent to a peer that were not acknowledged yet
+     * @param   id Peers's setted ID
+     * @return  The number of frames, 0 if reliable mode is not enabled for the peer
+     */
+    int unacknowledged(int id) const;
+
+    /**
+     * @brief   Sends only the bytes that changed since the previous message of the same type to a peer
+     * @param   id Peers's setted ID
+     * @param   keyframe_interval The number of messages between two keyframes, which carry the whole value
+     * @attention   Both boards must enable delta encoding for each other, the receiver rebuilds the whole
+     *              value before read() or latest() returns it
+     * @note    Applies to the values sent with Send() at PRIORITY_NORMAL, a delta that arrives after a lost
+     *          message is dropped until the next keyframe. A failed delivery reported by the send callback
+     *          makes the next message a keyframe.
+     * @note    Up to DELTA_CONTEXTS (peer, type) pairs are delta encoded, the other messages are sent whole
+     */
+    void enableDelta(int id, int keyframe_interval = DELTA_KEYFRAME_INTERVAL);
+
+    /**
+     * @brief   Sends the values to a peer whole again
+     * @param   id Peers's setted ID
+     */
+    void disableDelta(int id);
+
+    /**
+     * @brief   Adds a peer to a group, sendGroup() reaches every member with a single broadcast frame
+     * @param   group The ID of the group, 0 to 255
+     * @param   id Peers's setted ID
+     * @example     object.addToGroup(LEGS, KNEE_ID); object.addToGroup(LEGS, HIP_ID);
+     * 
+     * @return
+     *          - true : The peer is a member of the group
+     *          - false : There is no peer with this ID, the group ID is invalid or all GROUP_CAPACITY groups are in use
+     */
+    bool addToGroup(int group, int id);
+
+    /**
+     * @brief   Removes a peer from a group
+     * @param   group The ID of the group
+     * @param   id Peers's setted ID
+     */
+    void removeFromGroup(int group, int id);
+
+    /**
+     * @brief   Accepts the frames sent to a group, the frames of the other groups are dropped before they reach a queue
+     * @param   group The ID of the group, 0 to 255
+     * @note    The messages are read like the others, from() gives the sender if it is a peer
+     * 
+     * @return
+     *          - true : This board receives the frames of the group
+     *          - false : The group ID is invalid or all GROUP_CAPACITY groups are in use
+     */
+    bool joinGroup(int group);
+
+    /**
+     * @brief   Stops accepting the frames sent to a group
+     * @param   group The ID of the group
+     */
+    void leaveGroup(int group);
+
+    /**
+     * @brief   Makes the members acknowledge every frame sent to a group, poll the replies with groupAcks()
+     * @param   group The ID of the group
+     * @attention   A member only replies to a sender it added as a peer, from update()
+     * @note    Only the latest frame sent to the group is tracked, sending again starts a new count
+     */
+    void enableGroupAcks(int group);
+
+    /**
+     * @brief   Sends the frames of a group without asking for acknowledgments again
+     * @param   group The ID of the group
+     */
+    void disableGroupAcks(int group);
+
+    /**
+     * @brief   Gives the number of members that acknowledged the latest frame sent to a group
+     * @param   group The ID of the group
+     * 
+     * @return
+     *          - count : The number of members that replied
+     *          - -1 : The group does not collect acknowledgments
+     */
+    int groupAcks(int group) const;
+
+    /**
+     * @brief   Checks if every member acknowledged the latest frame sent to a group
+     * @param   group The ID of the group
+     * @example     object.sendGroup(LEGS, setpoint); ... if(!object.groupDelivered(LEGS)){ object.sendGroup(LEGS, setpoint); }
+     * 
+     * @return
+     *          - true : Every member replied
+     *          - false : A member did not reply yet, or the group does not collect acknowledgments
+     */
+    bool groupDelivered(int group) const;
+
+    /**
+     * @brief   Runs the periodic work of the library, call it on every loop
+     * @note    Sends the batched frames whose deadline has expired
+     * @note    Sends the scheduled frames and switches channel when needed
+     * @note    Sends the acknowledgments and retransmissions of the reliable peers
+     * @note    Sends the acknowledgments of the group frames
+     * @note    Prints up to LOG_DRAIN_PER_UPDATE buffered log records
+     */
+    void update();
+
     /**
      * @brief   Checks if the ESP received any messages
      * 
@@ -178,14 +651,293 @@ class QuickESPNow {
      */
     bool available() const;           // Check if a message was received
 
+    /**
+     * @brief   Checks if the ESP received any messages from a peer
+     * @param   id Peers's setted ID
+     * 
+     * @return  
+     *          - true: Received a message from the peer
+     *          - false: Did not receive a message from the peer, or there is no peer with this ID
+     */
+    bool available(int id) const;
+
+    /**
+     * @brief   Waits until the ESP receives a message, the CPU is free for other tasks meanwhile
+     * @param   timeout_ms The maximum time to wait (ms)
+     * @note    The receive callback wakes the waiting task as soon as the message is queued.
+     *          Only one task should wait at a time, and the messages that go to a mailbox or a handler do not count
+     * @example     if(object.waitAvailable(1000)){ int value = object.read<int>(); }
+     * 
+     * @return  
+     *          - true: Received a message
+     *          - false: No message arrived in time
+     */
+    bool waitAvailable(unsigned long timeout_ms);
+
+    /**
+     * @brief   Waits until the ESP receives a message from a peer
+     * @param   id Peers's setted ID
+     * @param   timeout_ms The maximum time to wait (ms)
+     * 
+     * @return  
+     *          - true: Received a message from the peer
+     *          - false: No message arrived in time, or there is no peer with this ID
+     */
+    bool waitAvailable(int id, unsigned long timeout_ms);
+
+    /**
+     * @brief   Gives the sender of the message that read(), read_array() and peek() return next
+     * 
+     * @return
+     *          - ID : The ID given to addPeer for the sender
+     *          - -1 : The sender is not a peer, or no message was received
+     */
+    int from() const;
+
+    /**
+     * @brief   Sets what the receive queues do with a new message when they are full
+     * @param   policy The OVERFLOW_POLICY, also given to the peers added later
+     * @note    Each queue holds at most MSG_QUEUE_CAPACITY messages, the memory they use never grows
+     * @example     object.setOverflowPolicy(DROP_OLDEST);
+     */
+    void setOverflowPolicy(OVERFLOW_POLICY policy);
+
+    /**
+     * @brief   Sets what the receive queue of a peer does with a new message when it is full
+     * @param   id Peers's setted ID
+     * @param   policy The OVERFLOW_POLICY
+     * @note    COALESCE_TYPE suits a peer that keeps sending the latest value of the same readings
+     */
+    void setOverflowPolicy(int id, OVERFLOW_POLICY policy);
+
+    /**
+     * @brief   Gives the number of received messages lost because a receive queue was full
+     * @return  The total of the counters of every queue, they only ever grow
+     */
+    uint32_t dropped() const;
+
+    /**
+     * @brief   Gives the number of messages from a peer lost because its receive queue was full
+     * @param   id Peers's setted ID
+     * @return  The number of messages, 0 if there is no peer with this ID
+     */
+    uint32_t dropped(int id) const;
+
+    /**
+     * @brief   Gives the quality of the link with a peer, from the metadata of the frames it sent
+     * @param   id Peers's setted ID
+     * @param   output The variable that will receive the moving average of the RSSI, the packet rate,
+     *          the jitter of the time between frames and the time since the last frame
+     * @note    Every frame from the peer counts, there is no probe traffic. Arduino-ESP32 2.x does not give
+     *          the RSSI to the receive callback, only the frame counts and timing are kept there
+     * @example     link_stats link; if(object.linkStats(ARM_ID, link) && link.rssi < -80){ ... }
+     * 
+     * @return
+     *          - true : The statistics were copied
+     *          - false : There is no peer with this ID or no frame was received from it yet
+     */
+    bool linkStats(int id, link_stats& output) const;
+
+    /**
+     * @brief   Measures the round trip and the clock offset to a peer periodically, the pings are sent by update()
+     * @param   id Peers's setted ID
+     * @param   interval_ms The time between two pings, 0 to only measure with ping()
+     * @note    The peer answers from its own update(), the time the answer waits there does not count in the round trip.
+     *          The probes skip the batches and the transmit scheduler, so that their timestamps are taken right before
+     *          the driver gets them, and wait while the scheduler is on another channel than the peer
+     * @example     object.enableClockSync(ARM_ID, 500);
+     * 
+     * @return
+     *          - true : The peer is probed
+     *          - false : There is no peer with this ID
+     */
+    bool enableClockSync(int id, uint32_t interval_ms = CLOCK_PROBE_INTERVAL_MS);
+
+    /**
+     * @brief   Stops the periodic pings to a peer, the round trips measured so far are kept
+     * @param   id Peers's setted ID
+     */
+    void disableClockSync(int id);
+
+    /**
+     * @brief   Sends a single ping to a peer, its pong is recorded by the receive callback
+     * @param   id Peers's setted ID
+     * @note    The pong of an earlier ping that did not come back yet is ignored
+     * @return
+     *          - true : The ping was sent
+     *          - false : There is no peer with this ID or the driver refused the ping
+     */
+    bool ping(int id);
+
+    /**
+     * @brief   Gives the round trip percentiles and the clock offset to a peer
+     * @param   id Peers's setted ID
+     * @param   output The variable that will receive the estimates
+     * @note    The offset is taken from the round trip with the least delay among the newest CLOCK_FILTER_DEPTH,
+     *          as the clock filter of NTP does, a slow direction shifts it by at most offset_error_us
+     * @example     clock_stats clock; if(object.peerLatency(ARM_ID, clock)){ Serial.println(clock.rtt_p99_us); }
+     * 
+     * @return
+     *          - true : The estimates were copied
+     *          - false : There is no peer with this ID or no round trip to it was measured yet
+     */
+    bool peerLatency(int id, clock_stats& output) const;
+
+    /**
+     * @brief   Gives the offset between the clock of a peer and the local clock (esp_timer_get_time())
+     * @param   id Peers's setted ID
+     * @note    A timestamp t taken by the peer happened at t - peerClockOffset(id) on the local clock
+     * @example     int64_t sent_at; if(object.read(ARM_ID, sent_at)){ int64_t age = esp_timer_get_time() - (sent_at - object.peerClockOffset(ARM_ID)); }
+     * 
+     * @return  The clock of the peer minus the local clock (us), 0 until a round trip was measured
+     */
+    int64_t peerClockOffset(int id) const;
+
+    /**
+     * @brief   Gives the current time on the clock of a peer, to stamp a message in its time base
+     * @param   id Peers's setted ID
+     * @return  esp_timer_get_time() plus the offset of the peer's clock (us)
+     */
+    int64_t peerTime(int id) const;
+
+    /**
+     * @brief   Copies the performance counters, the latency histograms and the state of the receive queues
+     * @param   output The variable that will receive the snapshot
+     * @note    The counters are relaxed atomics updated by every task, cheap enough to leave on. Build with
+     *          QUICKESPNOW_METRICS 0 to compile them out, the snapshot then only has the queue fields.
+     *          The snapshot has a fixed layout of PERF_SNAPSHOT_VERSION, it can be stored or sent as it is
+     */
+    void metrics(perf_snapshot& output) const;
+
+    /**
+     * @brief   Writes the performance counters and latency histograms as a JSON object
+     * @param   buffer The buffer that will receive the text
+     * @param   size The size of the buffer, about 600 bytes hold the whole object
+     * @example     char json[640]; object.metricsJson(json, sizeof(json)); Serial.println(json);
+     * 
+     * @return  The length of the whole text, the text was cut if it is not smaller than size
+     */
+    size_t metricsJson(char* buffer, size_t size) const;
+
+    /**
+     * @brief   Sets the performance counters, the latency histograms and the high-water marks of the receive queues back to zero
+     */
+    void resetMetrics();
+
+    /**
+     * @brief   Keeps only the newest message of a type from a peer, instead of queueing every one
+     * @tparam  T The type of the messages
+     * @param   id Peers's setted ID
+     * @note    Each new message overwrites the previous one in place, read it with latest()
+     * @note    Only single values that fit in a frame are kept, arrays of T are still queued. Structs should be registered
+     *          with QUICKESPNOW_REGISTER_TYPE so that they do not share the mailbox of the UNKNOWN type
+     * @example     object.enableMailbox<joint_state>(ARM_ID);
+     * 
+     * @return
+     *          - true : The messages go to the mailbox
+     *          - false : There is no peer with this ID or all MAILBOX_CAPACITY mailboxes are in use
+     */
+    template<typename T> bool enableMailbox(int id);
+
+    /**
+     * @brief   Queues the messages of a type from a peer again
+     * @tparam  T The type of the messages
+     * @param   id Peers's setted ID
+     */
+    template<typename T> void disableMailbox(int id);
+
+    /**
+     * @brief   Copies the newest message of a type from a peer
+     * @tparam  T The type of the message
+     * @param   id Peers's setted ID
+     * @param   output The variable that will receive the value, left as it is when false is returned
+     * @param   age_us The variable that will receive the time (us) since the message arrived, nullptr if not needed
+     * @note    The message stays in the mailbox, it can be read again until a newer one arrives
+     * @example     if(object.latest(ARM_ID, joints, &age) && age < 50000) { ... }
+     * 
+     * @return
+     *          - true : The value was copied
+     *          - false : The peer has no mailbox for T or no message arrived yet
+     */
+    template<typename T> bool latest(int id, T& output, unsigned long* age_us = nullptr) const;
+
+    /**
+     * @brief   Calls a function for every received value of a type, instead of queueing it
+     * @tparam  T The type of the messages
+     * @param   handler The function to be called with the sender's ID (-1 if it is not a peer) and the value
+     * @note    The handlers run on a task of their own (DISPATCH_TASK_PRIORITY) as soon as the message arrives,
+     *          they must not block for long, the messages that arrive meanwhile wait in a ring of DISPATCH_QUEUE_CAPACITY.
+     *          The types without a handler are read with read() as before, structs should be registered
+     *          with QUICKESPNOW_REGISTER_TYPE so that they do not share the handler of the UNKNOWN type
+     * @example     void onJoints(int from, const joint_state& joints){ ... } ... object.onMessage<joint_state>(onJoints);
+     * 
+     * @return
+     *          - true : The handler is set
+     *          - false : The dispatch task could not be started
+     */
+    template<typename T> bool onMessage(void (*handler)(int from, const T& value));
+
+    /**
+     * @brief   Calls a function for every received array of a type, instead of queueing it
+     * @tparam  T The type of the array elements
+     * @param   handler The function to be called with the sender's ID, the elements and their number
+     * @note    The elements are only valid until the handler returns. Arrays larger than a frame
+     *          (enableFragmentation()) are still queued and read with read_array()
+     * 
+     * @return
+     *          - true : The handler is set
+     *          - false : The dispatch task could not be started
+     */
+    template<typename T> bool onMessage(void (*handler)(int from, const T* values, size_t count));
+
+    /**
+     * @brief   Queues the values and arrays of a type again
+     * @tparam  T The type of the messages
+     */
+    template<typename T> void removeHandler();
+
+    /**
+     * @brief   Stops the dispatch task, every message is queued again until the next onMessage()
+     * @attention   Must not be called from a handler
+     * @note    The handlers are kept, the messages that were waiting for them are dropped
+     */
+    void disableDispatch();
+
     /**
      * @brief   Method for sending non-pointers/non-arrays  
      * @tparam T The type of the array elements
      * @param   id Peers's setted ID
      * @param   msg The message to be sent
+     * @param   priority The priority of the message, the receiver reads the messages of a higher priority first
+     * @example     object.Send(MOTOR_ID, STOP, PRIORITY_URGENT);
      */
     template<typename T> 
-    void Send(const int id, const T msg);
+    void Send(const int id, const T msg, MSG_PRIORITY priority = PRIORITY_NORMAL);
+
+    /**
+     * @brief   Method for sending non-pointers/non-arrays to every member of a group in a single broadcast frame
+     * @tparam T The type of the message
+     * @param   group The ID of the group
+     * @param   msg The message to be sent
+     * @param   priority The priority of the message
+     * @attention   The members must be on the channel the sender is on and must call joinGroup()
+     * @note    A broadcast frame is not acknowledged by the radio, see enableGroupAcks()
+     * @example     object.sendGroup(LEGS, setpoint);
+     */
+    template<typename T>
+    void sendGroup(int group, const T msg, MSG_PRIORITY priority = PRIORITY_NORMAL);
+
+    /**
+     * @brief   Method for sending arrays to every member of a group in a single broadcast frame
+     * @tparam T The type of the array elements
+     * @param   group The ID of the group
+     * @param   msg The message to be sent
+     * @param   size The size of the array
+     * @param   priority The priority of the message
+     * @note    The whole array must fit in MSG_MAX_PAYLOAD - GROUP_OVERHEAD bytes, group messages are not fragmented
+     */
+    template<typename T>
+    void sendGroup(int group, T* msg, int size, MSG_PRIORITY priority = PRIORITY_NORMAL);
 
     /**
      * @brief   Method for sending arrays  
@@ -193,31 +945,187 @@ class QuickESPNow {
      * @param   id Peers's setted ID
      * @param   msg The message to be sent
      * @param   size The size of the array
+     * @param   priority The priority of the message
+     * @note    An array larger than MSG_MAX_PAYLOAD bytes is sent in fragments, which blocks until they are all sent
+     * @attention The receiver must call enableFragmentation() to accept large arrays
      */
     template<typename T> 
-    void Send(const int id, T* msg, int size); // method for sending arrays data 
+    void Send(const int id, T* msg, int size, MSG_PRIORITY priority = PRIORITY_NORMAL); // method for sending arrays data 
     
+    /**
+     * @brief   Method for sending non-pointers/non-arrays without waiting for the result
+     * @tparam T The type of the message
+     * @param   id Peers's setted ID
+     * @param   msg The message to be sent
+     * @param   priority The priority of the message
+     * @note    The message is never batched, it is sent in its own frame
+     * @note    At most SEND_WINDOW messages can be in flight per peer
+     * 
+     * @return
+     *          - handle : A positive number to poll with sendStatus()
+     *          - -1 : The message could not be sent (window full, unknown peer or send callback not registered)
+     */
+    template<typename T> 
+    int sendAsync(const int id, const T msg, MSG_PRIORITY priority = PRIORITY_NORMAL);
+
+    /**
+     * @brief   Method for sending arrays without waiting for the result
+     * @tparam T The type of the array elements
+     * @param   id Peers's setted ID
+     * @param   msg The message to be sent
+     * @param   size The size of the array
+     * @param   priority The priority of the message
+     * 
+     * @return
+     *          - handle : A positive number to poll with sendStatus()
+     *          - -1 : The message could not be sent
+     * @note    The whole array must fit in MSG_MAX_PAYLOAD bytes
+     */
+    template<typename T> 
+    int sendAsync(const int id, T* msg, int size, MSG_PRIORITY priority = PRIORITY_NORMAL);
+
+    /**
+     * @brief   Gives the status of an asynchronous message
+     * @param   handle The handle returned by sendAsync
+     * 
+     * @return
+     *          - SEND_PENDING : The message is waiting to be sent or acknowledged
+     *          - SEND_DELIVERED : The peer acknowledged the message
+     *          - SEND_FAILED : The message was not delivered
+     *          - SEND_UNKNOWN : The handle is invalid or too old
+     */
+    SEND_STATUS sendStatus(int handle) const;
+
+    /**
+     * @brief   Set a function to be called when an asynchronous message completes
+     * @param   custom The function to be called, nullptr to disable it
+     * @attention The function is called from the WiFi task and must return quickly
+     */
+    void onSendComplete(send_complete_cb_t custom);
+
     /**
      * @brief       Method for recieving the non-pointers/non-arrays messages
      * @tparam T The type of the array elements
      * @attention   The use of <_var_type_> is required
      * @attention   String and other class types are not supported
-     * @attention   The variable type is unkown, it's based on the type variable of the message
+     * @attention   A message of another registered type is dropped and a default value is returned
+     * @note        The messages of a higher priority come first and the peers take turns, call from() first to know who sent the message
      * @example     int recv_msg = object.read<int>();
      * 
      * @return
-     *          - Unkown type : it's based on the type variable of the message
+     *          - T : the value of the message
      */
     template<typename T> T read(); // method for sending non-pointer data 
 
+    /**
+     * @brief       Method for recieving the non-pointers/non-arrays messages of a peer
+     * @tparam T The type of the value
+     * @param   id Peers's setted ID
+     * @attention   A message of another registered type is dropped and a default value is returned
+     * @note    Named apart from read(T& output), which read<int>(value) would otherwise not reach for an int variable
+     * @example     int recv_msg = object.readFrom<int>(SENSOR_ID);
+     * 
+     * @return
+     *          - T : the value of the message, default-constructed if the peer has no message
+     */
+    template<typename T> T readFrom(int id);
+
+    /**
+     * @brief   Method for recieving the non-pointers/non-arrays messages, only if they have the expected type
+     * @tparam T The type of the value
+     * @param   output The variable that will copy the messages value
+     * @example     Telemetry t; if(object.read(t)){ ... }
+     * 
+     * @return
+     *          - true : The message was read
+     *          - false : No message or the message has another type, it is left in the queue
+     */
+    template<typename T> bool read(T& output);
+
+    /**
+     * @brief   Method for recieving the non-pointers/non-arrays messages of a peer, only if they have the expected type
+     * @tparam T The type of the value
+     * @param   id Peers's setted ID
+     * @param   output The variable that will copy the messages value
+     * 
+     * @return
+     *          - true : The message was read
+     *          - false : No message from the peer or the message has another type, it is left in the queue
+     */
+    template<typename T> bool read(int id, T& output);
+
+    /**
+     * @brief   Waits for a message and reads it, only if it has the expected type
+     * @tparam T The type of the value
+     * @param   output The variable that will copy the messages value
+     * @param   timeout_ms The maximum time to wait (ms)
+     * @example     Telemetry t; if(object.waitRead(t, 50)){ ... }
+     * 
+     * @return
+     *          - true : The message was read
+     *          - false : No message arrived in time or the message has another type, it is left in the queue
+     */
+    template<typename T> bool waitRead(T& output, unsigned long timeout_ms);
+
+    /**
+     * @brief   Waits for a message from a peer and reads it, only if it has the expected type
+     * @tparam T The type of the value
+     * @param   id Peers's setted ID
+     * @param   output The variable that will copy the messages value
+     * @param   timeout_ms The maximum time to wait (ms)
+     * 
+     * @return
+     *          - true : The message was read
+     *          - false : No message from the peer arrived in time or the message has another type, it is left in the queue
+     */
+    template<typename T> bool waitRead(int id, T& output, unsigned long timeout_ms);
+
     /**
      * @brief   Method for recieving the arrays messages
      * @tparam T The type of the array elements
      * @param   output The array that will copy the messages value
      * @attention   String and other class types are not supported
-     * @attention   The variable type is unkown, it's based on the type variable of the message
+     * @attention   An array of another registered type is dropped
+     * 
+     * @return
+     *          - true : The array was read
+     *          - false : No message or the message has another type
      */
-    template<typename T> void read_array(T* output); // method for sending pointer data 
+    template<typename T> bool read_array(T* output); // method for sending pointer data 
+
+    /**
+     * @brief   Method for recieving the arrays messages of a peer
+     * @tparam T The type of the array elements
+     * @param   id Peers's setted ID
+     * @param   output The array that will copy the messages value
+     * @attention   An array of another registered type is dropped
+     * 
+     * @return
+     *          - true : The array was read
+     *          - false : No message from the peer or the message has another type
+     */
+    template<typename T> bool read_array(int id, T* output);
+
+    /**
+     * @brief   Method for reading the next message in place, without copying it
+     * @attention   The message is removed when the view goes out of scope, the sender's other messages are not read until then
+     * @example     Msg_View msg = object.peek(); if(msg){ process(msg.from(), msg.data(), msg.size()); }
+     * 
+     * @return
+     *          - A view of the message : from(), data(), size(), type(), isArray() and as<T>()
+     *          - An empty view : no message was received
+     */
+    Msg_View peek();
+
+    /**
+     * @brief   Method for reading the next message of a peer in place, without copying it
+     * @param   id Peers's setted ID
+     * 
+     * @return
+     *          - A view of the message
+     *          - An empty view : no message was received from the peer
+     */
+    Msg_View peek(int id);
     
     /**
      * @brief   Gives information about whether the received message is an array
@@ -240,8 +1148,25 @@ class QuickESPNow {
      *          - CHAR : The recieved message is type of char
      *          - BOOL : The recieved message is type of bool
      *          - DATA : The recieved message is type of data struct
+     *          - getMsgType<T>() : The recieved message is type of a struct registered with QUICKESPNOW_REGISTER_TYPE
      */
     MSG_VARIABLE_TYPE data_type() const;
+
+    /**
+     * @brief   Gives the size of the received message, to size the output of read_array()
+     * @example     float* samples = (float*)malloc(object.data_size()); object.read_array(samples);
+     * 
+     * @return  The number of bytes of the message, 0 if no message was received
+     */
+    size_t data_size() const;
+
+    /**
+     * @brief   Gives the size of the next message of a peer, to size the output of read_array(id, output)
+     * @param   id Peers's setted ID
+     * 
+     * @return  The number of bytes of the message, 0 if no message was received from the peer
+     */
+    size_t data_size(int id) const;
     /********Msg sending and recieving methods********/
 
     /********Other utils********/
@@ -282,141 +1207,192 @@ class QuickESPNow {
 };
 
 template<typename T> 
-void QuickESPNow::Send(const int id, T msg) {
-    bool id_exists = false;
-    int key;
-    for(int i = 0; i<this->id_counter; i++){
-        if(this->ids[i]==id){
-            id_exists = true;
-            key = i;
-            break;
-        }
-    }
-    
-    if(!id_exists){
-        Serial.println("[Fail] Unknown esp id");
-        return;
-    }
+void QuickESPNow::Send(const int id, T msg, MSG_PRIORITY priority) {
+    msg_struct msg_to_sent;
+    int len = encodeMsg(&msg_to_sent, msg);
+    msg_to_sent.header.flags |= msgPriorityFlags(priority);
 
-    // Check if the peer exists
-    if (!esp_now_is_peer_exist(this->Peers_MAC[key])) {
-        Serial.println("[Error] Peer does not exist");
+    sendFrame(id, &msg_to_sent, len);
+}
+
+template<typename T> 
+void QuickESPNow::Send(const int id, T* msg, int size, MSG_PRIORITY priority) {
+    msg_struct msg_to_sent;
+    int len = encodeMsg(&msg_to_sent, msg, size);
+    if(len < 0 && size > 0){
+        sendLarge(id, getMsgType<T>(), MSG_FLAG_ARRAY | msgPriorityFlags(priority), (const uint8_t*)msg, (uint32_t)size * sizeof(T));
         return;
     }
-
-    esp_now_peer_info_t temp_peer;
-    if (esp_now_get_peer(this->Peers_MAC[key], &temp_peer) != ESP_OK) {
-        Serial.println("[Error] Failed to get peer info");
+    if(len < 0){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_ARRAY_TOO_LARGE, nullptr, size);
         return;
     }
+    msg_to_sent.header.flags |= msgPriorityFlags(priority);
 
-    if(WiFi.channel() != temp_peer.channel){
-        setChannel(temp_peer.channel);
-    }
+    sendFrame(id, &msg_to_sent, len);
+}
 
+template<typename T>
+void QuickESPNow::sendGroup(int group, T msg, MSG_PRIORITY priority) {
     msg_struct msg_to_sent;
+    int len = encodeMsg(&msg_to_sent, msg);
+    msg_to_sent.header.flags |= msgPriorityFlags(priority);
 
-    
-    if constexpr (std::is_same<T, int>::value){
-        msg_to_sent.type = INT;
-    }else if constexpr (std::is_same<T, short>::value){
-        msg_to_sent.type = SHORT;
-    }else if constexpr (std::is_same<T, long>::value){
-        msg_to_sent.type = LONG;
-    }else if constexpr (std::is_same<T, float>::value){
-        msg_to_sent.type = FLOAT;
-    }else if constexpr (std::is_same<T, double>::value){
-        msg_to_sent.type = DOUBLE;
-    }else if constexpr (std::is_same<T, char>::value){
-        msg_to_sent.type = CHAR;
-    }else if constexpr (std::is_same<T, bool>::value){
-        msg_to_sent.type = BOOL;
-    }else if constexpr (std::is_same<T, data>::value){
-        msg_to_sent.type = DATA;
-    }else{
-        msg_to_sent.type = UNKNOWN;
+    sendGroupFrame(group, &msg_to_sent, len);
+}
+
+template<typename T>
+void QuickESPNow::sendGroup(int group, T* msg, int size, MSG_PRIORITY priority) {
+    msg_struct msg_to_sent;
+    int len = encodeMsg(&msg_to_sent, msg, size);
+    if(len < 0){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_ARRAY_TOO_LARGE, nullptr, size);
+        return;
     }
+    msg_to_sent.header.flags |= msgPriorityFlags(priority);
 
-    msg_to_sent.size = 0;
-    msg_to_sent.data = (void*)(msg);
+    sendGroupFrame(group, &msg_to_sent, len);
+}
+
+template<typename T> 
+int QuickESPNow::sendAsync(const int id, T msg, MSG_PRIORITY priority) {
+    msg_struct msg_to_sent;
+    int len = encodeMsg(&msg_to_sent, msg);
+    msg_to_sent.header.flags |= msgPriorityFlags(priority);
 
-    bool result = esp_now_send(this->Peers_MAC[key], (uint8_t*)&msg_to_sent, sizeof(msg_to_sent));
-    result == ESP_OK ? Serial.println("Successfully sent msg") : Serial.println("Failed to send msg");
+    return sendFrameAsync(id, &msg_to_sent, len);
 }
 
 template<typename T> 
-void QuickESPNow::Send(const int id, T* msg, int size) {
-    bool id_exists = false;
-    int key;
-    for(int i = 0; i<this->id_counter; i++){
-        if(this->ids[i]==id){
-            id_exists = true;
-            key = i;
-            break;
-        }
+int QuickESPNow::sendAsync(const int id, T* msg, int size, MSG_PRIORITY priority) {
+    msg_struct msg_to_sent;
+    int len = encodeMsg(&msg_to_sent, msg, size);
+    if(len < 0){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_ARRAY_TOO_LARGE, nullptr, size);
+        return -1;
     }
-    
-    if(!id_exists){
-        Serial.println("[Fail] Unknown esp id");
-        return;
+    msg_to_sent.header.flags |= msgPriorityFlags(priority);
+
+    return sendFrameAsync(id, &msg_to_sent, len);
+}
+
+template<typename T>
+int QuickESPNow::popValue(Msg_Queue* queue, T* value){
+    int result = queue->tryPop(value);
+    if(result < 0){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_TYPE_MISMATCH, nullptr, queue->data_type());
+        queue->drop(); // Dropped so a read loop does not get stuck on it
     }
+    return result;
+}
 
-    // Check if the peer exists
-    if (!esp_now_is_peer_exist(this->Peers_MAC[key])) {
-        Serial.println("[Error] Peer does not exist");
-        return;
+template<typename T>
+int QuickESPNow::popArray(Msg_Queue* queue, T* output){
+    int result = queue->tryPopArray(output);
+    if(result < 0){
+        QEN_LOG_WARN(LOG_FROM_APP, LOG_TYPE_MISMATCH, nullptr, queue->data_type());
+        queue->drop();
     }
+    return result;
+}
 
-    esp_now_peer_info_t temp_peer;
-    if (esp_now_get_peer(this->Peers_MAC[key], &temp_peer) != ESP_OK) {
-        Serial.println("[Error] Failed to get peer info");
-        return;
+template<typename T>
+T QuickESPNow::read(){
+    T value = T();
+    if(popValue(frontQueue(), &value) != 0){
+        nextInbox();
     }
+    return value;
+}
 
-    if(WiFi.channel() != temp_peer.channel){
-        setChannel(temp_peer.channel);
+template<typename T>
+T QuickESPNow::readFrom(int id){
+    T value = T();
+    Msg_Queue* queue = inbox(id);
+    if(queue != nullptr){
+        popValue(queue, &value);
     }
+    return value;
+}
 
-    msg_struct msg_to_sent;
-    void* data;
-    
-    if constexpr (std::is_same<T, int>::value){
-        msg_to_sent.type = INT;
-    }else if constexpr (std::is_same<T, short>::value){
-        msg_to_sent.type = SHORT;
-    }else if constexpr (std::is_same<T, long>::value){
-        msg_to_sent.type = LONG;
-    }else if constexpr (std::is_same<T, float>::value){
-        msg_to_sent.type = FLOAT;
-    }else if constexpr (std::is_same<T, double>::value){
-        msg_to_sent.type = DOUBLE;
-    }else if constexpr (std::is_same<T, char>::value){
-        msg_to_sent.type = CHAR;
-    }else if constexpr (std::is_same<T, bool>::value){
-        msg_to_sent.type = BOOL;
-    }else{
-        msg_to_sent.type = UNKNOWN;
+template<typename T>
+bool QuickESPNow::read(T& output){
+    if(frontQueue()->tryPop(&output) <= 0){
+        return false; // A message of another type stays at the front, data_type() tells which
     }
-    
-    msg_to_sent.size = size;
-   
-   for(int i = 0; i < size; i++){
-       msg_to_sent.data_array[i] = (void*)(msg[i]);
+    nextInbox();
+    return true;
+}
+
+template<typename T>
+bool QuickESPNow::enableMailbox(int id){
+    return QuickESPNow::mailboxes.open(this->peers.find(id), Msg_Type<T>::id);
+}
+
+template<typename T>
+void QuickESPNow::disableMailbox(int id){
+    QuickESPNow::mailboxes.close(this->peers.find(id), Msg_Type<T>::id);
+}
+
+template<typename T>
+bool QuickESPNow::latest(int id, T& output, unsigned long* age_us) const{
+    // A shorter payload leaves the rest default-constructed, like read()
+    T value = T();
+    uint32_t stamp;
+    if(!QuickESPNow::mailboxes.read(this->peers.find(id), Msg_Type<T>::id, &value, sizeof(T), &stamp)){
+        return false;
     }
-    
-    // Send the message
-    bool result = esp_now_send(this->Peers_MAC[key], (uint8_t*)&msg_to_sent, sizeof(msg_to_sent));
-    result == ESP_OK ? Serial.println("Successfully sent msg") : Serial.println("Failed to send msg");
+    output = value;
+    if(age_us != nullptr){
+        *age_us = micros() - stamp;
+    }
+    return true;
 }
 
 template<typename T>
-T QuickESPNow::read(){
-    return QuickESPNow::recieved_msgs.pop<T>();
+bool QuickESPNow::onMessage(void (*handler)(int from, const T& value)){
+    return setHandler(Msg_Type<T>::id, false, handler != nullptr ? invokeValueHandler<T> : nullptr, (void*)handler);
 }
 
+template<typename T>
+bool QuickESPNow::onMessage(void (*handler)(int from, const T* values, size_t count)){
+    return setHandler(Msg_Type<T>::id, true, handler != nullptr ? invokeArrayHandler<T> : nullptr, (void*)handler);
+}
+
+template<typename T>
+void QuickESPNow::removeHandler(){
+    setHandler(Msg_Type<T>::id, false, nullptr, nullptr);
+    setHandler(Msg_Type<T>::id, true, nullptr, nullptr);
+}
+
+template<typename T>
+bool QuickESPNow::read(int id, T& output){
+    Msg_Queue* queue = inbox(id);
+    return queue != nullptr && queue->tryPop(&output) > 0;
+}
+
+template<typename T>
+bool QuickESPNow::waitRead(T& output, unsigned long timeout_ms){
+    return waitAvailable(timeout_ms) && read(output);
+}
+
+template<typename T>
+bool QuickESPNow::waitRead(int id, T& output, unsigned long timeout_ms){
+    return waitAvailable(id, timeout_ms) && read(id, output);
+}
+
+template<typename T>
+bool QuickESPNow::read_array(T* output){
+    int result = popArray(frontQueue(), output);
+    if(result != 0){
+        nextInbox();
+    }
+    return result > 0;
+}
 
 template<typename T>
-void QuickESPNow::read_array(T* output){
-    QuickESPNow::recieved_msgs.popArray(output);
+bool QuickESPNow::read_array(int id, T* output){
+    Msg_Queue* queue = inbox(id);
+    return queue != nullptr && popArray(queue, output) > 0;
 }
 #endif
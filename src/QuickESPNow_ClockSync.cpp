@@ -0,0 +1,208 @@
+#include "QuickESPNow_ClockSync.h"
+
+#include <algorithm>
+
+// Constructor for Clock_Sync
+Clock_Sync::Clock_Sync() {
+    for(int key = 0; key < MAX_PEERS; key++){
+        peers[key].interval = 0;
+        peers[key].last_probe = 0;
+        peers[key].sequence = 0;
+        peers[key].outstanding.store(-1, std::memory_order_relaxed);
+        peers[key].window.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+// Destructor for Clock_Sync
+Clock_Sync::~Clock_Sync() {
+    clear();
+}
+
+void Clock_Sync::open(int key) {
+    if(key < 0 || key >= MAX_PEERS || peers[key].window.load(std::memory_order_relaxed) != nullptr){
+        return;
+    }
+    clock_window* window = new clock_window;
+    window->sequence.store(0, std::memory_order_relaxed);
+    window->count = 0;
+    peers[key].window.store(window, std::memory_order_release); // Filled in before the receive callback can see it
+}
+
+void Clock_Sync::setInterval(int key, uint32_t interval_us) {
+    if(key < 0 || key >= MAX_PEERS){
+        return;
+    }
+    peers[key].interval = interval_us;
+}
+
+void Clock_Sync::reset(int key) {
+    if(key < 0 || key >= MAX_PEERS){
+        return;
+    }
+    clock_peer& peer = peers[key];
+    peer.interval = 0;
+    peer.outstanding.store(-1, std::memory_order_relaxed);
+    clock_window* window = peer.window.load(std::memory_order_relaxed);
+    if(window != nullptr){
+        window->count = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+bool Clock_Sync::due(int key, uint32_t now) const {
+    const clock_peer& peer = peers[key];
+    if(peer.interval == 0 || now - peer.last_probe < peer.interval){
+        return false;
+    }
+    // A slow pong would never count if every ping replaced the previous one
+    return peer.outstanding.load(std::memory_order_relaxed) == -1 || now - peer.last_probe >= CLOCK_PONG_TIMEOUT_MS * 1000u;
+}
+
+void Clock_Sync::ping(int key, uint8_t* frame) {
+    clock_peer& peer = peers[key];
+    peer.sequence++;
+    peer.last_probe = micros();
+    peer.outstanding.store(peer.sequence, std::memory_order_release);
+
+    msg_header header = {MSG_WIRE_VERSION, MSG_CLOCK_TYPE, 0, sizeof(clock_probe)};
+    clock_probe probe = {0, 0, peer.sequence, esp_timer_get_time(), 0, 0};
+    memcpy(frame, &header, MSG_HEADER_SIZE);
+    memcpy(frame + MSG_HEADER_SIZE, &probe, sizeof(clock_probe));
+}
+
+void Clock_Sync::receive(int key, const uint8_t* frame, int64_t now) {
+    // Only a peer can be answered, and only a peer was pinged
+    if(key < 0 || key >= MAX_PEERS){
+        return;
+    }
+    clock_probe probe;
+    memcpy(&probe, frame + MSG_HEADER_SIZE, sizeof(clock_probe));
+
+    if(probe.flags & CLOCK_FLAG_PONG){
+        record(key, &probe, now);
+    }else{
+        // A full backlog loses the pong, the pinging board simply measures the next round trip
+        probe.flags = CLOCK_FLAG_PONG;
+        probe.received = now;
+        replies.push({key, probe});
+    }
+}
+
+void Clock_Sync::record(int key, const clock_probe* probe, int64_t now) {
+    clock_window* window = peers[key].window.load(std::memory_order_acquire);
+    if(window == nullptr){
+        return;
+    }
+    // A pong that comes late, twice or for a ping sent before the peer was reset is not a round trip
+    int32_t expected = probe->sequence;
+    if(!peers[key].outstanding.compare_exchange_strong(expected, -1, std::memory_order_acq_rel)){
+        return;
+    }
+
+    // The time the peer held the ping is left out, a negative round trip is the resolution of the clocks
+    int64_t delay = (now - probe->origin) - (probe->transmitted - probe->received);
+    delay = std::min(std::max(delay, (int64_t)0), (int64_t)UINT32_MAX);
+    int64_t offset = ((probe->received - probe->origin) + (probe->transmitted - now)) / 2;
+
+    uint32_t sequence = window->sequence.load(std::memory_order_relaxed);
+    window->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    clock_sample& sample = window->samples[window->count % CLOCK_SAMPLES];
+    sample.offset = offset;
+    sample.delay = (uint32_t)delay;
+    sample.taken = (uint32_t)now;
+    window->count++;
+
+    window->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool Clock_Sync::nextReply(int* key, uint8_t* frame) {
+    clock_reply reply;
+    if(!replies.pop(reply)){
+        return false;
+    }
+    msg_header header = {MSG_WIRE_VERSION, MSG_CLOCK_TYPE, 0, sizeof(clock_probe)};
+    memcpy(frame, &header, MSG_HEADER_SIZE);
+    memcpy(frame + MSG_HEADER_SIZE, &reply.probe, sizeof(clock_probe));
+    *key = reply.key;
+    return true;
+}
+
+void Clock_Sync::stamp(uint8_t* frame) {
+    int64_t now = esp_timer_get_time();
+    memcpy(frame + MSG_HEADER_SIZE + offsetof(clock_probe, transmitted), &now, sizeof(now));
+}
+
+bool Clock_Sync::snapshot(int key, clock_stats* output) const {
+    if(key < 0 || key >= MAX_PEERS){
+        return false;
+    }
+    const clock_window* window = peers[key].window.load(std::memory_order_acquire);
+    if(window == nullptr){
+        return false;
+    }
+
+    // Copies again if the WiFi task wrote the window meanwhile
+    uint32_t count;
+    clock_sample samples[CLOCK_SAMPLES];
+    while(true){
+        uint32_t before = window->sequence.load(std::memory_order_acquire);
+        if(before & 1){
+            continue;
+        }
+        count = window->count;
+        memcpy(samples, window->samples, sizeof(samples));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(window->sequence.load(std::memory_order_relaxed) == before){
+            break;
+        }
+    }
+    if(count == 0){
+        return false;
+    }
+
+    // The round trip with the least delay, aged by the drift the clocks may have had since, gives the offset
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    int kept = (int)std::min(count, (uint32_t)CLOCK_SAMPLES);
+    const clock_sample* newest = &samples[(count - 1) % CLOCK_SAMPLES];
+    const clock_sample* best = newest;
+    uint64_t best_error = UINT64_MAX;
+    for(int i = 0; i < std::min(kept, CLOCK_FILTER_DEPTH); i++){
+        const clock_sample* sample = &samples[(count - 1 - i) % CLOCK_SAMPLES];
+        uint64_t error = sample->delay / 2 + (uint64_t)(now - sample->taken) * CLOCK_DRIFT_PPM / 1000000;
+        if(error < best_error){
+            best_error = error;
+            best = sample;
+        }
+    }
+
+    uint32_t delays[CLOCK_SAMPLES];
+    for(int i = 0; i < kept; i++){
+        delays[i] = samples[i].delay;
+    }
+    std::sort(delays, delays + kept);
+    auto percentile = [&](int p){
+        return delays[(p * kept + 99) / 100 - 1];
+    };
+
+    output->samples = count;
+    output->offset_us = best->offset;
+    output->offset_error_us = (uint32_t)std::min(best_error, (uint64_t)UINT32_MAX);
+    output->last_offset_us = newest->offset;
+    output->rtt_min_us = delays[0];
+    output->rtt_p50_us = percentile(50);
+    output->rtt_p90_us = percentile(90);
+    output->rtt_p99_us = percentile(99);
+    output->age_us = now - newest->taken;
+    return true;
+}
+
+void Clock_Sync::clear() {
+    for(int key = 0; key < MAX_PEERS; key++){
+        peers[key].interval = 0;
+        peers[key].outstanding.store(-1, std::memory_order_relaxed);
+        delete peers[key].window.exchange(nullptr, std::memory_order_acq_rel);
+    }
+    replies.clear();
+}
@@ -0,0 +1,212 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_ClockSync_h
+#define QuickESPNow_ClockSync_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_utils.h"
+#include "QuickESPNow_RingBuffer.h"
+
+/**
+ * @brief   Body of a clock probe (type MSG_CLOCK_TYPE), the timestamps are esp_timer_get_time() of the board that took them
+ * @note    A ping carries only its origin, the pong echoes it with the time the ping was received and the time the pong was sent.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t flags;                      ///< Flags of the probe (CLOCK_FLAG_*).
+    uint8_t reserved;                   ///< Always 0.
+    uint16_t sequence;                  ///< Number of the ping, a pong carries the one it answers.
+    int64_t origin;                     ///< Time (us) the ping was sent, on the clock of the pinging board.
+    int64_t received;                   ///< Time (us) the ping was received, on the clock of the answering board.
+    int64_t transmitted;                ///< Time (us) the pong was sent, on the clock of the answering board.
+} clock_probe;
+
+static_assert(MSG_HEADER_SIZE + sizeof(clock_probe) == CLOCK_OVERHEAD, "CLOCK_OVERHEAD does not match the clock probe");
+
+/**
+ * @brief   Snapshot of the round trips and the clock offset to a peer
+ */
+typedef struct {
+    uint32_t samples;                   ///< Round trips measured since the peer was added.
+    int64_t offset_us;                  ///< Clock of the peer minus the local clock (us), from the round trip with the least delay among the newest CLOCK_FILTER_DEPTH.
+    uint32_t offset_error_us;           ///< Largest error (us) of offset_us, half the round trip it was taken from plus the drift since.
+    int64_t last_offset_us;             ///< Offset (us) measured by the newest round trip, without the filter.
+    uint32_t rtt_min_us;                ///< Shortest round trip (us) among the newest CLOCK_SAMPLES.
+    uint32_t rtt_p50_us;                ///< Median round trip (us) among the newest CLOCK_SAMPLES.
+    uint32_t rtt_p90_us;                ///< 90th percentile of the round trip (us) among the newest CLOCK_SAMPLES.
+    uint32_t rtt_p99_us;                ///< 99th percentile of the round trip (us) among the newest CLOCK_SAMPLES.
+    uint32_t age_us;                    ///< Time (us) since the newest round trip.
+} clock_stats;
+
+/**
+ * @class   Clock_Sync
+ * @brief   Round trip probes to the peers, with the NTP estimate of the offset between the two clocks.
+ * @note    A ping is stamped right before it is handed to the driver (t1), its receiver stamps it in the receive
+ *          callback (t2) and answers from update(), stamping the pong right before it is sent (t3). The pong
+ *          is stamped again when it comes back (t4), the round trip is (t4 - t1) - (t3 - t2), so the time the
+ *          answer waited for update() does not count, and the offset is ((t2 - t1) + (t3 - t4)) / 2.
+ *          A round trip longer in one direction than in the other shifts the offset by half the difference,
+ *          the offset is therefore taken from the round trip with the least delay, like the clock filter of NTP.
+ *          The round trips of a peer are kept in a window allocated by the first probe, written by the WiFi
+ *          task under a sequence lock, every board answers the pings of its peers without one.
+ */
+class Clock_Sync {
+    private:
+        /**
+         * @struct  clock_sample
+         * @brief   A measured round trip.
+         */
+        struct clock_sample {
+            int64_t offset;                         ///< Clock of the peer minus the local clock (us).
+            uint32_t delay;                         ///< Round trip (us) without the time the peer held the ping.
+            uint32_t taken;                         ///< Time (us, low bits of esp_timer_get_time()) the pong came back.
+        };
+
+        /**
+         * @struct  clock_window
+         * @brief   The newest round trips to a peer.
+         */
+        struct clock_window {
+            std::atomic<uint32_t> sequence;         ///< Odd while the window is written.
+            uint32_t count;                         ///< Round trips measured, the newest is at (count - 1) % CLOCK_SAMPLES.
+            clock_sample samples[CLOCK_SAMPLES];    ///< The round trips.
+        };
+
+        /**
+         * @struct  clock_peer
+         * @brief   The probing of a peer slot.
+         */
+        struct clock_peer {
+            uint32_t interval;                      ///< Time (us) between two probes, 0 if they are only sent by ping().
+            uint32_t last_probe;                    ///< Time (us, micros()) of the last probe.
+            uint16_t sequence;                      ///< Number of the last ping.
+            std::atomic<int32_t> outstanding;       ///< Number of the ping whose pong is awaited, -1 if none.
+            std::atomic<clock_window*> window;      ///< The round trips, nullptr until the first probe.
+        };
+
+        /**
+         * @struct  clock_reply
+         * @brief   A pong owed to the sender of a ping.
+         */
+        struct clock_reply {
+            int key;                                ///< The slot of the sender.
+            clock_probe probe;                      ///< The ping, stamped with the time it was received.
+        };
+
+        clock_peer peers[MAX_PEERS];                ///< The probing of each peer slot.
+        Ring_Buffer<clock_reply, CLOCK_REPLY_BACKLOG> replies; ///< Pongs waiting to be sent (WiFi to application task).
+
+        /**
+         * @brief   Takes a pong into the round trips of its sender (WiFi task).
+         * @param   key The slot of the sender
+         * @param   probe The pong
+         * @param   now The time (us) the pong was received
+         */
+        void record(int key, const clock_probe* probe, int64_t now);
+
+    public:
+        /**
+         * @brief   Constructor for a board that probes no peer.
+         */
+        Clock_Sync();
+
+        /**
+         * @brief   Destructor, frees the windows.
+         */
+        ~Clock_Sync();
+
+        Clock_Sync(const Clock_Sync&) = delete;
+        Clock_Sync& operator=(const Clock_Sync&) = delete;
+
+        /**
+         * @brief   Allocates the window of a peer slot, so that its pongs are recorded (application task).
+         * @param   key The slot of the peer
+         */
+        void open(int key);
+
+        /**
+         * @brief   Sets the time between two probes of a peer slot (application task).
+         * @param   key The slot of the peer
+         * @param   interval_us The time between two probes, 0 to only send them with ping()
+         */
+        void setInterval(int key, uint32_t interval_us);
+
+        /**
+         * @brief   Stops the probes of a peer slot and forgets its round trips, before the slot is given to a new peer (application task).
+         * @param   key The slot of the peer
+         */
+        void reset(int key);
+
+        /**
+         * @brief   Tells if the periodic probe of a peer slot is due, the previous one must be answered or CLOCK_PONG_TIMEOUT_MS old (application task).
+         * @param   key The slot of the peer
+         * @param   now The time (us, micros())
+         * @return  Whether a ping should be sent
+         */
+        bool due(int key, uint32_t now) const;
+
+        /**
+         * @brief   Writes the next ping to a peer slot, stamped with the current time (application task).
+         * @note    Call it right before the frame is handed to the driver, the pong of an earlier ping is ignored from now on.
+         * @param   key The slot of the peer
+         * @param   frame The ping, CLOCK_OVERHEAD bytes
+         */
+        void ping(int key, uint8_t* frame);
+
+        /**
+         * @brief   Takes a received probe, a ping is answered by update() and a pong is recorded (WiFi task).
+         * @param   key The slot of the sender, -1 if it is not a peer
+         * @param   frame The probe, CLOCK_OVERHEAD bytes
+         * @param   now The time (us, esp_timer_get_time()) the frame was received
+         */
+        void receive(int key, const uint8_t* frame, int64_t now);
+
+        /**
+         * @brief   Gives the next pong owed to the sender of a ping (application task).
+         * @param   key The variable that will receive the slot of the sender
+         * @param   frame The pong, CLOCK_OVERHEAD bytes, it still has to be stamped
+         * @return  false if no pong is owed.
+         */
+        bool nextReply(int* key, uint8_t* frame);
+
+        /**
+         * @brief   Stamps a pong with the current time, call it right before the frame is handed to the driver.
+         * @param   frame The pong given by nextReply()
+         */
+        static void stamp(uint8_t* frame);
+
+        /**
+         * @brief   Filters the round trips of a peer slot (application task).
+         * @param   key The slot of the peer
+         * @param   output The variable that will receive the estimates
+         * @return
+         *          - true : The estimates were copied
+         *          - false : No round trip to the peer was measured yet
+         */
+        bool snapshot(int key, clock_stats* output) const;
+
+        /**
+         * @brief   Frees every window, once the receive callback is gone.
+         */
+        void clear();
+};
+
+#endif
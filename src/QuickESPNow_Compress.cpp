@@ -0,0 +1,178 @@
+#include "QuickESPNow_Compress.h"
+
+#define LZ_TABLE_SIZE (1u << COMPRESS_HASH_BITS)
+
+static inline uint32_t read32(const uint8_t* bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hashOf(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+// Constructor for Lz_Codec
+Lz_Codec::Lz_Codec() {
+    table = (uint32_t*)malloc(LZ_TABLE_SIZE * sizeof(uint32_t));
+}
+
+// Destructor to clean up the Lz_Codec
+Lz_Codec::~Lz_Codec() {
+    free(table);
+}
+
+bool Lz_Codec::isValid() const {
+    return table != nullptr;
+}
+
+uint8_t* Lz_Codec::putLength(uint8_t* out, uint8_t* end, uint32_t length) {
+    for(; length >= 255; length -= 255){
+        if(out >= end){
+            return nullptr;
+        }
+        *out++ = 255;
+    }
+    if(out >= end){
+        return nullptr;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+uint32_t Lz_Codec::compress(const uint8_t* input, uint32_t size, uint8_t* output, uint32_t capacity) {
+    if(table == nullptr || capacity <= LZ_HEADER_SIZE){
+        return 0;
+    }
+    memset(table, 0, LZ_TABLE_SIZE * sizeof(uint32_t));
+    memcpy(output, &size, LZ_HEADER_SIZE);
+    uint8_t* out = output + LZ_HEADER_SIZE;
+    uint8_t* end = output + capacity;
+
+    uint32_t anchor = 0;
+    uint32_t pos = 0;
+    while(true){
+        // Find the next match, the sequences far from the last one are skipped faster
+        uint32_t match = 0;
+        uint32_t length = 0;
+        while(pos + LZ_MIN_MATCH <= size){
+            uint32_t sequence = read32(input + pos);
+            uint32_t* slot = &table[hashOf(sequence)];
+            uint32_t candidate = *slot;
+            *slot = pos + 1;
+            if(candidate != 0 && pos - (candidate - 1) <= LZ_MAX_OFFSET && read32(input + candidate - 1) == sequence){
+                match = candidate - 1;
+                length = LZ_MIN_MATCH;
+                while(pos + length < size && input[match + length] == input[pos + length]){
+                    length++;
+                }
+                break;
+            }
+            pos += 1 + ((pos - anchor) >> 6);
+        }
+
+        // A sequence: the literals since the last match and the match, if any
+        uint32_t literals = (length > 0 ? pos : size) - anchor;
+        if(out >= end){
+            return 0;
+        }
+        uint8_t* token = out++;
+        *token = (uint8_t)((literals < 15 ? literals : 15) << 4);
+        if(literals >= 15 && (out = putLength(out, end, literals - 15)) == nullptr){
+            return 0;
+        }
+        if((uint32_t)(end - out) < literals){
+            return 0;
+        }
+        memcpy(out, input + anchor, literals);
+        out += literals;
+        if(length == 0){
+            break; // The last sequence has no match
+        }
+
+        if(end - out < 2){
+            return 0;
+        }
+        uint16_t offset = (uint16_t)(pos - match);
+        memcpy(out, &offset, 2);
+        out += 2;
+        length -= LZ_MIN_MATCH;
+        *token |= (uint8_t)(length < 15 ? length : 15);
+        if(length >= 15 && (out = putLength(out, end, length - 15)) == nullptr){
+            return 0;
+        }
+        pos += length + LZ_MIN_MATCH;
+        anchor = pos;
+    }
+    return out - output;
+}
+
+uint32_t Lz_Codec::originalSize(const uint8_t* input, uint32_t size) {
+    if(size < LZ_HEADER_SIZE){
+        return 0;
+    }
+    uint32_t original;
+    memcpy(&original, input, LZ_HEADER_SIZE);
+    return original;
+}
+
+bool Lz_Codec::decompress(const uint8_t* input, uint32_t size, uint8_t* output) {
+    uint32_t original = originalSize(input, size);
+    const uint8_t* in = input + LZ_HEADER_SIZE;
+    const uint8_t* in_end = input + size;
+    uint32_t out = 0;
+
+    while(in < in_end){
+        uint8_t token = *in++;
+        uint32_t literals = token >> 4;
+        if(literals == 15){
+            uint8_t more;
+            do{
+                if(in >= in_end){
+                    return false;
+                }
+                more = *in++;
+                literals += more;
+            }while(more == 255);
+        }
+        if((uint32_t)(in_end - in) < literals || original - out < literals){
+            return false;
+        }
+        memcpy(output + out, in, literals);
+        in += literals;
+        out += literals;
+        if(in == in_end){
+            break; // The last sequence
+        }
+
+        if(in_end - in < 2){
+            return false;
+        }
+        uint16_t offset;
+        memcpy(&offset, in, 2);
+        in += 2;
+        uint32_t length = token & 15;
+        if(length == 15){
+            uint8_t more;
+            do{
+                if(in >= in_end){
+                    return false;
+                }
+                more = *in++;
+                length += more;
+            }while(more == 255);
+        }
+        length += LZ_MIN_MATCH;
+        if(offset == 0 || offset > out || original - out < length){
+            return false;
+        }
+
+        // Byte by byte, a match may overlap the bytes it produces
+        const uint8_t* from = output + out - offset;
+        for(uint32_t i = 0; i < length; i++){
+            output[out + i] = from[i];
+        }
+        out += length;
+    }
+    return out == original;
+}
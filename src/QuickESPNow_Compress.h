@@ -0,0 +1,98 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Compress_h
+#define QuickESPNow_Compress_h
+
+#include <cstddef>
+#include <cstdint>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+
+#define LZ_HEADER_SIZE 4                ///< Bytes of the original size that start a compressed message
+#define LZ_MIN_MATCH 4                  ///< Shortest repeated sequence that is replaced by a match
+#define LZ_MAX_OFFSET 65535             ///< Farthest back a match can refer to
+
+/**
+ * @class   Lz_Codec
+ * @brief   A small LZ77 codec for the messages sent in fragments.
+ * @note    A compressed message is the original size (4 bytes, little endian) followed by sequences of a token,
+ *          literal bytes and a match: the high nibble of the token is the literal count and the low one the match
+ *          length minus LZ_MIN_MATCH, 15 is continued by bytes that are added up until one is not 255. The match
+ *          offset (2 bytes) follows the literals, the last sequence has literals only.
+ * @note    The compressor keeps a table of 2^COMPRESS_HASH_BITS recent positions, the decompressor needs no memory
+ *          besides its output.
+ */
+class Lz_Codec {
+    private:
+        uint32_t* table;                    ///< Last position (plus one) of each hashed 4 byte sequence, 0 if none.
+
+        /**
+         * @brief   Writes a literal or match length beyond the 15 that fit in a token.
+         * @return  The new output position, nullptr if it does not fit before end
+         */
+        static uint8_t* putLength(uint8_t* out, uint8_t* end, uint32_t length);
+
+    public:
+        /**
+         * @brief   Constructor that allocates the match table.
+         */
+        Lz_Codec();
+
+        /**
+         * @brief   Destructor to free the match table.
+         */
+        ~Lz_Codec();
+
+        Lz_Codec(const Lz_Codec&) = delete;
+        Lz_Codec& operator=(const Lz_Codec&) = delete;
+
+        /**
+         * @brief   Checks if the match table was allocated.
+         * @return  false if the allocation failed.
+         */
+        bool isValid() const;
+
+        /**
+         * @brief   Compresses a message.
+         * @param   input The message
+         * @param   size The size of the message
+         * @param   output The buffer that will receive the compressed message
+         * @param   capacity The size of the buffer, the message is not worth compressing if it does not fit
+         * @return  The size of the compressed message, 0 if it does not fit in capacity.
+         */
+        uint32_t compress(const uint8_t* input, uint32_t size, uint8_t* output, uint32_t capacity);
+
+        /**
+         * @brief   Gives the size of the message a compressed message restores to.
+         * @param   input The compressed message
+         * @param   size The size of the compressed message
+         * @return  The original size, 0 if the compressed message is too short.
+         */
+        static uint32_t originalSize(const uint8_t* input, uint32_t size);
+
+        /**
+         * @brief   Restores a compressed message, every length and offset is checked against the buffers.
+         * @param   input The compressed message
+         * @param   size The size of the compressed message
+         * @param   output The buffer that will receive the message, originalSize() bytes long
+         * @return  true if the whole message was restored, false if the compressed message is corrupt.
+         */
+        static bool decompress(const uint8_t* input, uint32_t size, uint8_t* output);
+};
+
+#endif
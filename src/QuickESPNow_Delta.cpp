@@ -0,0 +1,202 @@
+#include "QuickESPNow_Delta.h"
+
+// Unchanged bytes that are sent inside a run rather than starting a new run, which costs two bytes
+#define DELTA_RUN_GAP 2
+
+// Constructor for Delta_Table
+Delta_Table::Delta_Table() : enabled(0) {
+    for(int i = 0; i < DELTA_CONTEXTS; i++){
+        sent[i].key.store(-1, std::memory_order_relaxed);
+        received[i].key.store(-1, std::memory_order_relaxed);
+    }
+    for(int i = 0; i < MAX_PEERS; i++){
+        intervals[i] = DELTA_KEYFRAME_INTERVAL;
+        generations[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+Delta_Table::delta_context* Delta_Table::context(delta_context* contexts, int key, uint8_t type, bool create) {
+    delta_context* free_context = nullptr;
+    for(int i = 0; i < DELTA_CONTEXTS; i++){
+        int owner = contexts[i].key.load(std::memory_order_acquire);
+        if(owner == key && contexts[i].type == type){
+            return &contexts[i];
+        }
+        if(owner == -1 && free_context == nullptr){
+            free_context = &contexts[i];
+        }
+    }
+
+    int none = -1;
+    if(!create || free_context == nullptr){
+        return nullptr;
+    }
+    // Filled in while it is still free, the other side only frees contexts
+    free_context->type = type;
+    free_context->length = 0;
+    free_context->sequence = 0;
+    free_context->since_keyframe = 0;
+    free_context->generation = 0;
+    return free_context->key.compare_exchange_strong(none, key, std::memory_order_acq_rel) ? free_context : nullptr;
+}
+
+void Delta_Table::forget(delta_context* contexts, int key) {
+    for(int i = 0; i < DELTA_CONTEXTS; i++){
+        if(contexts[i].key.load(std::memory_order_relaxed) == key){
+            contexts[i].key.store(-1, std::memory_order_release);
+        }
+    }
+}
+
+void Delta_Table::enable(int key, uint16_t keyframe_interval) {
+    if(key < 0 || key >= MAX_PEERS){
+        return;
+    }
+    intervals[key] = keyframe_interval > 0 ? keyframe_interval : 1;
+    resync(key);
+    enabled.fetch_or(1u << key, std::memory_order_release);
+}
+
+void Delta_Table::disable(int key) {
+    if(key < 0 || key >= MAX_PEERS){
+        return;
+    }
+    enabled.fetch_and(~(1u << key), std::memory_order_release);
+    forget(sent, key);
+    forget(received, key);
+}
+
+bool Delta_Table::isEnabled(int key) const {
+    return key >= 0 && key < MAX_PEERS && (enabled.load(std::memory_order_acquire) & (1u << key));
+}
+
+void Delta_Table::resync(int key) {
+    if(key >= 0 && key < MAX_PEERS){
+        generations[key].fetch_add(1, std::memory_order_release);
+    }
+}
+
+int Delta_Table::encode(int key, msg_struct* msg, int len) {
+    uint8_t flags = msg->header.flags;
+    int length = msg->header.length;
+    if(!isEnabled(key) || (flags & (MSG_FLAG_ARRAY | MSG_FLAG_FRAGMENT)) || msgPriority(flags) != PRIORITY_NORMAL
+       || length > MSG_MAX_PAYLOAD - DELTA_OVERHEAD){
+        return len;
+    }
+
+    delta_context* ctx = context(sent, key, msg->header.type, true);
+    if(ctx == nullptr){
+        return len; // Sent whole, the receiver queues it as it is
+    }
+
+    // The first message (empty state), a changed length, a failed delivery and the interval all start from a keyframe,
+    // a resync reaches every type of the peer through the generation
+    uint32_t generation = generations[key].load(std::memory_order_acquire);
+    bool keyframe = ctx->length != length || ctx->since_keyframe + 1 >= intervals[key] || ctx->generation != generation;
+    ctx->generation = generation;
+
+    uint8_t changes[MSG_MAX_PAYLOAD];
+    int used = 0;
+    if(!keyframe){
+        // Runs of changed bytes, a delta as long as the keyframe is not worth it
+        for(int i = 0; i < length && !keyframe; ){
+            if(msg->payload[i] == ctx->state[i]){
+                i++;
+                continue;
+            }
+            int end = i + 1;
+            while(end < length){
+                int gap = 0;
+                while(end + gap < length && gap <= DELTA_RUN_GAP && msg->payload[end + gap] == ctx->state[end + gap]){
+                    gap++;
+                }
+                if(gap == 0){
+                    end++;
+                }else if(gap <= DELTA_RUN_GAP && end + gap < length){
+                    end += gap; // Cheaper to send the unchanged bytes than to start a new run
+                }else{
+                    break;
+                }
+            }
+            if(used + 2 + (end - i) >= length){
+                keyframe = true;
+                break;
+            }
+            changes[used++] = (uint8_t)i;
+            changes[used++] = (uint8_t)(end - i);
+            memcpy(changes + used, msg->payload + i, end - i);
+            used += end - i;
+            i = end;
+        }
+    }
+
+    delta_header delta;
+    delta.base = ctx->sequence;
+    delta.sequence = (uint8_t)(ctx->sequence + 1);
+    ctx->sequence = delta.sequence;
+    ctx->length = length;
+    memcpy(ctx->state, msg->payload, length);
+
+    if(keyframe){
+        delta.base = delta.sequence;
+        memmove(msg->payload + DELTA_OVERHEAD, msg->payload, length);
+        used = length;
+        ctx->since_keyframe = 0;
+    }else{
+        memcpy(msg->payload + DELTA_OVERHEAD, changes, used);
+        ctx->since_keyframe++;
+    }
+    memcpy(msg->payload, &delta, DELTA_OVERHEAD);
+    msg->header.flags = flags | MSG_FLAG_DELTA;
+    msg->header.length = DELTA_OVERHEAD + used;
+    return MSG_HEADER_SIZE + msg->header.length;
+}
+
+int Delta_Table::decode(int key, const uint8_t* bytes, int len, msg_struct* msg) {
+    const msg_header* header = (const msg_header*)bytes;
+    if(!isEnabled(key)){
+        return 0; // Both boards must enable delta encoding for each other
+    }
+    // The changes are only read within the received bytes
+    if(len < MSG_HEADER_SIZE + DELTA_OVERHEAD || header->length < DELTA_OVERHEAD || header->length > len - MSG_HEADER_SIZE){
+        return 0;
+    }
+    delta_header delta;
+    memcpy(&delta, bytes + MSG_HEADER_SIZE, DELTA_OVERHEAD);
+    const uint8_t* changes = bytes + MSG_HEADER_SIZE + DELTA_OVERHEAD;
+    int used = header->length - DELTA_OVERHEAD;
+
+    bool keyframe = delta.base == delta.sequence;
+    delta_context* ctx = context(received, key, header->type, keyframe);
+    if(keyframe){
+        memcpy(msg->payload, changes, used);
+        if(ctx != nullptr){
+            ctx->sequence = delta.sequence;
+            ctx->length = used;
+            memcpy(ctx->state, changes, used);
+        }
+    }else{
+        if(ctx == nullptr || ctx->length == 0 || ctx->sequence != delta.base){
+            return 0; // A message in between was lost, wait for the next keyframe
+        }
+
+        // Every run is checked before the state changes, a bad run drops the whole message
+        for(int pos = 0; pos < used; ){
+            if(pos + 2 > used || changes[pos] + changes[pos + 1] > ctx->length || pos + 2 + changes[pos + 1] > used){
+                return 0;
+            }
+            pos += 2 + changes[pos + 1];
+        }
+        for(int pos = 0; pos < used; pos += 2 + changes[pos + 1]){
+            memcpy(ctx->state + changes[pos], changes + pos + 2, changes[pos + 1]);
+        }
+        ctx->sequence = delta.sequence;
+        used = ctx->length;
+        memcpy(msg->payload, ctx->state, used);
+    }
+
+    msg->header = *header;
+    msg->header.flags &= ~MSG_FLAG_DELTA;
+    msg->header.length = used;
+    return MSG_HEADER_SIZE + used;
+}
@@ -0,0 +1,141 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Delta_h
+#define QuickESPNow_Delta_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_utils.h"
+
+/**
+ * @brief   Sequence numbers that start the payload of a MSG_FLAG_DELTA message
+ * @note    A keyframe has base equal to sequence and carries the whole value, a delta carries runs of
+ *          changed bytes: the offset, the number of bytes and the bytes themselves.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t sequence;                   ///< Sequence number of the state the message describes.
+    uint8_t base;                       ///< Sequence number of the state the changes apply to.
+} delta_header;
+
+/**
+ * @class   Delta_Table
+ * @brief   Sends only the bytes of a value that changed since the previous message of its type to the same peer.
+ * @note    The sending side keeps the last sent state of each (peer, type) pair and the receiving side the last
+ *          rebuilt one. A delta whose base is not the receiver's state is dropped until the next keyframe, which
+ *          is sent every few messages and after a failed or refused send.
+ * @note    encode(), enable() and disable() are called from the application task, decode() from the WiFi task
+ *          and resync() from both.
+ */
+class Delta_Table {
+    private:
+        /**
+         * @struct  delta_context
+         * @brief   The last state of a (peer, type) pair on one side of the link.
+         */
+        struct delta_context {
+            std::atomic<int> key;               ///< The slot of the peer, -1 if the context is free.
+            uint8_t type;                       ///< The type tag of the messages.
+            uint8_t length;                     ///< The length of the state.
+            uint8_t sequence;                   ///< The sequence number of the state.
+            uint16_t since_keyframe;            ///< Messages sent since the last keyframe (sending side).
+            uint32_t generation;                ///< The peer's resync generation of the last keyframe (sending side).
+            uint8_t state[MSG_MAX_PAYLOAD];     ///< The last state.
+        };
+
+        delta_context sent[DELTA_CONTEXTS];         ///< The states last sent to the peers.
+        delta_context received[DELTA_CONTEXTS];     ///< The states rebuilt from the peers' messages.
+        std::atomic<uint32_t> enabled;              ///< Bit of each peer slot that uses delta encoding.
+        std::atomic<uint32_t> generations[MAX_PEERS];   ///< Raised by each resync, a context of an older one sends a keyframe.
+        uint16_t intervals[MAX_PEERS];              ///< Messages between two keyframes of each peer.
+
+        /**
+         * @brief   Finds the context of a (peer, type) pair, or takes a free one.
+         * @param   contexts The contexts of one side
+         * @param   key The slot of the peer
+         * @param   type The type tag of the messages
+         * @param   create Whether a free context is taken when the pair has none, it starts with an empty state
+         * @return  The context, nullptr if the pair has none and none was taken
+         */
+        static delta_context* context(delta_context* contexts, int key, uint8_t type, bool create);
+
+        /**
+         * @brief   Frees the contexts of a peer on one side.
+         * @param   contexts The contexts of one side
+         * @param   key The slot of the peer
+         */
+        static void forget(delta_context* contexts, int key);
+
+    public:
+        /**
+         * @brief   Constructor to initialize a table without peers.
+         */
+        Delta_Table();
+
+        Delta_Table(const Delta_Table&) = delete;
+        Delta_Table& operator=(const Delta_Table&) = delete;
+
+        /**
+         * @brief   Starts delta encoding the messages to and from a peer.
+         * @param   key The slot of the peer
+         * @param   keyframe_interval The number of messages between two keyframes
+         */
+        void enable(int key, uint16_t keyframe_interval);
+
+        /**
+         * @brief   Stops delta encoding the messages to and from a peer and forgets their states.
+         * @param   key The slot of the peer
+         */
+        void disable(int key);
+
+        /**
+         * @brief   Checks if a peer uses delta encoding.
+         * @param   key The slot of the peer
+         * @return  true if the messages to the peer are delta encoded, false otherwise.
+         */
+        bool isEnabled(int key) const;
+
+        /**
+         * @brief   Makes the next message of every type to a peer a keyframe (either task).
+         * @param   key The slot of the peer
+         */
+        void resync(int key);
+
+        /**
+         * @brief   Rewrites a message as a keyframe or as the changes since the previous one (application task).
+         * @param   key The slot of the destination peer
+         * @param   msg The encoded message, rewritten in place
+         * @param   len The length of the encoded message
+         * @note    Arrays, fragments and messages above PRIORITY_NORMAL, which can overtake the others, are left as they are.
+         * @return  The new length of the message.
+         */
+        int encode(int key, msg_struct* msg, int len);
+
+        /**
+         * @brief   Rebuilds the whole message from a keyframe or a delta (WiFi task).
+         * @param   key The slot of the peer that sent the message
+         * @param   bytes The received MSG_FLAG_DELTA message
+         * @param   len The length of the received message
+         * @param   msg The message that will receive the rebuilt value
+         * @return  The length of the rebuilt message, 0 if it must be dropped.
+         */
+        int decode(int key, const uint8_t* bytes, int len, msg_struct* msg);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "QuickESPNow_Dispatch.h"
+
+#define DISPATCH_TASK_NAME "qen_dispatch"
+
+// Constructor for Msg_Dispatcher
+Msg_Dispatcher::Msg_Dispatcher() : drops(0), enabled(false), posting(0), stopping(false), running(false), task(nullptr) {
+    for(int i = 0; i <= MSG_USER_TYPE_LAST; i++){
+        values[i].invoke.store(nullptr, std::memory_order_relaxed);
+        values[i].handler.store(nullptr, std::memory_order_relaxed);
+        arrays[i].invoke.store(nullptr, std::memory_order_relaxed);
+        arrays[i].handler.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Msg_Dispatcher::~Msg_Dispatcher() {
+    stop();
+}
+
+void Msg_Dispatcher::setHandler(uint8_t type, bool array, handler_invoke_t invoke, void* handler) {
+    handler_entry* entry = array ? &arrays[type] : &values[type];
+    // The handler is in place before the receive callback can see the entry, and stays until it no longer does
+    if(invoke != nullptr){
+        entry->handler.store(handler, std::memory_order_relaxed);
+        entry->invoke.store(invoke, std::memory_order_release);
+    }else{
+        entry->invoke.store(nullptr, std::memory_order_release);
+    }
+}
+
+bool Msg_Dispatcher::start() {
+    if(running.load(std::memory_order_acquire)){
+        return true;
+    }
+    stopping.store(false, std::memory_order_relaxed);
+    running.store(true, std::memory_order_release);
+    if(xTaskCreate(taskLoop, DISPATCH_TASK_NAME, DISPATCH_TASK_STACK, this, DISPATCH_TASK_PRIORITY, &task) != pdPASS){
+        running.store(false, std::memory_order_release);
+        task = nullptr;
+        return false;
+    }
+    enabled.store(true, std::memory_order_seq_cst);
+    return true;
+}
+
+void Msg_Dispatcher::stop() {
+    if(!running.load(std::memory_order_acquire)){
+        return;
+    }
+    // Once no receive callback is inside post(), nothing notifies the task anymore
+    enabled.store(false, std::memory_order_seq_cst);
+    while(posting.load(std::memory_order_seq_cst) != 0){
+        delay(1);
+    }
+    stopping.store(true, std::memory_order_release);
+    xTaskNotifyGive(task);
+    while(running.load(std::memory_order_acquire)){
+        delay(1);
+    }
+    task = nullptr;
+    pending.clear();
+}
+
+bool Msg_Dispatcher::post(int from, const uint8_t* bytes, int len) {
+    posting.fetch_add(1, std::memory_order_seq_cst);
+    if(!enabled.load(std::memory_order_seq_cst)){
+        posting.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    const msg_header* header = (const msg_header*)bytes;
+    const handler_entry* entry = (header->flags & MSG_FLAG_ARRAY) ? &arrays[header->type] : &values[header->type];
+    if(entry->invoke.load(std::memory_order_acquire) == nullptr){
+        posting.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    dispatch_item* item = pending.claim();
+    if(item != nullptr){
+        item->from = from;
+        item->type = header->type;
+        item->flags = header->flags;
+        item->length = (uint8_t)(len - MSG_HEADER_SIZE);
+        memcpy(item->payload, bytes + MSG_HEADER_SIZE, item->length);
+        pending.commit();
+        xTaskNotifyGive(task);
+    }else{
+        drops.fetch_add(1, std::memory_order_relaxed);
+    }
+    posting.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void Msg_Dispatcher::drain() {
+    // The handler reads the payload in place, the slot is only given back once it returns
+    dispatch_item* item;
+    while((item = pending.front()) != nullptr){
+        handler_entry* entry = (item->flags & MSG_FLAG_ARRAY) ? &arrays[item->type] : &values[item->type];
+        handler_invoke_t invoke = entry->invoke.load(std::memory_order_acquire);
+        if(invoke != nullptr){
+            invoke(entry->handler.load(std::memory_order_relaxed), item->from, item->payload, item->length);
+        }
+        pending.drop();
+    }
+}
+
+void Msg_Dispatcher::taskLoop(void* arg) {
+    Msg_Dispatcher* dispatcher = (Msg_Dispatcher*)arg;
+    while(true){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if(dispatcher->stopping.load(std::memory_order_acquire)){
+            break;
+        }
+        dispatcher->drain();
+    }
+    // The dispatcher may be deleted as soon as it sees the task gone
+    dispatcher->running.store(false, std::memory_order_release);
+    vTaskDelete(NULL);
+}
+
+uint32_t Msg_Dispatcher::dropped() const {
+    return drops.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,161 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Dispatch_h
+#define QuickESPNow_Dispatch_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_utils.h"
+#include "QuickESPNow_RingBuffer.h"
+
+/**
+ * @brief   Calls a handler with a payload, one instance per handler signature so the table stays type-free
+ * @param   handler The function registered by the application
+ * @param   from The ID of the sender, -1 if it is not a peer
+ * @param   payload The payload of the message, aligned for any type
+ * @param   size The number of payload bytes
+ */
+typedef void (*handler_invoke_t)(void* handler, int from, const uint8_t* payload, size_t size);
+
+/**
+ * @class   Msg_Dispatcher
+ * @brief   Runs the handlers of the received messages on a task of their own.
+ * @note    The handlers sit in a flat table indexed by type tag, one for values and one for arrays of each tag.
+ *          The receive callback copies a message that has a handler into a ring and notifies the dispatch task,
+ *          which calls the handler as soon as it is scheduled. Nothing is allocated per message.
+ */
+class Msg_Dispatcher {
+    private:
+        /**
+         * @struct  handler_entry
+         * @brief   The handler of a type tag.
+         */
+        struct handler_entry {
+            std::atomic<handler_invoke_t> invoke;   ///< Calls the handler with the right type, nullptr if there is none.
+            std::atomic<void*> handler;             ///< The function registered by the application.
+        };
+
+        /**
+         * @struct  dispatch_item
+         * @brief   A received message that waits for its handler.
+         */
+        struct dispatch_item {
+            alignas(8) uint8_t payload[MSG_MAX_PAYLOAD];   ///< The payload, aligned so arrays are handed over in place.
+            int from;                               ///< The ID of the sender, -1 if it is not a peer.
+            uint8_t type;                           ///< The type tag of the message.
+            uint8_t flags;                          ///< The flags of the message.
+            uint8_t length;                         ///< The number of payload bytes.
+        };
+
+        handler_entry values[MSG_USER_TYPE_LAST + 1];   ///< Handler of the values of each type tag.
+        handler_entry arrays[MSG_USER_TYPE_LAST + 1];   ///< Handler of the arrays of each type tag.
+        Ring_Buffer<dispatch_item, DISPATCH_QUEUE_CAPACITY> pending; ///< Messages waiting for the dispatch task (WiFi to dispatch task).
+        std::atomic<uint32_t> drops;                ///< Messages lost because the ring was full.
+        std::atomic<bool> enabled;                  ///< Whether the receive callback hands messages over.
+        std::atomic<int> posting;                   ///< Receive callbacks inside post(), the task is not stopped under them.
+        std::atomic<bool> stopping;                 ///< The task is asked to end.
+        std::atomic<bool> running;                  ///< Whether the task is alive.
+        TaskHandle_t task;                          ///< The dispatch task, nullptr until start().
+
+        /**
+         * @brief   Body of the dispatch task.
+         * @param   arg The dispatcher
+         */
+        static void taskLoop(void* arg);
+
+        /**
+         * @brief   Calls the handlers of the waiting messages (dispatch task).
+         */
+        void drain();
+
+    public:
+        /**
+         * @brief   Constructor for a dispatcher without handlers or task.
+         */
+        Msg_Dispatcher();
+
+        /**
+         * @brief   Destructor, stops the dispatch task
+         */
+        ~Msg_Dispatcher();
+
+        Msg_Dispatcher(const Msg_Dispatcher&) = delete;
+        Msg_Dispatcher& operator=(const Msg_Dispatcher&) = delete;
+
+        /**
+         * @brief   Sets or removes the handler of a type tag (application task).
+         * @param   type The type tag
+         * @param   array Whether the handler is for arrays
+         * @param   invoke The caller of the handler, nullptr to remove it
+         * @param   handler The function registered by the application
+         */
+        void setHandler(uint8_t type, bool array, handler_invoke_t invoke, void* handler);
+
+        /**
+         * @brief   Starts the dispatch task, if it is not running (application task).
+         * @return  false if the task could not be created.
+         */
+        bool start();
+
+        /**
+         * @brief   Stops the dispatch task once the receive callback is out of post(), the waiting messages are dropped (application task).
+         * @attention   Must not be called from a handler.
+         */
+        void stop();
+
+        /**
+         * @brief   Hands a message over to its handler (WiFi task).
+         * @param   from The ID of the sender, -1 if it is not a peer
+         * @param   bytes The encoded message (header and payload)
+         * @param   len The length of the encoded message
+         * @return
+         *          - true : The message has a handler, it was passed on or dropped because the ring was full
+         *          - false : The message has no handler and should be queued
+         */
+        bool post(int from, const uint8_t* bytes, int len);
+
+        /**
+         * @brief   Gives the number of messages lost because too many waited for their handler.
+         * @return  The number of messages, it only ever grows
+         */
+        uint32_t dropped() const;
+};
+
+/**
+ * @brief   Calls a value handler, a shorter payload leaves the rest of the value default-constructed
+ */
+template<typename T>
+void invokeValueHandler(void* handler, int from, const uint8_t* payload, size_t size) {
+    T value = T();
+    memcpy(&value, payload, std::min(size, sizeof(T)));
+    ((void (*)(int, const T&))handler)(from, value);
+}
+
+/**
+ * @brief   Calls an array handler with the elements in place
+ */
+template<typename T>
+void invokeArrayHandler(void* handler, int from, const uint8_t* payload, size_t size) {
+    ((void (*)(int, const T*, size_t))handler)(from, (const T*)payload, size / sizeof(T));
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include "QuickESPNow_Fragment.h"
+#include "QuickESPNow_Queue.h"
+#include "QuickESPNow_Log.h"
+#include "QuickESPNow_Compress.h"
+
+// Constructor for Frag_Reassembler
+Frag_Reassembler::Frag_Reassembler(size_t arena_size, unsigned long timeout_ms)
+    : block_count((arena_size + FRAG_BLOCK_SIZE - 1) / FRAG_BLOCK_SIZE), timeout_ms(timeout_ms), enabled(true) {
+    this->arena = (uint8_t*)malloc((size_t)this->block_count * FRAG_BLOCK_SIZE);
+    this->blocks = new std::atomic<uint8_t>[this->block_count];
+    if(this->arena == nullptr || this->blocks == nullptr){
+        this->block_count = 0;
+    }
+    for(int i = 0; i < this->block_count; i++){
+        this->blocks[i].store(0, std::memory_order_relaxed);
+    }
+    for(int i = 0; i < FRAG_CONTEXTS; i++){
+        this->contexts[i].used = false;
+    }
+}
+
+// Destructor to clean up the Frag_Reassembler
+Frag_Reassembler::~Frag_Reassembler() {
+    free(this->arena);
+    delete[] this->blocks;
+}
+
+int Frag_Reassembler::regionBlocks(uint32_t total, uint16_t count) {
+    uint32_t bytes = total + (count + 7) / 8;
+    return (bytes + FRAG_BLOCK_SIZE - 1) / FRAG_BLOCK_SIZE;
+}
+
+int32_t Frag_Reassembler::allocate(int region_blocks) {
+    // First fit, only the WiFi task marks blocks used so the scan can not race with another allocation
+    int run = 0;
+    for(int i = 0; i < this->block_count; i++){
+        run = this->blocks[i].load(std::memory_order_acquire) ? 0 : run + 1;
+        if(run == region_blocks){
+            int first = i - region_blocks + 1;
+            for(int b = first; b <= i; b++){
+                this->blocks[b].store(1, std::memory_order_relaxed);
+            }
+            return first * FRAG_BLOCK_SIZE;
+        }
+    }
+    return -1;
+}
+
+void Frag_Reassembler::freeRegion(uint32_t offset, int region_blocks) {
+    int first = offset / FRAG_BLOCK_SIZE;
+    for(int b = first; b < first + region_blocks && b < this->block_count; b++){
+        this->blocks[b].store(0, std::memory_order_release);
+    }
+}
+
+void Frag_Reassembler::dropContext(reassembly_context* ctx) {
+    freeRegion(ctx->offset, regionBlocks(ctx->total, ctx->count));
+    ctx->used = false;
+}
+
+void Frag_Reassembler::add(const uint8_t* mac, const uint8_t* frame, int len, Msg_Queue* queue) {
+    if(!this->enabled.load(std::memory_order_acquire)){
+        return;
+    }
+
+    const msg_header* header = (const msg_header*)frame;
+    if(len < MSG_HEADER_SIZE + (int)sizeof(frag_header)){
+        return;
+    }
+    frag_header fragment;
+    memcpy(&fragment, frame + MSG_HEADER_SIZE, sizeof(frag_header));
+    const uint8_t* chunk = frame + MSG_HEADER_SIZE + sizeof(frag_header);
+    int chunk_len = header->length - (int)sizeof(frag_header);
+
+    // Every fragment but the last one is full, anything else is corrupt
+    if(fragment.count == 0 || fragment.index >= fragment.count ||
+       (uint32_t)fragment.count != (fragment.total + FRAG_CHUNK - 1) / FRAG_CHUNK){
+        return;
+    }
+    uint32_t start = (uint32_t)fragment.index * FRAG_CHUNK;
+    uint32_t expected = fragment.index + 1 < fragment.count ? FRAG_CHUNK : fragment.total - start;
+    if((uint32_t)chunk_len != expected){
+        return;
+    }
+
+    unsigned long now = millis();
+    reassembly_context* ctx = nullptr;
+    reassembly_context* oldest = nullptr;
+    for(int i = 0; i < FRAG_CONTEXTS; i++){
+        reassembly_context* candidate = &this->contexts[i];
+        if(candidate->used && now - candidate->last_fragment >= this->timeout_ms){
+            QEN_LOG_WARN(LOG_FROM_WIFI, LOG_REASSEMBLY_TIMEOUT, candidate->mac, candidate->msg_id);
+            dropContext(candidate);
+        }
+        if(candidate->used && candidate->msg_id == fragment.msg_id && memcmp(candidate->mac, mac, MAC_LENGTH) == 0){
+            ctx = candidate;
+        }
+        if(oldest == nullptr || !candidate->used ||
+           (oldest->used && (long)(candidate->last_fragment - oldest->last_fragment) < 0)){
+            oldest = candidate;
+        }
+    }
+
+    if(ctx != nullptr && (ctx->total != fragment.total || ctx->count != fragment.count)){
+        dropContext(ctx); // The sender reused the ID for another message
+        oldest = ctx;
+        ctx = nullptr;
+    }
+
+    if(ctx == nullptr){
+        // Open a context, the least recently active one makes room if all are in use
+        if(oldest->used){
+            QEN_LOG_WARN(LOG_FROM_WIFI, LOG_FRAGMENT_DROPPED, oldest->mac, oldest->msg_id);
+            dropContext(oldest);
+        }
+        int32_t offset = allocate(regionBlocks(fragment.total, fragment.count));
+        if(offset < 0){
+            QEN_LOG_WARN(LOG_FROM_WIFI, LOG_FRAGMENT_DROPPED, mac, fragment.msg_id);
+            return;
+        }
+        ctx = oldest;
+        memcpy(ctx->mac, mac, MAC_LENGTH);
+        ctx->msg_id = fragment.msg_id;
+        ctx->count = fragment.count;
+        ctx->received = 0;
+        ctx->total = fragment.total;
+        ctx->offset = offset;
+        ctx->used = true;
+        memset(this->arena + offset + fragment.total, 0, (fragment.count + 7) / 8);
+    }
+    ctx->last_fragment = now;
+
+    uint8_t* bitmap = this->arena + ctx->offset + ctx->total;
+    uint8_t bit = 1 << (fragment.index & 7);
+    if(bitmap[fragment.index >> 3] & bit){
+        return; // Duplicate
+    }
+    bitmap[fragment.index >> 3] |= bit;
+    memcpy(this->arena + ctx->offset + start, chunk, chunk_len);
+    ctx->received++;
+
+    if(ctx->received < ctx->count){
+        return;
+    }
+
+    // Complete, the queue takes over the blocks
+    msg_struct ref_msg;
+    large_ref ref = {ctx->offset, ctx->total};
+    ref_msg.header.version = MSG_WIRE_VERSION;
+    ref_msg.header.type = header->type;
+    ref_msg.header.flags = (header->flags & ~(MSG_FLAG_FRAGMENT | MSG_FLAG_COMPRESSED)) | MSG_FLAG_LARGE;
+    ref_msg.header.length = sizeof(large_ref);
+
+    ctx->used = false;
+    if((header->flags & MSG_FLAG_COMPRESSED) && !restore(ctx, &ref)){
+        return;
+    }
+    memcpy(ref_msg.payload, &ref, sizeof(large_ref));
+    if(!queue->add(&ref_msg)){
+        release(&ref);
+    }
+}
+
+bool Frag_Reassembler::restore(reassembly_context* ctx, large_ref* ref) {
+    // The restored message gets its own region, sized like a reassembled one so release() frees it whole
+    uint32_t original = Lz_Codec::originalSize(this->arena + ctx->offset, ctx->total);
+    bool fits = original > 0 && original <= (uint32_t)this->block_count * FRAG_BLOCK_SIZE;
+    int32_t offset = fits ? allocate(regionBlocks(original, (original + FRAG_CHUNK - 1) / FRAG_CHUNK)) : -1;
+    bool restored = offset >= 0 && Lz_Codec::decompress(this->arena + ctx->offset, ctx->total, this->arena + offset);
+    freeRegion(ctx->offset, regionBlocks(ctx->total, ctx->count));
+
+    if(!restored){
+        if(offset >= 0){
+            freeRegion(offset, regionBlocks(original, (original + FRAG_CHUNK - 1) / FRAG_CHUNK));
+        }
+        QEN_LOG_WARN(LOG_FROM_WIFI, LOG_FRAGMENT_DROPPED, ctx->mac, ctx->msg_id);
+        return false;
+    }
+    ref->offset = offset;
+    ref->size = original;
+    return true;
+}
+
+const uint8_t* Frag_Reassembler::data(const large_ref* ref) const {
+    return this->arena + ref->offset;
+}
+
+void Frag_Reassembler::release(const large_ref* ref) {
+    freeRegion(ref->offset, regionBlocks(ref->size, (ref->size + FRAG_CHUNK - 1) / FRAG_CHUNK));
+}
+
+void Frag_Reassembler::setTimeout(unsigned long timeout) {
+    this->timeout_ms = timeout;
+}
+
+void Frag_Reassembler::setEnabled(bool enable) {
+    this->enabled.store(enable, std::memory_order_release);
+}
+
+bool Frag_Reassembler::isValid() const {
+    return this->block_count > 0;
+}
+
+int encodeFragment(msg_struct* msg, uint8_t type, uint8_t flags, uint16_t msg_id, const uint8_t* bytes, uint32_t total, uint16_t index) {
+    frag_header fragment;
+    fragment.msg_id = msg_id;
+    fragment.index = index;
+    fragment.count = (total + FRAG_CHUNK - 1) / FRAG_CHUNK;
+    fragment.total = total;
+
+    uint32_t start = (uint32_t)index * FRAG_CHUNK;
+    int chunk_len = index + 1 < fragment.count ? FRAG_CHUNK : total - start;
+
+    msg->header.version = MSG_WIRE_VERSION;
+    msg->header.type = type;
+    msg->header.flags = flags | MSG_FLAG_FRAGMENT;
+    msg->header.length = sizeof(frag_header) + chunk_len;
+    memcpy(msg->payload, &fragment, sizeof(frag_header));
+    memcpy(msg->payload + sizeof(frag_header), bytes + start, chunk_len);
+
+    return MSG_HEADER_SIZE + msg->header.length;
+}
@@ -0,0 +1,179 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Fragment_h
+#define QuickESPNow_Fragment_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_utils.h"
+
+class Msg_Queue;
+
+/**
+ * @brief   Header that follows the message header in every fragment
+ * @note    The message header of a fragment has MSG_FLAG_FRAGMENT set and keeps the type of the whole message.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t msg_id;                    ///< ID of the message the fragment belongs to (per sender).
+    uint16_t index;                     ///< Position of the fragment in the message.
+    uint16_t count;                     ///< Number of fragments in the message.
+    uint32_t total;                     ///< Size of the whole message in bytes.
+} frag_header;
+
+#define FRAG_CHUNK (MSG_MAX_PAYLOAD - (int)sizeof(frag_header) - RELIABLE_OVERHEAD)    ///< Message bytes carried by a full fragment (room is left for a reliable link header)
+
+/**
+ * @brief   Reference to a reassembled message, queued in place of its payload (MSG_FLAG_LARGE)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t offset;                    ///< Position of the message in the arena.
+    uint32_t size;                      ///< Size of the message in bytes.
+} large_ref;
+
+/**
+ * @class   Frag_Reassembler
+ * @brief   Puts fragmented messages back together in a preallocated arena.
+ * @note    Fragments are added by the WiFi task, one reassembly context per sender and message.
+ *          A complete message is queued as a large_ref, the application task reads it from the arena
+ *          and frees its blocks with release(). Contexts that get no fragment for the timeout are
+ *          dropped when the next fragment arrives, which is the only time their memory is needed.
+ */
+class Frag_Reassembler {
+    private:
+        /**
+         * @struct  reassembly_context
+         * @brief   A message that is being reassembled.
+         */
+        struct reassembly_context {
+            uint8_t mac[MAC_LENGTH];            ///< MAC address of the sender.
+            uint16_t msg_id;                    ///< ID of the message.
+            uint16_t count;                     ///< Number of fragments in the message.
+            uint16_t received;                  ///< Number of different fragments received.
+            uint32_t total;                     ///< Size of the message in bytes.
+            uint32_t offset;                    ///< Position of the message in the arena, the bitmap of the received fragments follows it.
+            unsigned long last_fragment;        ///< Time (ms) the last fragment arrived.
+            bool used;                          ///< Whether the context holds a message.
+        };
+
+        uint8_t* arena;                         ///< Storage of the messages.
+        std::atomic<uint8_t>* blocks;           ///< Which arena blocks are in use (set by the WiFi task, cleared by the owner).
+        int block_count;                        ///< Number of blocks in the arena.
+        reassembly_context contexts[FRAG_CONTEXTS]; ///< The messages being reassembled (WiFi task only).
+        unsigned long timeout_ms;               ///< Time without fragments after which a message is dropped.
+        std::atomic<bool> enabled;              ///< Whether new fragments are accepted.
+
+        /**
+         * @brief   Gives the number of arena blocks a message and its bitmap take.
+         */
+        static int regionBlocks(uint32_t total, uint16_t count);
+
+        /**
+         * @brief   Finds free contiguous blocks for a message and marks them used.
+         * @return  The position in the arena, -1 if there is no room
+         */
+        int32_t allocate(int region_blocks);
+
+        /**
+         * @brief   Marks the blocks of a region free.
+         */
+        void freeRegion(uint32_t offset, int region_blocks);
+
+        /**
+         * @brief   Drops a context and frees its blocks.
+         */
+        void dropContext(reassembly_context* ctx);
+
+        /**
+         * @brief   Restores a reassembled MSG_FLAG_COMPRESSED message into a new region and frees the compressed one.
+         * @param   ctx The completed context
+         * @param   ref The reference to the compressed message, changed to the restored one
+         * @return  false if there is no room or the message is corrupt, it is dropped.
+         */
+        bool restore(reassembly_context* ctx, large_ref* ref);
+
+    public:
+        /**
+         * @brief   Constructor that allocates the arena.
+         * @param   arena_size Size of the arena in bytes, the largest message that can be received is a bit smaller
+         * @param   timeout_ms Time without fragments after which an incomplete message is dropped
+         */
+        Frag_Reassembler(size_t arena_size, unsigned long timeout_ms);
+
+        /**
+         * @brief   Destructor to free the arena.
+         */
+        ~Frag_Reassembler();
+
+        Frag_Reassembler(const Frag_Reassembler&) = delete;
+        Frag_Reassembler& operator=(const Frag_Reassembler&) = delete;
+
+        /**
+         * @brief   Adds a received fragment, queues the message once it is complete (WiFi task).
+         * @param   mac MAC address of the sender
+         * @param   frame The fragment (message header, frag_header and data)
+         * @param   len The length of the fragment
+         * @param   queue The queue for the complete messages
+         */
+        void add(const uint8_t* mac, const uint8_t* frame, int len, Msg_Queue* queue);
+
+        /**
+         * @brief   Gives the bytes of a reassembled message (application task).
+         * @param   ref The reference that was queued for the message
+         * @return  Pointer to the first byte of the message
+         */
+        const uint8_t* data(const large_ref* ref) const;
+
+        /**
+         * @brief   Frees the blocks of a reassembled message once it has been read (application task).
+         * @param   ref The reference that was queued for the message
+         */
+        void release(const large_ref* ref);
+
+        /**
+         * @brief   Sets the time without fragments after which an incomplete message is dropped.
+         */
+        void setTimeout(unsigned long timeout);
+
+        /**
+         * @brief   Starts or stops accepting new fragments.
+         */
+        void setEnabled(bool enable);
+
+        /**
+         * @brief   Checks if the arena was allocated.
+         * @return  false if the allocation failed.
+         */
+        bool isValid() const;
+};
+
+/**
+ * @brief   Encodes one fragment of a large message
+ * @param   msg The message that will hold the fragment
+ * @param   type The type tag of the whole message
+ * @param   flags The flags of the whole message
+ * @param   msg_id The ID of the whole message
+ * @param   bytes The whole message
+ * @param   total The size of the whole message
+ * @param   index The position of the fragment
+ * @return  The number of bytes to be sent
+ */
+int encodeFragment(msg_struct* msg, uint8_t type, uint8_t flags, uint16_t msg_id, const uint8_t* bytes, uint32_t total, uint16_t index);
+
+#endif
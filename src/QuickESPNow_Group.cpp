@@ -0,0 +1,184 @@
+#include "QuickESPNow_Group.h"
+
+// The acknowledgments of a group share a word with the low bits of the sequence number they are for
+#define ACK_SEQUENCE_SHIFT MAX_PEERS
+#define ACK_MEMBERS_MASK ((1u << MAX_PEERS) - 1)
+#define GROUP_ID_MAX 255
+
+// Constructor for Group_Table
+Group_Table::Group_Table() {
+    for(int i = 0; i < GROUP_CAPACITY; i++){
+        groups[i].id.store(-1, std::memory_order_relaxed);
+        groups[i].joined.store(false, std::memory_order_relaxed);
+        groups[i].acks.store(0, std::memory_order_relaxed);
+    }
+}
+
+int Group_Table::find(int id) const {
+    for(int i = 0; i < GROUP_CAPACITY; i++){
+        if(groups[i].id.load(std::memory_order_acquire) == id){
+            return i;
+        }
+    }
+    return -1;
+}
+
+int Group_Table::open(int id) {
+    if(id < 0 || id > GROUP_ID_MAX){
+        return -1;
+    }
+    int index = find(id);
+    if(index != -1){
+        return index;
+    }
+    for(int i = 0; i < GROUP_CAPACITY; i++){
+        if(groups[i].id.load(std::memory_order_relaxed) == -1){
+            // The entry is filled in before the ID publishes it to the receive callback
+            groups[i].members = 0;
+            groups[i].joined.store(false, std::memory_order_relaxed);
+            groups[i].collect_acks = false;
+            groups[i].sequence = 0;
+            groups[i].acks.store(0, std::memory_order_relaxed);
+            groups[i].id.store(id, std::memory_order_release);
+            return i;
+        }
+    }
+    return -1;
+}
+
+void Group_Table::release(int index) {
+    group_entry* entry = &groups[index];
+    if(entry->members == 0 && !entry->collect_acks && !entry->joined.load(std::memory_order_relaxed)){
+        entry->id.store(-1, std::memory_order_release);
+    }
+}
+
+bool Group_Table::addMember(int id, int key) {
+    int index = open(id);
+    if(index == -1 || key < 0 || key >= MAX_PEERS){
+        return false;
+    }
+    groups[index].members |= 1u << key;
+    return true;
+}
+
+void Group_Table::removeMember(int id, int key) {
+    int index = find(id);
+    if(index != -1 && key >= 0 && key < MAX_PEERS){
+        groups[index].members &= ~(1u << key);
+        release(index);
+    }
+}
+
+void Group_Table::forgetPeer(int key) {
+    for(int i = 0; i < GROUP_CAPACITY; i++){
+        int id = groups[i].id.load(std::memory_order_relaxed);
+        if(id != -1){
+            removeMember(id, key);
+        }
+    }
+}
+
+uint32_t Group_Table::members(int id) const {
+    int index = find(id);
+    return index != -1 ? groups[index].members : 0;
+}
+
+bool Group_Table::setJoined(int id, bool join) {
+    int index = join ? open(id) : find(id);
+    if(index == -1){
+        return !join;
+    }
+    groups[index].joined.store(join, std::memory_order_release);
+    release(index);
+    return true;
+}
+
+bool Group_Table::setAcks(int id, bool collect) {
+    int index = collect ? open(id) : find(id);
+    if(index == -1){
+        return !collect;
+    }
+    groups[index].collect_acks = collect;
+    release(index);
+    return true;
+}
+
+int Group_Table::encode(int id, uint8_t* frame) {
+    int index = find(id);
+    if(index == -1){
+        return 0;
+    }
+    group_entry* entry = &groups[index];
+
+    // A reply to an older frame no longer matches once the sequence number moves on
+    entry->sequence++;
+    entry->acks.store((uint32_t)entry->sequence << ACK_SEQUENCE_SHIFT, std::memory_order_release);
+
+    msg_header header = {MSG_WIRE_VERSION, MSG_GROUP_TYPE, 0, sizeof(group_header)};
+    group_header group = {(uint8_t)id, (uint8_t)(entry->collect_acks ? GROUP_FLAG_ACK : 0), entry->sequence};
+    memcpy(frame, &header, MSG_HEADER_SIZE);
+    memcpy(frame + MSG_HEADER_SIZE, &group, sizeof(group_header));
+    return GROUP_OVERHEAD;
+}
+
+bool Group_Table::accept(int key, const uint8_t* frame) {
+    group_header group;
+    memcpy(&group, frame + MSG_HEADER_SIZE, sizeof(group_header));
+    int index = find(group.group);
+
+    if(group.flags & GROUP_FLAG_REPLY){
+        if(index == -1 || key < 0 || key >= MAX_PEERS){
+            return false;
+        }
+        std::atomic<uint32_t>& acks = groups[index].acks;
+        uint32_t state = acks.load(std::memory_order_acquire);
+        while((state >> ACK_SEQUENCE_SHIFT) == ((uint32_t)group.sequence & (0xFFFFFFFFu >> ACK_SEQUENCE_SHIFT)) &&
+              !acks.compare_exchange_weak(state, state | (1u << key), std::memory_order_acq_rel)){
+        }
+        return false;
+    }
+
+    if(index == -1 || !groups[index].joined.load(std::memory_order_acquire)){
+        return false;
+    }
+    // Only a peer can be answered, a full backlog loses the reply and the sender sees the member as missing
+    if((group.flags & GROUP_FLAG_ACK) && key != -1){
+        group.flags = GROUP_FLAG_REPLY;
+        replies.push({key, group});
+    }
+    return true;
+}
+
+bool Group_Table::nextReply(int* key, uint8_t* frame) {
+    group_reply reply;
+    if(!replies.pop(reply)){
+        return false;
+    }
+    msg_header header = {MSG_WIRE_VERSION, MSG_GROUP_TYPE, 0, sizeof(group_header)};
+    memcpy(frame, &header, MSG_HEADER_SIZE);
+    memcpy(frame + MSG_HEADER_SIZE, &reply.header, sizeof(group_header));
+    *key = reply.key;
+    return true;
+}
+
+uint32_t Group_Table::acknowledged(int id) const {
+    int index = find(id);
+    if(index == -1){
+        return 0;
+    }
+    return groups[index].acks.load(std::memory_order_acquire) & ACK_MEMBERS_MASK & groups[index].members;
+}
+
+bool Group_Table::collectsAcks(int id) const {
+    int index = find(id);
+    return index != -1 && groups[index].collect_acks;
+}
+
+void Group_Table::clear() {
+    for(int i = 0; i < GROUP_CAPACITY; i++){
+        groups[i].id.store(-1, std::memory_order_release);
+        groups[i].joined.store(false, std::memory_order_relaxed);
+    }
+    replies.clear();
+}
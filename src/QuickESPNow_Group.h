@@ -0,0 +1,198 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Group_h
+#define QuickESPNow_Group_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_utils.h"
+#include "QuickESPNow_RingBuffer.h"
+
+/**
+ * @brief   Header of the group message (type MSG_GROUP_TYPE) that starts every group frame
+ * @note    The messages of the frame follow it, a reply to an acknowledged group frame carries none.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t group;                      ///< ID of the group the frame is sent to.
+    uint8_t flags;                      ///< Flags of the group frame (GROUP_FLAG_*).
+    uint16_t sequence;                  ///< Number of the group frame, a reply carries the one it acknowledges.
+} group_header;
+
+static_assert(MSG_HEADER_SIZE + sizeof(group_header) == GROUP_OVERHEAD, "GROUP_OVERHEAD does not match the group header");
+static_assert(MAX_PEERS <= 24, "The acknowledgments of a group keep a bit per peer slot next to the sequence number");
+
+/**
+ * @class   Group_Table
+ * @brief   The groups a board sends to, with their members, and the groups it belongs to.
+ * @note    A group frame is broadcast once and every board that joined its group queues the messages,
+ *          the other boards drop it in the receive callback. When the sender collects acknowledgments,
+ *          each member replies to the frame and the reply sets the member's bit, as long as it is for
+ *          the latest frame of the group. The members are peer slots, the groups are set up by the
+ *          application task and read by the WiFi task.
+ */
+class Group_Table {
+    private:
+        /**
+         * @struct  group_entry
+         * @brief   A group this board sends to or belongs to.
+         */
+        struct group_entry {
+            std::atomic<int> id;                    ///< ID of the group, -1 if the entry is free.
+            uint32_t members;                       ///< Bit of each peer slot that belongs to the group.
+            std::atomic<bool> joined;               ///< Whether this board receives the frames of the group.
+            bool collect_acks;                      ///< Whether the members acknowledge the frames sent to the group.
+            uint16_t sequence;                      ///< Number of the latest frame sent to the group.
+            std::atomic<uint32_t> acks;             ///< Low bits of the latest sequence number above the bits of the members that acknowledged it.
+        };
+
+        /**
+         * @struct  group_reply
+         * @brief   An acknowledgment owed to the sender of a group frame.
+         */
+        struct group_reply {
+            int key;                                ///< The slot of the sender.
+            group_header header;                    ///< The header of the acknowledged frame.
+        };
+
+        group_entry groups[GROUP_CAPACITY];         ///< The groups.
+        Ring_Buffer<group_reply, GROUP_REPLY_BACKLOG> replies; ///< Acknowledgments waiting to be sent (WiFi to application task).
+
+        /**
+         * @brief   Finds the entry of a group.
+         * @param   id The ID of the group
+         * @return  The index of the entry, -1 if the group has none
+         */
+        int find(int id) const;
+
+        /**
+         * @brief   Finds the entry of a group or gives it a free one (application task).
+         * @param   id The ID of the group
+         * @return  The index of the entry, -1 if the ID is not 0-255 or all GROUP_CAPACITY entries are in use
+         */
+        int open(int id);
+
+        /**
+         * @brief   Frees an entry that has no members, no acknowledgments to collect and was not joined.
+         * @param   index The index of the entry
+         */
+        void release(int index);
+
+    public:
+        /**
+         * @brief   Constructor to initialize a table without groups.
+         */
+        Group_Table();
+
+        Group_Table(const Group_Table&) = delete;
+        Group_Table& operator=(const Group_Table&) = delete;
+
+        /**
+         * @brief   Adds a peer to the members of a group (application task).
+         * @param   id The ID of the group
+         * @param   key The slot of the peer
+         * @return  false if the ID is not 0-255 or all GROUP_CAPACITY groups are in use.
+         */
+        bool addMember(int id, int key);
+
+        /**
+         * @brief   Removes a peer from the members of a group (application task).
+         * @param   id The ID of the group
+         * @param   key The slot of the peer
+         */
+        void removeMember(int id, int key);
+
+        /**
+         * @brief   Removes a peer from every group (application task).
+         * @param   key The slot of the peer
+         */
+        void forgetPeer(int key);
+
+        /**
+         * @brief   Gives the members of a group.
+         * @param   id The ID of the group
+         * @return  The bit of each peer slot that belongs to the group, 0 if there is no such group
+         */
+        uint32_t members(int id) const;
+
+        /**
+         * @brief   Accepts or stops accepting the frames of a group (application task).
+         * @param   id The ID of the group
+         * @param   join Whether this board belongs to the group
+         * @return  false if the ID is not 0-255 or all GROUP_CAPACITY groups are in use.
+         */
+        bool setJoined(int id, bool join);
+
+        /**
+         * @brief   Makes the members acknowledge the frames sent to a group, or stop doing it (application task).
+         * @param   id The ID of the group
+         * @param   collect Whether the acknowledgments are collected
+         * @return  false if the ID is not 0-255 or all GROUP_CAPACITY groups are in use.
+         */
+        bool setAcks(int id, bool collect);
+
+        /**
+         * @brief   Writes the group header of the next frame sent to a group and forgets the acknowledgments of the previous one (application task).
+         * @param   id The ID of the group
+         * @param   frame The frame, at least GROUP_OVERHEAD bytes
+         * @return  GROUP_OVERHEAD, 0 if there is no such group.
+         */
+        int encode(int id, uint8_t* frame);
+
+        /**
+         * @brief   Checks a received group frame (WiFi task).
+         * @note    A reply is counted if it is for the latest frame of the group, an acknowledgment owed for
+         *          a frame is kept for nextReply().
+         * @param   key The slot of the sender, -1 if it is not a peer
+         * @param   frame The frame, starting with the group message
+         * @return
+         *          - true : This board joined the group, the messages after the group header are delivered
+         *          - false : The frame is dropped
+         */
+        bool accept(int key, const uint8_t* frame);
+
+        /**
+         * @brief   Gives the next acknowledgment owed to the sender of a group frame (application task).
+         * @param   key The variable that will receive the slot of the sender
+         * @param   frame The reply, GROUP_OVERHEAD bytes
+         * @return  false if no acknowledgment is owed.
+         */
+        bool nextReply(int* key, uint8_t* frame);
+
+        /**
+         * @brief   Gives the members that acknowledged the latest frame sent to a group.
+         * @param   id The ID of the group
+         * @return  The bit of each peer slot that acknowledged it, 0 if there is no such group
+         */
+        uint32_t acknowledged(int id) const;
+
+        /**
+         * @brief   Checks if the members of a group acknowledge its frames.
+         * @param   id The ID of the group
+         * @return  false if they do not or there is no such group.
+         */
+        bool collectsAcks(int id) const;
+
+        /**
+         * @brief   Frees every group and drops the owed acknowledgments (application task, receive callback unregistered).
+         */
+        void clear();
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "QuickESPNow_LinkStats.h"
+
+#define LINK_FIXED_SHIFT 4              // The RSSI and jitter averages keep 4 fractional bits
+
+// Constructor for Link_Stats_Table
+Link_Stats_Table::Link_Stats_Table() {
+    for(int key = 0; key < MAX_PEERS; key++){
+        reset(key);
+    }
+}
+
+void Link_Stats_Table::reset(int key) {
+    if(key < 0 || key >= MAX_PEERS){
+        return;
+    }
+    link_entry& entry = entries[key];
+    entry.sequence.store(0, std::memory_order_relaxed);
+    entry.frames = 0;
+    entry.rssi_avg = 0;
+    entry.rssi = 0;
+    entry.noise_floor = 0;
+    entry.rate = 0;
+    entry.last_rx = 0;
+    entry.last_seen = 0;
+    entry.interval_avg = 0;
+    entry.jitter = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void Link_Stats_Table::record(int key, const wifi_pkt_rx_ctrl_t* rx_ctrl) {
+    if(key < 0 || key >= MAX_PEERS){
+        return;
+    }
+    link_entry& entry = entries[key];
+    uint32_t now = micros();
+    // The radio timestamp leaves out the time the frame waited for the callback
+    uint32_t rx_time = rx_ctrl != nullptr ? rx_ctrl->timestamp : now;
+
+    uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+    entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(rx_ctrl != nullptr){
+        entry.rssi = rx_ctrl->rssi;
+        entry.noise_floor = rx_ctrl->noise_floor;
+        entry.rate = rx_ctrl->rate;
+        int32_t rssi = (int32_t)rx_ctrl->rssi * (1 << LINK_FIXED_SHIFT);
+        entry.rssi_avg = entry.frames == 0 ? rssi : entry.rssi_avg + (rssi - entry.rssi_avg) / (1 << LINK_EWMA_SHIFT);
+    }
+    if(entry.frames > 0){
+        int32_t interval = (int32_t)std::min(rx_time - entry.last_rx, (uint32_t)LINK_MAX_INTERVAL);
+        if(entry.interval_avg == 0){
+            entry.interval_avg = interval;
+        }else{
+            int32_t deviation = (interval > entry.interval_avg ? interval - entry.interval_avg : entry.interval_avg - interval) * (1 << LINK_FIXED_SHIFT);
+            entry.jitter += (deviation - entry.jitter) / (1 << LINK_JITTER_SHIFT);
+            entry.interval_avg += (interval - entry.interval_avg) / (1 << LINK_EWMA_SHIFT);
+        }
+    }
+    entry.last_rx = rx_time;
+    entry.last_seen = now;
+    entry.frames++;
+
+    entry.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool Link_Stats_Table::snapshot(int key, link_stats* output) const {
+    if(key < 0 || key >= MAX_PEERS){
+        return false;
+    }
+
+    // Copies again if the WiFi task wrote the entry meanwhile
+    const link_entry& entry = entries[key];
+    link_entry copy;
+    while(true){
+        uint32_t before = entry.sequence.load(std::memory_order_acquire);
+        if(before & 1){
+            continue;
+        }
+        copy.frames = entry.frames;
+        copy.rssi_avg = entry.rssi_avg;
+        copy.rssi = entry.rssi;
+        copy.noise_floor = entry.noise_floor;
+        copy.rate = entry.rate;
+        copy.last_seen = entry.last_seen;
+        copy.interval_avg = entry.interval_avg;
+        copy.jitter = entry.jitter;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(entry.sequence.load(std::memory_order_relaxed) == before){
+            break;
+        }
+    }
+    if(copy.frames == 0){
+        return false;
+    }
+
+    output->frames = copy.frames;
+    output->rssi = (float)copy.rssi_avg / (1 << LINK_FIXED_SHIFT);
+    output->last_rssi = copy.rssi;
+    output->noise_floor = copy.noise_floor;
+    output->rate = copy.rate;
+    output->jitter_us = (float)copy.jitter / (1 << LINK_FIXED_SHIFT);
+    output->age_us = micros() - copy.last_seen;
+    // A peer that went quiet is not reported at the rate it had before, the silence counts as one long interval
+    uint32_t interval = std::max((uint32_t)copy.interval_avg, output->age_us);
+    output->packet_rate = copy.interval_avg > 0 && interval > 0 ? 1000000.0f / interval : 0.0f;
+    return true;
+}
@@ -0,0 +1,102 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_LinkStats_h
+#define QuickESPNow_LinkStats_h
+
+#include <cstddef>
+#include <atomic>
+#include <algorithm>
+#include <Arduino.h>
+#include <esp_wifi.h>
+
+#include "QuickESPNow_enums.h"
+
+/**
+ * @brief   Snapshot of the quality of the link with a peer
+ */
+typedef struct {
+    uint32_t frames;                    ///< Frames received from the peer since it was added.
+    float rssi;                         ///< Moving average of the RSSI (dBm), 0 on Arduino-ESP32 2.x.
+    int8_t last_rssi;                   ///< RSSI (dBm) of the last frame, 0 on Arduino-ESP32 2.x.
+    int8_t noise_floor;                 ///< Noise floor (dBm) reported with the last frame, 0 on Arduino-ESP32 2.x.
+    uint8_t rate;                       ///< PHY rate (wifi_phy_rate_t) of the last frame.
+    float packet_rate;                  ///< Frames per second, from the moving average of the time between frames, 0 after a single frame.
+    float jitter_us;                    ///< Moving average of the deviation (us) of the time between frames from its average.
+    uint32_t age_us;                    ///< Time (us) since the last frame.
+} link_stats;
+
+/**
+ * @class   Link_Stats_Table
+ * @brief   Rolling statistics of the frames received from each peer, from the metadata of the receive callback.
+ * @note    Each peer slot has a fixed entry that the WiFi task updates in constant time. Like the mailboxes,
+ *          an entry is guarded by a sequence lock so the snapshot never waits for the receive callback.
+ */
+class Link_Stats_Table {
+    private:
+        /**
+         * @struct  link_entry
+         * @brief   The statistics of a peer slot.
+         */
+        struct link_entry {
+            std::atomic<uint32_t> sequence;         ///< Odd while the entry is written.
+            uint32_t frames;                        ///< Frames received.
+            int32_t rssi_avg;                       ///< Moving average of the RSSI (1/16 dBm).
+            int8_t rssi;                            ///< RSSI (dBm) of the last frame.
+            int8_t noise_floor;                     ///< Noise floor (dBm) of the last frame.
+            uint8_t rate;                           ///< PHY rate of the last frame.
+            uint32_t last_rx;                       ///< Radio timestamp (us) of the last frame, for the time between frames.
+            uint32_t last_seen;                     ///< Time (us, micros()) of the last frame.
+            int32_t interval_avg;                   ///< Moving average of the time (us) between frames, 0 until the second frame.
+            int32_t jitter;                         ///< Moving average of the deviation (1/16 us) of the time between frames.
+        };
+
+        link_entry entries[MAX_PEERS];              ///< The statistics of each peer slot.
+
+    public:
+        /**
+         * @brief   Constructor for a table without frames.
+         */
+        Link_Stats_Table();
+
+        Link_Stats_Table(const Link_Stats_Table&) = delete;
+        Link_Stats_Table& operator=(const Link_Stats_Table&) = delete;
+
+        /**
+         * @brief   Forgets the statistics of a peer slot, before the slot is given to a new peer (application task).
+         * @param   key The slot of the peer
+         */
+        void reset(int key);
+
+        /**
+         * @brief   Takes a received frame into the statistics of its sender (WiFi task).
+         * @param   key The slot of the peer that sent the frame, -1 if it is not a peer
+         * @param   rx_ctrl The metadata of the frame, nullptr if the core does not give it
+         */
+        void record(int key, const wifi_pkt_rx_ctrl_t* rx_ctrl);
+
+        /**
+         * @brief   Copies the statistics of a peer slot (application task).
+         * @param   key The slot of the peer
+         * @param   output The variable that will receive the statistics
+         * @return
+         *          - true : The statistics were copied
+         *          - false : No frame was received from the peer yet
+         */
+        bool snapshot(int key, link_stats* output) const;
+};
+
+#endif
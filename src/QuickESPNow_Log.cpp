@@ -0,0 +1,134 @@
+#include "QuickESPNow_Log.h"
+
+Ring_Buffer<log_record, LOG_BUFFER_CAPACITY> Log_Buffer::app_records;
+Ring_Buffer<log_record, LOG_BUFFER_CAPACITY> Log_Buffer::wifi_records;
+std::atomic<uint32_t> Log_Buffer::dropped(0);
+
+// Text of each LOG_EVENT, in the order of the enum
+static const char* const event_text[] = {
+    "Successfully sent msg",
+    "Failed to send msg, error",
+    "Delivery Success",
+    "Delivery Fail",
+    "Unknown esp id",
+    "peer has been added succesfuly, id",
+    "Failed to add peer, id",
+    "Too many peers, id",
+    "Array does not fit in a single frame, size",
+    "Transmit queue is full, id",
+    "The send callback is not registered",
+    "allocating memory",
+    "ESP32 Board MAC Address before begin:",
+    "ESP32 Board MAC Address after begin:",
+    "Failed to change MAC",
+    "THERE WERE NO INITIALIZATION ERROR",
+    "initialization error",
+    "Message read as the wrong type was dropped, its type",
+    "No room to reassemble fragmented message, id",
+    "Fragmented message timed out, id",
+    "Failed to send fragmented message, fragment",
+    "Reliable frame was not acknowledged, gave up on sequence",
+    "Delta message missed its base state and was dropped, its type",
+    "Unknown group, id"
+};
+
+// Text of each INITIALIZATION_ERRORS, in the order of the enum
+static const char* const setup_error_text[] = {
+    "no error",
+    "initializing ESP-NOW",
+    "in the consructors communication parameter",
+    "in the value of the channel (channel ranges 0-13)",
+    "setting new MAC address",
+    "adding peer",
+    "allocating memory",
+    "added a peer that has already been added",
+    "getting the number of peers"
+};
+
+// Prefix of each log level
+static const char* const level_text[] = {"", "[Error] ", "[Warning] ", "[Info] ", "[Debug] "};
+
+void Log_Buffer::write(LOG_SOURCE source, uint8_t level, LOG_EVENT event, const uint8_t* mac, int32_t arg) {
+    log_record record;
+    record.timestamp = micros();
+    record.level = level;
+    record.event = event;
+    if(mac != nullptr){
+        memcpy(record.mac, mac, MAC_LENGTH);
+    }else{
+        memset(record.mac, 0, MAC_LENGTH);
+    }
+    record.arg = arg;
+
+    Ring_Buffer<log_record, LOG_BUFFER_CAPACITY>& records = source == LOG_FROM_WIFI ? wifi_records : app_records;
+    if(!records.push(record)){
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Log_Buffer::print(const log_record* record) {
+    char line[96];
+    int used = snprintf(line, sizeof(line), "\r[%lu] %s", (unsigned long)record->timestamp, level_text[record->level]);
+
+    switch(record->event){
+        case LOG_SETUP_ERROR:
+            if(record->arg >= 0 && record->arg < (int32_t)(sizeof(setup_error_text) / sizeof(setup_error_text[0]))){
+                snprintf(line + used, sizeof(line) - used, "%s", setup_error_text[record->arg]);
+            }
+            break;
+        case LOG_OLD_MAC:
+        case LOG_NEW_MAC:
+            snprintf(line + used, sizeof(line) - used, "%s %02X:%02X:%02X:%02X:%02X:%02X", event_text[record->event],
+                     record->mac[0], record->mac[1], record->mac[2], record->mac[3], record->mac[4], record->mac[5]);
+            break;
+        case LOG_SEND_FAIL:
+        case LOG_UNKNOWN_ID:
+        case LOG_PEER_ADDED:
+        case LOG_PEER_ADD_FAIL:
+        case LOG_TOO_MANY_PEERS:
+        case LOG_ARRAY_TOO_LARGE:
+        case LOG_TX_QUEUE_FULL:
+        case LOG_TYPE_MISMATCH:
+        case LOG_FRAGMENT_DROPPED:
+        case LOG_REASSEMBLY_TIMEOUT:
+        case LOG_FRAGMENT_SEND_FAIL:
+        case LOG_RELIABLE_GIVE_UP:
+        case LOG_DELTA_OUT_OF_SYNC:
+        case LOG_UNKNOWN_GROUP:
+            snprintf(line + used, sizeof(line) - used, "%s %ld", event_text[record->event], (long)record->arg);
+            break;
+        default:
+            snprintf(line + used, sizeof(line) - used, "%s", event_text[record->event]);
+            break;
+    }
+    Serial.println(line);
+}
+
+int Log_Buffer::drain(int max_records) {
+    int printed = 0;
+
+    // Merge the two buffers so the records come out in the order they were logged
+    while(printed < max_records){
+        const log_record* app = app_records.front();
+        const log_record* wifi = wifi_records.front();
+        if(app == nullptr && wifi == nullptr){
+            break;
+        }
+
+        if(wifi == nullptr || (app != nullptr && (int32_t)(app->timestamp - wifi->timestamp) <= 0)){
+            print(app);
+            app_records.drop();
+        }else{
+            print(wifi);
+            wifi_records.drop();
+        }
+        printed++;
+    }
+
+    uint32_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if(lost > 0){
+        Serial.print("\r[Warning] log records dropped: ");
+        Serial.println(lost);
+    }
+    return printed;
+}
@@ -0,0 +1,161 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Log_h
+#define QuickESPNow_Log_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_RingBuffer.h"
+
+///< Log levels, a message is compiled in only if its level is at most QUICKESPNOW_LOG_LEVEL
+#define LOG_LEVEL_NONE 0                ///< Nothing is logged
+#define LOG_LEVEL_ERROR 1               ///< Failures that lose messages or break the setup
+#define LOG_LEVEL_WARN 2                ///< Rejected calls that the application can retry
+#define LOG_LEVEL_INFO 3                ///< Setup progress
+#define LOG_LEVEL_DEBUG 4               ///< Every sent and delivered frame
+
+#ifndef QUICKESPNOW_LOG_LEVEL
+#define QUICKESPNOW_LOG_LEVEL LOG_LEVEL_INFO   ///< Log level of the library, set it with a build flag
+#endif
+
+#ifndef LOG_BUFFER_CAPACITY
+#define LOG_BUFFER_CAPACITY 32          ///< Number of records each log buffer can hold (must be a power of two)
+#endif
+
+#define LOG_DRAIN_PER_UPDATE 4          ///< Number of records printed by each update() call
+
+/**
+ * @brief   Enum for the task that writes a log record.
+ * @note    Each task writes to its own buffer so that both stay single-producer.
+ */
+enum LOG_SOURCE {
+    LOG_FROM_APP,       ///< The application task (loop, setup)
+    LOG_FROM_WIFI       ///< The WiFi task (send and receive callbacks)
+};
+
+/**
+ * @brief   Enum for the events that can be logged.
+ */
+enum LOG_EVENT {
+    LOG_SEND_OK,                ///< Successfully sent msg
+    LOG_SEND_FAIL,              ///< Failed to send msg (arg: esp_err_t)
+    LOG_DELIVERY_OK,            ///< Delivery Success
+    LOG_DELIVERY_FAIL,          ///< Delivery Fail
+    LOG_UNKNOWN_ID,             ///< Unknown esp id (arg: ID)
+    LOG_PEER_ADDED,             ///< Peer has been added (arg: ID)
+    LOG_PEER_ADD_FAIL,          ///< Failed to add peer (arg: ID)
+    LOG_TOO_MANY_PEERS,         ///< Too many peers (arg: ID)
+    LOG_ARRAY_TOO_LARGE,        ///< Array does not fit in a single frame (arg: size)
+    LOG_TX_QUEUE_FULL,          ///< Transmit queue is full (arg: ID)
+    LOG_NO_SEND_CALLBACK,       ///< The send callback is not registered
+    LOG_ALLOCATION_FAIL,        ///< Allocating memory failed
+    LOG_OLD_MAC,                ///< ESP32 Board MAC Address before begin
+    LOG_NEW_MAC,                ///< ESP32 Board MAC Address after begin
+    LOG_MAC_CHANGE_FAIL,        ///< Failed to change MAC
+    LOG_SETUP_OK,               ///< There were no initialization errors
+    LOG_SETUP_ERROR,            ///< Initialization error (arg: INITIALIZATION_ERRORS)
+    LOG_TYPE_MISMATCH,          ///< A message was read as another type and dropped (arg: type tag of the message)
+    LOG_FRAGMENT_DROPPED,       ///< A fragmented message was dropped for lack of room (arg: message id)
+    LOG_REASSEMBLY_TIMEOUT,     ///< A fragmented message was not completed in time (arg: message id)
+    LOG_FRAGMENT_SEND_FAIL,     ///< A fragmented message could not be sent (arg: index of the failed fragment)
+    LOG_RELIABLE_GIVE_UP,       ///< A reliable frame was never acknowledged (arg: sequence number)
+    LOG_DELTA_OUT_OF_SYNC,      ///< A delta encoded message was dropped until the next keyframe (arg: type tag of the message)
+    LOG_UNKNOWN_GROUP           ///< A group that has no members or acknowledgments to collect (arg: group ID)
+};
+
+/**
+ * @brief   Fixed-size binary log record, formatted only when it is drained
+ */
+typedef struct {
+    uint32_t timestamp;             ///< Time (us) the event was logged.
+    uint8_t level;                  ///< Level of the event (LOG_LEVEL_*).
+    uint8_t event;                  ///< The event (LOG_EVENT).
+    uint8_t mac[MAC_LENGTH];        ///< MAC address related to the event, zero if none.
+    int32_t arg;                    ///< Value related to the event.
+} log_record;
+
+/**
+ * @class   Log_Buffer
+ * @brief   Deferred logger that keeps binary records in lock-free ring buffers.
+ * @note    Writing a record costs a copy of 16 bytes, the text is produced by drain(),
+ *          which must only be called from the application task.
+ */
+class Log_Buffer {
+    private:
+        static Ring_Buffer<log_record, LOG_BUFFER_CAPACITY> app_records;    ///< Records of the application task.
+        static Ring_Buffer<log_record, LOG_BUFFER_CAPACITY> wifi_records;   ///< Records of the WiFi task.
+        static std::atomic<uint32_t> dropped;                               ///< Records lost because a buffer was full.
+
+        /**
+         * @brief   Prints a single record to Serial.
+         * @param   record The record to be printed
+         */
+        static void print(const log_record* record);
+
+    public:
+        /**
+         * @brief   Writes a record to the buffer of its task.
+         * @param   source The task that logs the event
+         * @param   level The level of the event
+         * @param   event The event
+         * @param   mac MAC address related to the event, nullptr if none
+         * @param   arg Value related to the event
+         */
+        static void write(LOG_SOURCE source, uint8_t level, LOG_EVENT event, const uint8_t* mac, int32_t arg);
+
+        /**
+         * @brief   Prints the buffered records to Serial in the order they were logged.
+         * @param   max_records The maximum number of records to print, so the caller's loop is not held up
+         * @return  The number of printed records
+         */
+        static int drain(int max_records);
+};
+
+#if QUICKESPNOW_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define QEN_LOG_ERROR(source, event, mac, arg) Log_Buffer::write(source, LOG_LEVEL_ERROR, event, mac, arg)
+#else
+#define QEN_LOG_ERROR(source, event, mac, arg) ((void)0)
+#endif
+
+#if QUICKESPNOW_LOG_LEVEL >= LOG_LEVEL_WARN
+#define QEN_LOG_WARN(source, event, mac, arg) Log_Buffer::write(source, LOG_LEVEL_WARN, event, mac, arg)
+#else
+#define QEN_LOG_WARN(source, event, mac, arg) ((void)0)
+#endif
+
+#if QUICKESPNOW_LOG_LEVEL >= LOG_LEVEL_INFO
+#define QEN_LOG_INFO(source, event, mac, arg) Log_Buffer::write(source, LOG_LEVEL_INFO, event, mac, arg)
+#else
+#define QEN_LOG_INFO(source, event, mac, arg) ((void)0)
+#endif
+
+#if QUICKESPNOW_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define QEN_LOG_DEBUG(source, event, mac, arg) Log_Buffer::write(source, LOG_LEVEL_DEBUG, event, mac, arg)
+#else
+#define QEN_LOG_DEBUG(source, event, mac, arg) ((void)0)
+#endif
+
+#if QUICKESPNOW_LOG_LEVEL > LOG_LEVEL_NONE
+#define QEN_LOG_DRAIN(max_records) Log_Buffer::drain(max_records)
+#else
+#define QEN_LOG_DRAIN(max_records) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+#include "QuickESPNow_Mailbox.h"
+
+// Constructor for Mailbox_Table
+Mailbox_Table::Mailbox_Table() : open_count(0) {
+    for(int i = 0; i < MAILBOX_CAPACITY; i++){
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+        slots[i].key.store(-1, std::memory_order_relaxed);
+    }
+}
+
+int Mailbox_Table::find(int key, uint8_t type) const {
+    for(int i = 0; i < MAILBOX_CAPACITY; i++){
+        if(slots[i].key.load(std::memory_order_acquire) == key && slots[i].type == type){
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool Mailbox_Table::open(int key, uint8_t type) {
+    if(key < 0 || find(key, type) != -1){
+        return key >= 0;
+    }
+    for(int i = 0; i < MAILBOX_CAPACITY; i++){
+        if(slots[i].key.load(std::memory_order_relaxed) == -1){
+            // The slot is filled in before the key publishes it to the receive callback
+            slots[i].type = type;
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+            slots[i].key.store(key, std::memory_order_release);
+            open_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Mailbox_Table::close(int key, uint8_t type) {
+    int index = find(key, type);
+    if(index != -1){
+        slots[index].key.store(-1, std::memory_order_release);
+        open_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void Mailbox_Table::closeAll(int key) {
+    for(int i = 0; i < MAILBOX_CAPACITY; i++){
+        if(key >= 0 && slots[i].key.load(std::memory_order_relaxed) == key){
+            slots[i].key.store(-1, std::memory_order_release);
+            open_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Mailbox_Table::write(int key, const uint8_t* bytes, int len) {
+    if(key < 0 || open_count.load(std::memory_order_relaxed) == 0){
+        return false;
+    }
+    // Arrays of the type still go to the queue, a mailbox only holds single values
+    const msg_header* header = (const msg_header*)bytes;
+    if(header->flags & MSG_FLAG_ARRAY){
+        return false;
+    }
+    int index = find(key, header->type);
+    if(index == -1){
+        return false;
+    }
+
+    mailbox_slot& slot = slots[index];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.length = len - MSG_HEADER_SIZE;
+    slot.stamp = micros();
+    memcpy(slot.payload, bytes + MSG_HEADER_SIZE, slot.length);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    return true;
+}
+
+bool Mailbox_Table::read(int key, uint8_t type, void* output, size_t size, uint32_t* stamp) const {
+    int index = find(key, type);
+    if(index == -1){
+        return false;
+    }
+
+    // Copies again if the WiFi task wrote the slot meanwhile, a write only takes a memcpy
+    const mailbox_slot& slot = slots[index];
+    while(true){
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if(before == 0){
+            return false;
+        }
+        if(before & 1){
+            continue;
+        }
+        memcpy(output, slot.payload, std::min(size, (size_t)slot.length));
+        *stamp = slot.stamp;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed) == before){
+            return true;
+        }
+    }
+}
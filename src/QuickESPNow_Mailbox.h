@@ -0,0 +1,119 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Mailbox_h
+#define QuickESPNow_Mailbox_h
+
+#include <cstddef>
+#include <atomic>
+#include <algorithm>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_utils.h"
+
+/**
+ * @class   Mailbox_Table
+ * @brief   Keeps only the newest message of each (peer, type) pair that has a mailbox.
+ * @note    Each mailbox is a single preallocated slot that the WiFi task overwrites in place. It is guarded
+ *          by a sequence lock: the sequence is odd while the slot is written, and a reader that sees it
+ *          change copies the slot again, so the writer never waits for the application.
+ */
+class Mailbox_Table {
+    private:
+        /**
+         * @struct  mailbox_slot
+         * @brief   The newest message of a (peer, type) pair.
+         */
+        struct mailbox_slot {
+            std::atomic<uint32_t> sequence;         ///< Odd while the slot is written, 0 until the first message.
+            std::atomic<int> key;                   ///< The slot of the peer, -1 if the mailbox is free.
+            uint8_t type;                           ///< The type tag of the messages it keeps.
+            uint8_t length;                         ///< The length of the payload.
+            uint32_t stamp;                         ///< Time (us) the message was received.
+            uint8_t payload[MSG_MAX_PAYLOAD];       ///< The payload of the message.
+        };
+
+        mailbox_slot slots[MAILBOX_CAPACITY];       ///< The mailboxes.
+        std::atomic<int> open_count;                ///< Number of mailboxes in use, the receive callback skips the lookup when 0.
+
+        /**
+         * @brief   Finds the mailbox of a (peer, type) pair.
+         * @param   key The slot of the peer
+         * @param   type The type tag of the messages
+         * @return  The index of the mailbox, -1 if the pair has none
+         */
+        int find(int key, uint8_t type) const;
+
+    public:
+        /**
+         * @brief   Constructor to initialize a table without mailboxes.
+         */
+        Mailbox_Table();
+
+        Mailbox_Table(const Mailbox_Table&) = delete;
+        Mailbox_Table& operator=(const Mailbox_Table&) = delete;
+
+        /**
+         * @brief   Gives a (peer, type) pair a mailbox (application task).
+         * @param   key The slot of the peer
+         * @param   type The type tag of the messages
+         * @return
+         *          - true : The messages of this type from this peer go to the mailbox
+         *          - false : All MAILBOX_CAPACITY mailboxes are in use
+         */
+        bool open(int key, uint8_t type);
+
+        /**
+         * @brief   Frees the mailbox of a (peer, type) pair, its messages go to the queue again (application task).
+         * @param   key The slot of the peer
+         * @param   type The type tag of the messages
+         */
+        void close(int key, uint8_t type);
+
+        /**
+         * @brief   Frees every mailbox of a peer (application task).
+         * @param   key The slot of the peer
+         */
+        void closeAll(int key);
+
+        /**
+         * @brief   Overwrites the mailbox of a message, if it has one (WiFi task).
+         * @note    Arrays never have a mailbox, even when single values of their type do.
+         * @param   key The slot of the peer that sent the message, -1 if it is not a peer
+         * @param   bytes The encoded message (header and payload)
+         * @param   len The length of the encoded message
+         * @return
+         *          - true : The message was kept in its mailbox
+         *          - false : The message has no mailbox and should be queued
+         */
+        bool write(int key, const uint8_t* bytes, int len);
+
+        /**
+         * @brief   Copies the newest message of a (peer, type) pair (application task).
+         * @param   key The slot of the peer
+         * @param   type The type tag of the messages
+         * @param   output The buffer that will receive the payload
+         * @param   size The size of the buffer, a longer payload is cut
+         * @param   stamp The variable that will receive the time (us) the message was received
+         * @return
+         *          - true : The newest message was copied
+         *          - false : The pair has no mailbox or no message arrived yet
+         */
+        bool read(int key, uint8_t type, void* output, size_t size, uint32_t* stamp) const;
+};
+
+#endif
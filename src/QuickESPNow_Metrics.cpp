@@ -0,0 +1,69 @@
+#include "QuickESPNow_Metrics.h"
+
+std::atomic<uint32_t> Perf_Counters::counters[PERF_COUNTERS];
+std::atomic<uint32_t> Perf_Counters::histograms[PERF_HISTOGRAMS][PERF_HISTOGRAM_BUCKETS];
+
+// JSON key of each PERF_COUNTER, in the order of the enum
+static const char* const counter_text[] = {
+    "frames_sent",
+    "send_errors",
+    "frames_delivered",
+    "frames_failed",
+    "frames_received",
+    "bytes_sent",
+    "bytes_received",
+    "channel_switches"
+};
+
+// JSON key of each PERF_HISTOGRAM, in the order of the enum
+static const char* const histogram_text[] = {
+    "send_to_ack_us",
+    "receive_to_read_us"
+};
+
+void Perf_Counters::snapshot(perf_snapshot* output) {
+    output->version = PERF_SNAPSHOT_VERSION;
+    for(int i = 0; i < PERF_COUNTERS; i++){
+        output->counters[i] = counters[i].load(std::memory_order_relaxed);
+    }
+    for(int h = 0; h < PERF_HISTOGRAMS; h++){
+        for(int b = 0; b < PERF_HISTOGRAM_BUCKETS; b++){
+            output->histograms[h][b] = histograms[h][b].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Perf_Counters::reset() {
+    for(int i = 0; i < PERF_COUNTERS; i++){
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+    for(int h = 0; h < PERF_HISTOGRAMS; h++){
+        for(int b = 0; b < PERF_HISTOGRAM_BUCKETS; b++){
+            histograms[h][b].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t Perf_Counters::toJson(const perf_snapshot* input, char* buffer, size_t size) {
+    size_t used = 0;
+    // Keeps counting the length once the buffer is full, like snprintf
+    auto append = [&](const char* format, auto... args){
+        int written = snprintf(used < size ? buffer + used : nullptr, used < size ? size - used : 0, format, args...);
+        used += written > 0 ? written : 0;
+    };
+
+    append("{\"version\":%u,\"queue_high_water\":%u,\"queue_drops\":%lu",
+           (unsigned)input->version, (unsigned)input->queue_high_water, (unsigned long)input->queue_drops);
+    for(int i = 0; i < PERF_COUNTERS; i++){
+        append(",\"%s\":%lu", counter_text[i], (unsigned long)input->counters[i]);
+    }
+    for(int h = 0; h < PERF_HISTOGRAMS; h++){
+        append(",\"%s\":[", histogram_text[h]);
+        for(int b = 0; b < PERF_HISTOGRAM_BUCKETS; b++){
+            append(b == 0 ? "%lu" : ",%lu", (unsigned long)input->histograms[h][b]);
+        }
+        append("]");
+    }
+    append("}");
+    return used;
+}
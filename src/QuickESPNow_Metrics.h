@@ -0,0 +1,123 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Metrics_h
+#define QuickESPNow_Metrics_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+
+/**
+ * @brief   Enum for the counters of the library.
+ */
+enum PERF_COUNTER {
+    PERF_FRAMES_SENT,           ///< Frames handed to the driver
+    PERF_SEND_ERRORS,           ///< Frames the driver refused
+    PERF_FRAMES_DELIVERED,      ///< Frames the send callback reported as delivered
+    PERF_FRAMES_FAILED,         ///< Frames the send callback reported as failed
+    PERF_FRAMES_RECEIVED,       ///< Frames given to the receive callback
+    PERF_BYTES_SENT,            ///< Bytes of the frames handed to the driver
+    PERF_BYTES_RECEIVED,        ///< Bytes of the frames given to the receive callback
+    PERF_CHANNEL_SWITCHES,      ///< Times the radio was moved to another channel
+    PERF_COUNTERS               ///< Number of counters
+};
+
+/**
+ * @brief   Enum for the latency histograms of the library.
+ */
+enum PERF_HISTOGRAM {
+    PERF_SEND_TO_ACK,           ///< Time from handing a frame to the driver until its send callback
+    PERF_RECEIVE_TO_READ,       ///< Time from queueing a message until the application reads it
+    PERF_HISTOGRAMS             ///< Number of histograms
+};
+
+/**
+ * @brief   Snapshot of the counters and histograms, a fixed layout that can be stored or sent as it is
+ */
+typedef struct {
+    uint16_t version;                                               ///< Layout version (PERF_SNAPSHOT_VERSION).
+    uint16_t queue_high_water;                                      ///< Most messages a receive queue held at once.
+    uint32_t queue_drops;                                           ///< Messages lost because a receive queue or the dispatch ring was full.
+    uint32_t counters[PERF_COUNTERS];                               ///< The value of each PERF_COUNTER.
+    uint32_t histograms[PERF_HISTOGRAMS][PERF_HISTOGRAM_BUCKETS];   ///< The buckets of each PERF_HISTOGRAM.
+} perf_snapshot;
+
+#define PERF_SNAPSHOT_VERSION 1         ///< Version of the perf_snapshot layout
+
+/**
+ * @class   Perf_Counters
+ * @brief   Lock-free counters and log-bucketed latency histograms shared by every task.
+ * @note    Counting is a relaxed atomic add, a latency sample also finds its bucket with a count of leading zeros.
+ *          Nothing is formatted until a snapshot is taken.
+ */
+class Perf_Counters {
+    private:
+        static std::atomic<uint32_t> counters[PERF_COUNTERS];                               ///< The counters.
+        static std::atomic<uint32_t> histograms[PERF_HISTOGRAMS][PERF_HISTOGRAM_BUCKETS];   ///< The histogram buckets.
+
+    public:
+        /**
+         * @brief   Adds to a counter.
+         * @param   counter The counter
+         * @param   amount The amount to be added
+         */
+        static inline void add(PERF_COUNTER counter, uint32_t amount) {
+            counters[counter].fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief   Counts a latency sample in the bucket of its power of two.
+         * @param   histogram The histogram
+         * @param   us The latency (us)
+         */
+        static inline void sample(PERF_HISTOGRAM histogram, uint32_t us) {
+            int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+            histograms[histogram][bucket < PERF_HISTOGRAM_BUCKETS ? bucket : PERF_HISTOGRAM_BUCKETS - 1].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief   Copies the counters and histograms, the queue fields are left to the caller.
+         * @param   output The snapshot to be filled in
+         */
+        static void snapshot(perf_snapshot* output);
+
+        /**
+         * @brief   Sets every counter and histogram back to zero.
+         */
+        static void reset();
+
+        /**
+         * @brief   Writes a snapshot as a JSON object.
+         * @param   input The snapshot
+         * @param   buffer The buffer that will receive the text
+         * @param   size The size of the buffer, a longer text is cut
+         * @return  The length of the whole text, like snprintf
+         */
+        static size_t toJson(const perf_snapshot* input, char* buffer, size_t size);
+};
+
+#if QUICKESPNOW_METRICS
+#define QEN_COUNT(counter, amount) Perf_Counters::add(counter, amount)
+#define QEN_LATENCY(histogram, us) Perf_Counters::sample(histogram, us)
+#else
+#define QEN_COUNT(counter, amount) ((void)0)
+#define QEN_LATENCY(histogram, us) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#include "QuickESPNow_PeerTable.h"
+
+// Constructor for Peer_Table
+Peer_Table::Peer_Table(int capacity) : slots(capacity), count(0) {
+    // Keep the hash index at most half full so the probe sequences stay short
+    int index_size = 1;
+    while(index_size < 2 * capacity){
+        index_size <<= 1;
+    }
+    this->index_mask = index_size - 1;
+
+    this->entries = (peer_entry*)calloc(capacity, sizeof(peer_entry));
+    this->index = (int16_t*)malloc(index_size * sizeof(int16_t));
+    if(this->entries == nullptr || this->index == nullptr){
+        this->slots = 0;
+        this->index_mask = 0;
+    }
+    rebuildIndex();
+}
+
+// Destructor to clean up the Peer_Table
+Peer_Table::~Peer_Table() {
+    free(this->entries);
+    free(this->index);
+}
+
+int Peer_Table::hash(int id) const {
+    return (int)(((uint32_t)id * 2654435761u) >> 16) & this->index_mask;
+}
+
+void Peer_Table::rebuildIndex() {
+    if(this->index == nullptr){
+        return;
+    }
+    for(int i = 0; i <= this->index_mask; i++){
+        this->index[i] = -1;
+    }
+    for(int slot = 0; slot < this->slots; slot++){
+        if(!this->entries[slot].used){
+            continue;
+        }
+        int pos = hash(this->entries[slot].id);
+        while(this->index[pos] != -1){
+            pos = (pos + 1) & this->index_mask;
+        }
+        this->index[pos] = slot;
+    }
+}
+
+int Peer_Table::add(int id, const esp_now_peer_info_t* info) {
+    int slot = find(id);
+
+    if(slot == -1){
+        for(int i = 0; i < this->slots; i++){
+            if(!this->entries[i].used){
+                slot = i;
+                break;
+            }
+        }
+        if(slot == -1){
+            return -1; // The table is full
+        }
+
+        int pos = hash(id);
+        while(this->index[pos] != -1){
+            pos = (pos + 1) & this->index_mask;
+        }
+        this->index[pos] = slot;
+        this->count++;
+    }
+
+    peer_entry* entry = &this->entries[slot];
+    entry->id = id;
+    memcpy(entry->mac, info->peer_addr, MAC_LENGTH);
+    entry->channel = info->channel;
+    entry->ifidx = info->ifidx;
+    entry->encrypt = info->encrypt;
+    entry->used = true;
+
+    return slot;
+}
+
+bool Peer_Table::remove(int id) {
+    int slot = find(id);
+    if(slot == -1){
+        return false;
+    }
+
+    this->entries[slot].used = false;
+    this->count--;
+    rebuildIndex(); // Removing is rare, rebuilding avoids tombstones in the probe sequences
+    return true;
+}
+
+int Peer_Table::find(int id) const {
+    if(this->slots == 0){
+        return -1;
+    }
+    int pos = hash(id);
+    while(this->index[pos] != -1){
+        int slot = this->index[pos];
+        if(this->entries[slot].id == id){
+            return slot;
+        }
+        pos = (pos + 1) & this->index_mask;
+    }
+    return -1;
+}
+
+const peer_entry* Peer_Table::get(int slot) const {
+    if(slot < 0 || slot >= this->slots || !this->entries[slot].used){
+        return nullptr;
+    }
+    return &this->entries[slot];
+}
+
+int Peer_Table::capacity() const {
+    return this->slots;
+}
+
+int Peer_Table::size() const {
+    return this->count;
+}
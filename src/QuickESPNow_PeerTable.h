@@ -0,0 +1,123 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_PeerTable_h
+#define QuickESPNow_PeerTable_h
+
+#include <cstddef>
+#include <Arduino.h>
+#include <esp_now.h>
+
+#include "QuickESPNow_enums.h"
+
+/**
+ * @brief   Local copy of the driver state of a peer
+ */
+typedef struct {
+    int id;                         ///< The ID assigned to the peer with addPeer.
+    uint8_t mac[MAC_LENGTH];        ///< The peer's MAC address.
+    uint8_t channel;                ///< The peer's channel (0 means the current channel).
+    wifi_interface_t ifidx;         ///< The WiFi interface used to reach the peer.
+    bool encrypt;                   ///< Whether the traffic to the peer is encrypted.
+    bool used;                      ///< Whether the slot holds a peer.
+} peer_entry;
+
+/**
+ * @class   Peer_Table
+ * @brief   Maps the peers' IDs to fixed slots in constant time and caches their driver state.
+ * @note    The slot of a peer never changes while the peer is registered, so it can be used
+ *          to index other per peer arrays.
+ */
+class Peer_Table {
+    private:
+        peer_entry* entries;        ///< The peers, one per slot.
+        int16_t* index;             ///< Open addressing hash index from ID to slot, -1 when empty.
+        int index_mask;             ///< Size of the hash index minus one (the size is a power of two).
+        int slots;                  ///< Number of slots in the table.
+        int count;                  ///< Number of registered peers.
+
+        /**
+         * @brief   Gives the first hash index position of an ID
+         * @param   id The peer's ID
+         * @return  The position in the hash index
+         */
+        int hash(int id) const;
+
+        /**
+         * @brief   Rebuilds the hash index from the registered peers
+         */
+        void rebuildIndex();
+
+    public:
+        /**
+         * @brief   Constructor to initialize an empty table.
+         * @param   capacity The maximum number of peers.
+         */
+        Peer_Table(int capacity);
+
+        /**
+         * @brief   Destructor to clean up the Peer_Table.
+         */
+        ~Peer_Table();
+
+        Peer_Table(const Peer_Table&) = delete;
+        Peer_Table& operator=(const Peer_Table&) = delete;
+
+        /**
+         * @brief   Registers a peer or refreshes the cached state of an already registered ID.
+         * @param   id The peer's ID
+         * @param   info The peer's driver information
+         * @return  The slot of the peer, -1 if the table is full
+         */
+        int add(int id, const esp_now_peer_info_t* info);
+
+        /**
+         * @brief   Removes a peer from the table.
+         * @param   id The peer's ID
+         * @return
+         *          - true : The peer was removed
+         *          - false : There is no peer with this ID
+         */
+        bool remove(int id);
+
+        /**
+         * @brief   Finds the slot of a peer in constant time.
+         * @param   id The peer's ID
+         * @return  The slot of the peer, -1 if there is no peer with this ID
+         */
+        int find(int id) const;
+
+        /**
+         * @brief   Gives the cached state of the peer in a slot.
+         * @param   slot The slot of the peer
+         * @return  Pointer to the peer's entry, nullptr if the slot is empty
+         */
+        const peer_entry* get(int slot) const;
+
+        /**
+         * @brief   Gives the number of slots of the table.
+         * @return  The maximum number of peers.
+         */
+        int capacity() const;
+
+        /**
+         * @brief   Gives the number of registered peers.
+         * @return  The number of peers in the table.
+         */
+        int size() const;
+};
+
+#endif
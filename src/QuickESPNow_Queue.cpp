@@ -1,48 +1,318 @@
 #include "QuickESPNow_Queue.h"
+#include "QuickESPNow_Fragment.h"
 
 // Constructor for Msg_Queue
-Msg_Queue::Msg_Queue() : front(nullptr), rear(nullptr) {}
+Msg_Queue::Msg_Queue() : spare(MSG_QUEUE_CAPACITY), front(-1), overflow(DROP_NEWEST), drops(0), high_water(0), borrowed(false), large_store(nullptr), source(-1) {
+    for (uint16_t i = 0; i < MSG_QUEUE_CAPACITY; i++) {
+        free_slots.push(i);
+    }
+}
 
 // Destructor to clean up the Msg_Queue
 Msg_Queue::~Msg_Queue() {
-    while (!isEmpty()) {
-        node* temp = front;
-        front = front->next;
-        delete temp;  // Clean up the base node directly
+    clear();
+}
+
+void Msg_Queue::setLargeStore(Frag_Reassembler* store) {
+    large_store = store;
+}
+
+void Msg_Queue::setSender(int id) {
+    source = id;
+}
+
+int Msg_Queue::sender() const {
+    return source;
+}
+
+void Msg_Queue::setOverflowPolicy(OVERFLOW_POLICY policy) {
+    overflow.store(policy, std::memory_order_relaxed);
+}
+
+OVERFLOW_POLICY Msg_Queue::overflowPolicy() const {
+    return (OVERFLOW_POLICY)overflow.load(std::memory_order_relaxed);
+}
+
+uint32_t Msg_Queue::dropped() const {
+    return drops.load(std::memory_order_relaxed);
+}
+
+uint16_t Msg_Queue::highWater() const {
+    return high_water.load(std::memory_order_relaxed);
+}
+
+void Msg_Queue::resetHighWater() {
+    high_water.store((uint16_t)(MSG_QUEUE_CAPACITY - free_slots.size()), std::memory_order_relaxed);
+}
+
+const uint8_t* Msg_Queue::payloadOf(const msg_struct* msg, size_t* size) const {
+    if ((msg->header.flags & MSG_FLAG_LARGE) && large_store != nullptr) {
+        large_ref ref;
+        memcpy(&ref, msg->payload, sizeof(large_ref));
+        *size = ref.size;
+        return large_store->data(&ref);
+    }
+    *size = msg->header.length;
+    return msg->payload;
+}
+
+const msg_struct* Msg_Queue::head() const {
+    if (front == -1) {
+        // Taking the slot out of its ring keeps the producer from replacing it while it is read
+        uint16_t slot;
+        for (int priority = MSG_PRIORITIES - 1; priority >= 0; priority--) {
+            if (levels[priority].take(&slot)) {
+                front = slot;
+                break;
+            }
+        }
+        if (front == -1) {
+            return nullptr;
+        }
     }
+    return &slots[front];
 }
 
-void Msg_Queue::add(msg_struct* value) {
-    node* newNode = new node; // Dynamically allocate memory for a new node
-    memcpy(&newNode->msg, value, sizeof(msg_struct));
-    newNode->next = nullptr;  // Initialize the next pointer to nullptr
+void Msg_Queue::releaseLarge(const msg_struct* msg) {
+    if ((msg->header.flags & MSG_FLAG_LARGE) && large_store != nullptr) {
+        large_ref ref;
+        memcpy(&ref, msg->payload, sizeof(large_ref));
+        large_store->release(&ref);
+    }
+}
+
+void Msg_Queue::releaseFront() {
+    releaseLarge(head());
+    free_slots.push(front);
+    front = -1; // The next front may have a higher priority
+}
+
+void Msg_Queue::readFront() {
+    if (head() != nullptr) {
+        QEN_LATENCY(PERF_RECEIVE_TO_READ, micros() - stamps[front]);
+    }
+    releaseFront();
+}
+
+bool Msg_Queue::store(const uint8_t* bytes, int len) {
+    MSG_PRIORITY priority = msgPriority(((const msg_header*)bytes)->flags);
+    size_t reserve = priority == PRIORITY_NORMAL ? MSG_PRIORITY_RESERVE : 0;
+    if (free_slots.size() > reserve && levels[priority].hasRoom()) {
+        uint16_t slot;
+        if (!free_slots.pop(slot)) {
+            return false;
+        }
+        memcpy(&slots[slot], bytes, len);
+        stamps[slot] = micros();
+        levels[priority].push(slot);
+
+        // Only the producer raises the mark, the consumer resets it
+        uint16_t used = (uint16_t)(MSG_QUEUE_CAPACITY - free_slots.size());
+        if (used > high_water.load(std::memory_order_relaxed)) {
+            high_water.store(used, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Full, one message is lost whatever the policy
+    drops.fetch_add(1, std::memory_order_relaxed);
+    switch (overflow.load(std::memory_order_relaxed)) {
+        case DROP_OLDEST:
+            return replaceOldest(bytes, len, priority);
+        case COALESCE_TYPE:
+            return coalesce(bytes, len, priority);
+        default:
+            return false; // Fails instead of allocating when the queue is full
+    }
+}
+
+bool Msg_Queue::replaceOldest(const uint8_t* bytes, int len, MSG_PRIORITY priority) {
+    if (!levels[priority].hasRoom()) {
+        return false; // Too many holes wait for the consumer
+    }
+    uint16_t slot;
+    for (int level = PRIORITY_NORMAL; level <= priority; level++) {
+        if (levels[level].replace([](uint16_t) { return true; }, Index_Ring<2 * MSG_QUEUE_CAPACITY>::HOLE, &slot)) {
+            releaseLarge(&slots[slot]);
+            memcpy(&slots[slot], bytes, len);
+            stamps[slot] = micros();
+            levels[priority].push(slot);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Msg_Queue::coalesce(const uint8_t* bytes, int len, MSG_PRIORITY priority) {
+    // Only the producer writes the slots, so the queued headers can be compared while the consumer reads
+    const msg_header* header = (const msg_header*)bytes;
+    auto same_type = [this, header](uint16_t slot) {
+        const msg_header& queued = slots[slot].header;
+        return queued.type == header->type && (queued.flags & MSG_FLAG_ARRAY) == (header->flags & MSG_FLAG_ARRAY);
+    };
+
+    // The new message takes the place of the old one, which becomes the spare
+    memcpy(&slots[spare], bytes, len);
+    stamps[spare] = micros();
+    uint16_t slot;
+    if (!levels[priority].replace(same_type, spare, &slot)) {
+        return false;
+    }
+    releaseLarge(&slots[slot]);
+    spare = slot;
+    return true;
+}
+
+bool Msg_Queue::add(const msg_struct* value) {
+    return store((const uint8_t*)value, MSG_HEADER_SIZE + value->header.length); // Only the used part of the payload
+}
 
-    if (rear == nullptr) {
-        // Queue is empty, both front and rear should point to the new node
-        front = rear = newNode;
-    } else {
-        // Link the new node at the end and update the rear pointer
-        rear->next = newNode;
-        rear = newNode;
+int Msg_Queue::add(const uint8_t* frame, int len) {
+    int used = msgLength(frame, len);
+    if (used > 0) {
+        store(frame, used);
     }
+    return used;
+}
+
+Msg_View Msg_Queue::peek() {
+    const msg_struct* msg = head();
+    if (msg == nullptr || borrowed) {
+        return Msg_View();
+    }
+    borrowed = true;
+    return Msg_View(this, msg);
+}
+
+void Msg_Queue::release() {
+    if (borrowed) {
+        borrowed = false;
+        readFront();
+    }
+}
+
+int Msg_Queue::freeSlots() const {
+    int free = (int)free_slots.size() - MSG_PRIORITY_RESERVE;
+    return free > 0 ? free : 0;
+}
+
+int Msg_Queue::frontPriority() const {
+    if (front != -1) {
+        return msgPriority(slots[front].header.flags);
+    }
+    for (int priority = MSG_PRIORITIES - 1; priority >= 0; priority--) {
+        if (!levels[priority].isEmpty()) {
+            return priority;
+        }
+    }
+    return -1;
 }
 
 // Check if the Msg_Queue is empty
 bool Msg_Queue::isEmpty() const {
-    return front == nullptr;
+    return frontPriority() == -1;
+}
+
+// Drop the front message unless a view holds it
+void Msg_Queue::drop() {
+    if (head() != nullptr && !borrowed) {
+        releaseFront();
+    }
+}
+
+// Drop every queued message
+void Msg_Queue::clear() {
+    borrowed = false;
+    for (int i = 0; i < MSG_QUEUE_CAPACITY && head() != nullptr; i++) {
+        releaseFront(); // Gives the slots back and frees the arena blocks of the reassembled messages
+    }
 }
 
 // Implementation of isFrontArray
 bool Msg_Queue::isFrontArray() const {
-    return front->msg.size == 0; // Queue is empty, no front node
+    const msg_struct* msg = head();
+    return msg != nullptr && (msg->header.flags & MSG_FLAG_ARRAY); // Queue is empty, no front node
 }
 // Implementation of isFrontArray
  MSG_VARIABLE_TYPE Msg_Queue::data_type() const{
-    if (front == nullptr) {
+    const msg_struct* msg = head();
+    if (msg == nullptr) {
         return UNKNOWN; // Queue is empty, no front node
     }
 
     
-    return front->msg.type; // Return isArray if cast is successful
+    return (MSG_VARIABLE_TYPE)msg->header.type; // Return the type tag of the front message
 }
 
+size_t Msg_Queue::data_size() const {
+    const msg_struct* msg = head();
+    if (msg == nullptr) {
+        return 0; // Queue is empty, no front node
+    }
+    size_t size;
+    payloadOf(msg, &size);
+    return size;
+}
+
+// Constructors for Msg_View
+Msg_View::Msg_View() : queue(nullptr), msg(nullptr) {}
+
+Msg_View::Msg_View(Msg_Queue* queue, const msg_struct* msg) : queue(queue), msg(msg) {}
+
+Msg_View::Msg_View(Msg_View&& other) : queue(other.queue), msg(other.msg) {
+    other.queue = nullptr;
+    other.msg = nullptr;
+}
+
+Msg_View& Msg_View::operator=(Msg_View&& other) {
+    if (this != &other) {
+        release();
+        queue = other.queue;
+        msg = other.msg;
+        other.queue = nullptr;
+        other.msg = nullptr;
+    }
+    return *this;
+}
+
+// Destructor gives the slot back
+Msg_View::~Msg_View() {
+    release();
+}
+
+Msg_View::operator bool() const {
+    return msg != nullptr;
+}
+
+const uint8_t* Msg_View::data() const {
+    size_t size;
+    return msg != nullptr ? queue->payloadOf(msg, &size) : nullptr;
+}
+
+size_t Msg_View::size() const {
+    size_t size = 0;
+    if (msg != nullptr) {
+        queue->payloadOf(msg, &size);
+    }
+    return size;
+}
+
+MSG_VARIABLE_TYPE Msg_View::type() const {
+    return msg != nullptr ? (MSG_VARIABLE_TYPE)msg->header.type : UNKNOWN;
+}
+
+bool Msg_View::isArray() const {
+    return msg != nullptr && (msg->header.flags & MSG_FLAG_ARRAY);
+}
+
+int Msg_View::from() const {
+    return msg != nullptr ? queue->sender() : -1;
+}
+
+void Msg_View::release() {
+    if (queue != nullptr) {
+        queue->release();
+    }
+    queue = nullptr;
+    msg = nullptr;
+}
@@ -18,29 +18,194 @@
 #define QuickESPNow_Queue_h
 
 #include <cstddef>
+#include <atomic>
+#include <algorithm>
 #include <type_traits>
 #include <Arduino.h>
 
 #include "QuickESPNow_utils.h"
+#include "QuickESPNow_RingBuffer.h"
+#include "QuickESPNow_Metrics.h"
+
+class Msg_Queue;
+class Frag_Reassembler;
+
+/**
+ * @class   Msg_View
+ * @brief   Read-only view of the message at the front of a Msg_Queue.
+ * @note    The view points into the queue's slot, nothing is copied. The message is removed
+ *          from the queue when the view is destroyed or release() is called.
+ *          The payload is not aligned, read values through as<T>() or memcpy.
+ */
+class Msg_View {
+    private:
+        Msg_Queue* queue;                   ///< The queue that owns the slot, nullptr for an empty view.
+        const msg_struct* msg;              ///< The borrowed slot.
+
+        friend class Msg_Queue;
+
+        /**
+         * @brief   Constructor for a view of a borrowed slot, used by Msg_Queue::peek().
+         */
+        Msg_View(Msg_Queue* queue, const msg_struct* msg);
+
+    public:
+        /**
+         * @brief   Constructor for an empty view.
+         */
+        Msg_View();
+
+        /**
+         * @brief   Destructor that gives the slot back to the queue.
+         */
+        ~Msg_View();
+
+        Msg_View(Msg_View&& other);
+        Msg_View& operator=(Msg_View&& other);
+        Msg_View(const Msg_View&) = delete;
+        Msg_View& operator=(const Msg_View&) = delete;
+
+        /**
+         * @brief   Checks if the view holds a message.
+         * @return  false if the queue was empty when the view was taken or the view was released.
+         */
+        explicit operator bool() const;
+
+        /**
+         * @brief   Gives the payload of the message.
+         * @return  Pointer to the first payload byte, nullptr for an empty view.
+         */
+        const uint8_t* data() const;
+
+        /**
+         * @brief   Gives the length of the payload.
+         * @return  The number of payload bytes, 0 for an empty view.
+         */
+        size_t size() const;
+
+        /**
+         * @brief   Gives the type of the message.
+         * @return  The MSG_VARIABLE_TYPE of the message, UNKNOWN for an empty view.
+         */
+        MSG_VARIABLE_TYPE type() const;
+
+        /**
+         * @brief   Checks if the message is an array.
+         * @return  true if the message is an array, false otherwise.
+         */
+        bool isArray() const;
+
+        /**
+         * @brief   Gives the ID of the peer that sent the message.
+         * @return  The ID given to addPeer, -1 if the sender is not a peer or for an empty view.
+         */
+        int from() const;
+
+        /**
+         * @brief   Copies the payload into a value.
+         * @tparam  T The type of the value.
+         * @return  The value, a shorter payload leaves the rest default-constructed.
+         */
+        template<typename T>
+        T as() const;
+
+        /**
+         * @brief   Removes the message from the queue, the view becomes empty.
+         */
+        void release();
+};
 
 /**
  * @class   Msg_Queue
- * @brief   A template-based message queue capable of storing any type of data, including arrays.
+ * @brief   A fixed-capacity message queue capable of storing any type of data, including arrays.
+ * @note    The messages are kept in a preallocated pool of slots. The indexes of the queued slots go
+ *          through one lock-free single-producer/single-consumer ring per priority, and the consumer gives
+ *          the slots back through another one. add() is meant to be called from the receive callback
+ *          (WiFi task) and the pop methods from the application task, no other synchronization is needed.
+ * @note    The front message is the oldest one of the highest priority. Once it has been looked at it stays
+ *          the front until it is removed, so data_type() and pop() always refer to the same message.
+ * @note    The queue never holds more than MSG_QUEUE_CAPACITY messages, the OVERFLOW_POLICY decides which
+ *          message is lost when it is full. The producer can only take back messages that are not the front yet.
  */
 class Msg_Queue {
+    static_assert(MSG_PRIORITY_RESERVE < MSG_QUEUE_CAPACITY, "MSG_PRIORITY_RESERVE must leave room for PRIORITY_NORMAL messages");
+
     private:
+        msg_struct slots[MSG_QUEUE_CAPACITY + 1];                               ///< Preallocated storage of the queued messages and of the spare slot.
+        Ring_Buffer<uint16_t, MSG_QUEUE_CAPACITY> free_slots;                   ///< Slots given back by the consumer.
+        mutable Index_Ring<2 * MSG_QUEUE_CAPACITY> levels[MSG_PRIORITIES];      ///< Queued slots of each priority, in arrival order (room for the holes left by DROP_OLDEST).
+        uint16_t spare;                                                         ///< Slot a coalesced message is written to before it is swapped in (producer side).
+        mutable int front;                                                      ///< Slot of the front message, -1 until it is chosen (consumer side).
+        std::atomic<uint8_t> overflow;                                          ///< The OVERFLOW_POLICY.
+        std::atomic<uint32_t> drops;                                            ///< Messages lost because the queue was full.
+        std::atomic<uint16_t> high_water;                                       ///< Most messages the queue held at once.
+        uint32_t stamps[MSG_QUEUE_CAPACITY + 1];                                ///< Time (us) each slot's message was queued.
+        bool borrowed;                                      ///< A Msg_View holds the front message (consumer side).
+        Frag_Reassembler* large_store;                      ///< Holds the payloads of the MSG_FLAG_LARGE messages, nullptr if none.
+        int source;                                         ///< The ID of the peer whose messages are queued, -1 if mixed or unknown.
+
+        friend class Msg_View;
+
         /**
-         * @struct  node
-         * @brief   Template class that inherits from father_node. Holds either a single value or an array of values.
-         * @tparam  T Type of data that the node stores.
+         * @brief   Copies an encoded message (header and payload) into a free slot.
+         * @note    The last MSG_PRIORITY_RESERVE slots are kept for the messages above PRIORITY_NORMAL.
+         * @note    When the queue is full the OVERFLOW_POLICY applies and a drop is counted.
+         * @return  false if the new message was dropped.
          */
-        struct node {
-            msg_struct msg;
-            node* next;
-        };
+        bool store(const uint8_t* bytes, int len);
 
-        node* front; ///< Pointer to the front of the queue.
-        node* rear;  ///< Pointer to the rear of the queue.
+        /**
+         * @brief   Makes room for a message by taking back the oldest queued message of the lowest priority (DROP_OLDEST).
+         * @param   bytes The encoded message
+         * @param   len The length of the encoded message
+         * @param   priority The priority of the message, only messages up to this priority are taken back
+         * @return  false if every queued message is already the front or of a higher priority.
+         */
+        bool replaceOldest(const uint8_t* bytes, int len, MSG_PRIORITY priority);
+
+        /**
+         * @brief   Swaps a message for the oldest queued message of the same type and priority (COALESCE_TYPE).
+         * @param   bytes The encoded message
+         * @param   len The length of the encoded message
+         * @param   priority The priority of the message
+         * @return  false if no queued message can be replaced.
+         */
+        bool coalesce(const uint8_t* bytes, int len, MSG_PRIORITY priority);
+
+        /**
+         * @brief   Frees the arena blocks of a reassembled message, does nothing for other messages.
+         * @param   msg The message that is removed
+         */
+        void releaseLarge(const msg_struct* msg);
+
+        /**
+         * @brief   Gives the front message, choosing it if it was not chosen yet (consumer side).
+         * @return  Pointer to the front message, nullptr if the queue is empty.
+         */
+        const msg_struct* head() const;
+
+        /**
+         * @brief   Removes the front message once its view is done with it.
+         */
+        void release();
+
+        /**
+         * @brief   Gives the payload of a queued message, following the reference of a reassembled message.
+         * @param   msg The queued message
+         * @param   size The variable that will receive the payload length
+         * @return  Pointer to the first payload byte.
+         */
+        const uint8_t* payloadOf(const msg_struct* msg, size_t* size) const;
+
+        /**
+         * @brief   Removes the front message and frees the arena blocks of a reassembled message.
+         */
+        void releaseFront();
+
+        /**
+         * @brief   Removes the front message once the application has read it, timing how long it waited.
+         */
+        void readFront();
     public:
         /**
          * @brief   Constructor to initialize an empty queue.
@@ -52,17 +217,84 @@ class Msg_Queue {
          */
         ~Msg_Queue();               
 
+        /**
+         * @brief   Sets where the payloads of reassembled messages are kept.
+         * @param   store The reassembler that queues MSG_FLAG_LARGE messages
+         */
+        void setLargeStore(Frag_Reassembler* store);
+
+        /**
+         * @brief   Sets the ID of the peer whose messages are queued.
+         * @param   id The peer's ID, -1 if the senders are unknown
+         */
+        void setSender(int id);
+
+        /**
+         * @brief   Gives the ID of the peer whose messages are queued.
+         * @return  The peer's ID, -1 if the senders are unknown
+         */
+        int sender() const;
+
+        /**
+         * @brief   Sets what a full queue does with a new message.
+         * @param   policy The OVERFLOW_POLICY
+         */
+        void setOverflowPolicy(OVERFLOW_POLICY policy);
+
+        /**
+         * @brief   Gives what a full queue does with a new message.
+         * @return  The OVERFLOW_POLICY
+         */
+        OVERFLOW_POLICY overflowPolicy() const;
+
+        /**
+         * @brief   Gives the number of messages lost because the queue was full.
+         * @return  The number of dropped, taken back or coalesced messages since the queue was created.
+         */
+        uint32_t dropped() const;
+
+        /**
+         * @brief   Gives the most messages the queue held at once.
+         * @return  The high-water mark since the queue was created or resetHighWater() was called.
+         */
+        uint16_t highWater() const;
+
+        /**
+         * @brief   Starts the high-water mark over from the messages queued now.
+         */
+        void resetHighWater();
+
         /**
          * @brief   Adds a single value to the queue (enqueue).
-         * @tparam  T The type of the value to be added.
-         * @param   value The value to be added.
+         * @param   value The decoded message to be added.
+         * 
+         * @return
+         *          - true : The message was queued, an older one may have been dropped for it
+         *          - false : The queue is full, the message was dropped
          */
-        void add(msg_struct* value);
+        bool add(const msg_struct* value);
+
+        /**
+         * @brief   Decodes the first message of a received frame straight into a free slot (enqueue).
+         * @param   frame The raw bytes of the frame
+         * @param   len The length of the frame
+         * @note    The frame is copied once, from the radio buffer to the slot.
+         * @return  The number of bytes the message takes in the frame, 0 if it is invalid.
+         *          A valid message is skipped when the queue is full and cannot make room for it.
+         */
+        int add(const uint8_t* frame, int len);
+
+        /**
+         * @brief   Gives a read-only view of the front message without copying it.
+         * @attention Only one view can be held at a time, pop() and popArray() do nothing while it is held.
+         * @return  The view, empty if the queue is empty or a view is already held.
+         */
+        Msg_View peek();
 
         /**
          * @brief   Removes and returns a single value from the front of the queue (dequeue).
          * @tparam  T The type of the value to be returned.
-         * @return  T The dequeued value.
+         * @return  T The dequeued value, default-constructed if the queue is empty or the front is borrowed.
          */
         template<typename T>
         T pop();            
@@ -75,6 +307,44 @@ class Msg_Queue {
         template<typename T>
         void popArray(T* output);          
 
+        /**
+         * @brief   Removes and copies the front value if its type tag matches T (dequeue).
+         * @tparam  T The type of the value.
+         * @param   output The variable that will receive the value.
+         * @return
+         *          - 1 : The value was copied and removed
+         *          - 0 : The queue is empty or the front is borrowed
+         *          - -1 : The front message has another type, it was left in the queue
+         */
+        template<typename T>
+        int tryPop(T* output);
+
+        /**
+         * @brief   Removes and copies the front array if its element type tag matches T (dequeue).
+         * @tparam  T The type of the array elements.
+         * @param   output Pointer to the output array where the dequeued data will be copied.
+         * @return  Same as tryPop.
+         */
+        template<typename T>
+        int tryPopArray(T* output);
+
+        /**
+         * @brief   Removes the front message without reading it.
+         */
+        void drop();
+
+        /**
+         * @brief   Gives the number of messages that can still be added (producer side).
+         * @return  The number of free slots that a PRIORITY_NORMAL message can take.
+         */
+        int freeSlots() const;
+
+        /**
+         * @brief   Gives the priority of the message that would be the front now, without choosing it.
+         * @return  The priority, -1 if the queue is empty.
+         */
+        int frontPriority() const;
+
         /**
          * @brief Checks if the queue is empty.
          * 
@@ -82,6 +352,11 @@ class Msg_Queue {
          */
         bool isEmpty() const;    
 
+        /**
+         * @brief Removes every message from the queue.
+         */
+        void clear();
+
         /**
          * @brief Checks if the front node contains an array.
          * 
@@ -105,52 +380,82 @@ class Msg_Queue {
          *          - DATA : The recieved message is type of data struct
          */
         MSG_VARIABLE_TYPE data_type() const;
+
+        /**
+         * @brief Gets the payload length of the front node.
+         * 
+         * @return The number of bytes of the front message, 0 if the queue is empty.
+         */
+        size_t data_size() const;
 };
 
 
 template<typename T>
-T Msg_Queue::pop() {
-    if (front == nullptr) {
-        return T(); // Return default-constructed object of type T
+T Msg_View::as() const {
+    T value = T();
+    if (msg != nullptr) {
+        memcpy(&value, data(), std::min(size(), sizeof(T)));
     }
+    return value;
+}
 
-    node* temp = front;
-    front = front->next;
-
-    if (front == nullptr) {
-        rear = nullptr;
+template<typename T>
+T Msg_Queue::pop() {
+    const msg_struct* msg = head();
+    if (msg == nullptr || borrowed) {
+        return T(); // Return default-constructed object of type T
     }
 
-    // Ensure that temp->msg is of the type we expect (it must be compatible with T)
-    // If you need to deserialize it or perform a cast, you can do it here
-    T value;
-    memcpy(&value, &temp->msg.data, sizeof(T)); // Copy the raw memory from temp->msg
+    // Copy at most sizeof(T) bytes, a shorter payload leaves the rest default-constructed
+    size_t size;
+    const uint8_t* payload = payloadOf(msg, &size);
+    T value = T();
+    memcpy(&value, payload, std::min(size, sizeof(T)));
 
-    delete temp; // Clean up memory
+    readFront(); // Release the slot to the producer
 
     return value; // Return the value of the appropriate type
 }
 
 template<typename T>
-void Msg_Queue::popArray(T* output) {
-    if (front == nullptr) {
-        return; // Queue is empty
+int Msg_Queue::tryPop(T* output) {
+    const msg_struct* msg = head();
+    if (msg == nullptr || borrowed) {
+        return 0;
     }
+    if (!msgTypeMatches(Msg_Type<T>::id, msg->header.type)) {
+        return -1;
+    }
+    *output = pop<T>();
+    return 1;
+}
 
-    node* temp = front;
-    front = front->next;
-
-    if (front == nullptr) {
-        rear = nullptr;
+template<typename T>
+int Msg_Queue::tryPopArray(T* output) {
+    const msg_struct* msg = head();
+    if (msg == nullptr || borrowed) {
+        return 0;
+    }
+    if (!msgTypeMatches(Msg_Type<T>::id, msg->header.type)) {
+        return -1;
     }
+    popArray(output);
+    return 1;
+}
 
-    for(int i = 0; i < temp->msg.size; i++){
-        T value;
-        memcpy(&value, &temp->msg.data_array[i], sizeof(T)); // Copy the raw memory from temp->msg
-        output[i] = value;
+template<typename T>
+void Msg_Queue::popArray(T* output) {
+    const msg_struct* msg = head();
+    if (msg == nullptr || borrowed) {
+        return; // Queue is empty or the front is borrowed
     }
+
+    // The element count is implied by the payload length
+    size_t size;
+    const uint8_t* payload = payloadOf(msg, &size);
+    memcpy(output, payload, (size / sizeof(T)) * sizeof(T));
     
-    delete temp;
+    readFront();
 }
 
 
@@ -0,0 +1,255 @@
+#include "QuickESPNow_Reliable.h"
+
+// Constructor for Reliable_Link
+Reliable_Link::Reliable_Link(const uint8_t* peer_mac, int window_size) : enabled(false), peer_ack(0), peer_ack_new(false), ack_state(0), ack_pending(false), ack_now(false), ack_owed_since(0) {
+    reset(peer_mac, window_size);
+}
+
+void Reliable_Link::reset(const uint8_t* peer_mac, int window_size) {
+    memcpy(this->mac, peer_mac, MAC_LENGTH);
+    setWindow(window_size);
+    for(int i = 0; i < RELIABLE_WINDOW; i++){
+        this->tx[i].used = false;
+    }
+    this->next_seq = 0;
+    this->base = 0;
+    this->srtt = 0;
+    this->rttvar = 0;
+    this->rto = RELIABLE_RTO_INITIAL_US;
+    this->backed_off_at = 0;
+    this->peer_ack_new.store(false, std::memory_order_relaxed);
+
+    this->rcv_next = 0;
+    this->rcv_have = 0;
+    this->peer_base = 0;
+    this->ack_pending.store(false, std::memory_order_relaxed);
+    publish();
+}
+
+bool Reliable_Link::matches(const uint8_t* peer_mac) const {
+    return memcmp(this->mac, peer_mac, MAC_LENGTH) == 0;
+}
+
+void Reliable_Link::setEnabled(bool enable) {
+    this->enabled.store(enable, std::memory_order_release);
+}
+
+bool Reliable_Link::isEnabled() const {
+    return this->enabled.load(std::memory_order_acquire);
+}
+
+void Reliable_Link::setWindow(int window_size) {
+    this->window = window_size < 1 ? 1 : (window_size > RELIABLE_WINDOW ? RELIABLE_WINDOW : window_size);
+}
+
+void Reliable_Link::stamp(uint8_t* frame, bool ack_now) {
+    // Any frame to the peer carries the acknowledgment, so none has to be sent on its own
+    this->ack_pending.store(false, std::memory_order_relaxed);
+    this->ack_now.store(false, std::memory_order_relaxed);
+    uint32_t state = this->ack_state.load(std::memory_order_acquire);
+
+    ((msg_header*)frame)->flags = ack_now ? LINK_FLAG_ACK_NOW : 0;
+
+    link_header link;
+    memcpy(&link, frame + MSG_HEADER_SIZE, sizeof(link_header));
+    link.base = this->base;
+    link.ack = state & 0xFFFF;
+    link.ack_bits = state >> 16;
+    memcpy(frame + MSG_HEADER_SIZE, &link, sizeof(link_header));
+}
+
+void Reliable_Link::sample(uint32_t rtt) {
+    // Smoothed round trip time and variation as in RFC 6298
+    if(this->srtt == 0){
+        this->srtt = rtt;
+        this->rttvar = rtt / 2;
+    }else{
+        uint32_t error = rtt > this->srtt ? rtt - this->srtt : this->srtt - rtt;
+        this->rttvar = (3 * this->rttvar + error) / 4;
+        this->srtt = (7 * this->srtt + rtt) / 8;
+    }
+    uint32_t timeout = this->srtt + (4 * this->rttvar > RELIABLE_RTO_MARGIN_US ? 4 * this->rttvar : RELIABLE_RTO_MARGIN_US);
+    this->rto = timeout < RELIABLE_RTO_MIN_US ? RELIABLE_RTO_MIN_US : (timeout > RELIABLE_RTO_MAX_US ? RELIABLE_RTO_MAX_US : timeout);
+}
+
+bool Reliable_Link::canSend() const {
+    return (uint16_t)(this->next_seq - this->base) < this->window;
+}
+
+int Reliable_Link::unacknowledged() const {
+    return (uint16_t)(this->next_seq - this->base);
+}
+
+const uint8_t* Reliable_Link::push(const uint8_t* msgs, int len, uint32_t now, int* frame_len) {
+    tx_slot* slot = &this->tx[this->next_seq % RELIABLE_WINDOW];
+
+    msg_header* header = (msg_header*)slot->frame;
+    header->version = MSG_WIRE_VERSION;
+    header->type = MSG_LINK_TYPE;
+    header->flags = 0;
+    header->length = sizeof(link_header);
+
+    link_header link;
+    link.seq = this->next_seq;
+    memcpy(slot->frame + MSG_HEADER_SIZE, &link, sizeof(link_header));
+    memcpy(slot->frame + RELIABLE_OVERHEAD, msgs, len);
+    this->next_seq++;
+    stamp(slot->frame, !canSend()); // Asks for the acknowledgment once the window is full
+
+    slot->length = RELIABLE_OVERHEAD + len;
+    slot->sent_at = now;
+    slot->retries = 0;
+    slot->used = true;
+
+    *frame_len = slot->length;
+    return slot->frame;
+}
+
+int Reliable_Link::processAcks(uint32_t now) {
+    if(!this->peer_ack_new.exchange(false, std::memory_order_acquire)){
+        return 0;
+    }
+    uint32_t state = this->peer_ack.load(std::memory_order_relaxed);
+    uint16_t ack = state & 0xFFFF;
+    uint16_t ack_bits = state >> 16;
+
+    int released = 0;
+    for(uint16_t seq = this->base; seq != this->next_seq; seq++){
+        tx_slot* slot = &this->tx[seq % RELIABLE_WINDOW];
+        if(!slot->used){
+            continue;
+        }
+        int16_t ahead = (int16_t)(seq - ack);
+        bool acked = ahead < 0 || (ahead >= 1 && ahead <= 16 && (ack_bits >> (ahead - 1)) & 1);
+        if(!acked){
+            continue;
+        }
+        if(slot->retries == 0){
+            sample(now - slot->sent_at); // Karn: a retransmitted frame gives no sample
+        }
+        slot->used = false;
+        released++;
+    }
+
+    while(this->base != this->next_seq && !this->tx[this->base % RELIABLE_WINDOW].used){
+        this->base++;
+    }
+    return released;
+}
+
+int Reliable_Link::expired(uint32_t now, const uint8_t** frame, int* value) {
+    for(uint16_t seq = this->base; seq != this->next_seq; seq++){
+        tx_slot* slot = &this->tx[seq % RELIABLE_WINDOW];
+        if(!slot->used || now - slot->sent_at < this->rto){
+            continue;
+        }
+
+        if(slot->retries >= RELIABLE_MAX_RETRIES){
+            slot->used = false;
+            while(this->base != this->next_seq && !this->tx[this->base % RELIABLE_WINDOW].used){
+                this->base++;
+            }
+            *value = seq;
+            return -1;
+        }
+
+        // Back off once per timeout period, until an acknowledgment gives a new sample (RFC 6298)
+        if(now - this->backed_off_at >= this->rto){
+            this->rto = this->rto * 2 > RELIABLE_RTO_MAX_US ? RELIABLE_RTO_MAX_US : this->rto * 2;
+            this->backed_off_at = now;
+        }
+        slot->retries++;
+        slot->sent_at = now;
+        stamp(slot->frame, true);
+        *frame = slot->frame;
+        *value = slot->length;
+        return 1;
+    }
+    return 0;
+}
+
+int Reliable_Link::ackFrame(uint32_t now, uint8_t* frame) {
+    if(!this->ack_pending.load(std::memory_order_acquire)){
+        return 0;
+    }
+    if(!this->ack_now.load(std::memory_order_relaxed) && now - this->ack_owed_since.load(std::memory_order_relaxed) < RELIABLE_ACK_DELAY_US){
+        return 0; // A data frame may still take it
+    }
+
+    msg_header* header = (msg_header*)frame;
+    header->version = MSG_WIRE_VERSION;
+    header->type = MSG_LINK_TYPE;
+    header->flags = 0;
+    header->length = sizeof(link_header);
+
+    link_header link;
+    link.seq = this->next_seq;
+    memcpy(frame + MSG_HEADER_SIZE, &link, sizeof(link_header));
+    stamp(frame, false);
+    return RELIABLE_OVERHEAD;
+}
+
+void Reliable_Link::publish() {
+    this->ack_state.store(this->rcv_next | (uint32_t)(this->rcv_have >> 1) << 16, std::memory_order_release);
+}
+
+void Reliable_Link::receive(const uint8_t* frame, int len) {
+    link_header link;
+    memcpy(&link, frame + MSG_HEADER_SIZE, sizeof(link_header));
+
+    this->peer_ack.store(link.ack | (uint32_t)link.ack_bits << 16, std::memory_order_relaxed);
+    this->peer_ack_new.store(true, std::memory_order_release);
+
+    // The peer never retransmits more than a window before what it was told, anything older means it started over
+    if((int16_t)(link.base - this->rcv_next) < -RELIABLE_WINDOW){
+        this->rcv_next = link.base;
+        this->rcv_have = 0;
+    }
+    this->peer_base = link.base;
+
+    if(len <= RELIABLE_OVERHEAD){
+        publish();
+        return; // Only an acknowledgment
+    }
+
+    // Duplicates are acknowledged right away, their first acknowledgment was lost
+    int16_t ahead = (int16_t)(link.seq - this->rcv_next);
+    bool fresh = ahead >= 0 && ahead < RELIABLE_WINDOW && !(this->rcv_have & (1 << ahead));
+    if(fresh){
+        rx_slot* slot = &this->rx[link.seq % RELIABLE_WINDOW];
+        slot->length = len - RELIABLE_OVERHEAD;
+        memcpy(slot->msgs, frame + RELIABLE_OVERHEAD, slot->length);
+        this->rcv_have |= 1 << ahead;
+    }
+    publish();
+
+    if(!fresh || (((const msg_header*)frame)->flags & LINK_FLAG_ACK_NOW)){
+        this->ack_now.store(true, std::memory_order_relaxed);
+    }
+    if(!this->ack_pending.load(std::memory_order_relaxed)){
+        this->ack_owed_since.store(micros(), std::memory_order_relaxed);
+        this->ack_pending.store(true, std::memory_order_release);
+    }
+}
+
+const uint8_t* Reliable_Link::next(int* len, bool* forced) {
+    while(true){
+        bool given_up = (int16_t)(this->peer_base - this->rcv_next) > 0;
+        if(this->rcv_have & 1){
+            rx_slot* slot = &this->rx[this->rcv_next % RELIABLE_WINDOW];
+            *len = slot->length;
+            *forced = given_up;
+            return slot->msgs;
+        }
+        if(!given_up){
+            return nullptr;
+        }
+        advance(); // The peer gave this frame up, it will never arrive
+    }
+}
+
+void Reliable_Link::advance() {
+    this->rcv_next++;
+    this->rcv_have >>= 1;
+    publish();
+}
@@ -0,0 +1,226 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_Reliable_h
+#define QuickESPNow_Reliable_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_utils.h"
+
+/**
+ * @brief   Header of the link message (type MSG_LINK_TYPE) that starts every reliable frame
+ * @note    The messages of the frame follow it, a frame with no messages only carries the acknowledgment.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t seq;                       ///< Sequence number of the frame (ignored without messages).
+    uint16_t base;                      ///< Oldest sequence number the sender still retransmits.
+    uint16_t ack;                       ///< Next sequence number expected from the peer (cumulative acknowledgment).
+    uint16_t ack_bits;                  ///< Bit i acknowledges the frame ack + 1 + i, received out of order.
+} link_header;
+
+static_assert(MSG_HEADER_SIZE + sizeof(link_header) == RELIABLE_OVERHEAD, "RELIABLE_OVERHEAD does not match the link header");
+static_assert(RELIABLE_WINDOW > 0 && RELIABLE_WINDOW <= 16 && (RELIABLE_WINDOW & (RELIABLE_WINDOW - 1)) == 0,
+              "RELIABLE_WINDOW must be a power of two up to 16");
+
+/**
+ * @class   Reliable_Link
+ * @brief   Selective repeat over ESP-NOW for a single peer.
+ * @note    The application task sends frames through push(), the WiFi task passes the received reliable
+ *          frames to receive() and delivers them in order with next() and advance(). The acknowledgments
+ *          cross between the two tasks through atomics, piggybacked on the frames going the other way or
+ *          sent on their own by the application task. A frame that is not acknowledged within the adaptive
+ *          retransmission timeout is sent again, on its own, so a loss costs one frame and not the window.
+ */
+class Reliable_Link {
+    private:
+        /**
+         * @struct  tx_slot
+         * @brief   A sent frame that waits for its acknowledgment.
+         */
+        struct tx_slot {
+            uint8_t frame[ESPNOW_MTU];          ///< The frame, link header included.
+            int length;                         ///< Number of used bytes in the frame.
+            uint32_t sent_at;                   ///< Time (us) the frame was last sent.
+            uint8_t retries;                    ///< Number of retransmissions.
+            bool used;                          ///< Whether the slot waits for an acknowledgment.
+        };
+
+        /**
+         * @struct  rx_slot
+         * @brief   A received frame that waits for the frames before it.
+         */
+        struct rx_slot {
+            uint8_t msgs[ESPNOW_MTU - RELIABLE_OVERHEAD]; ///< The messages of the frame.
+            int length;                         ///< Number of used bytes.
+        };
+
+        uint8_t mac[MAC_LENGTH];                ///< MAC address of the peer.
+        std::atomic<bool> enabled;              ///< Whether the link is in use.
+
+        // Sender side (application task)
+        tx_slot tx[RELIABLE_WINDOW];            ///< The unacknowledged frames, by sequence number.
+        int window;                             ///< Largest number of unacknowledged frames.
+        uint16_t next_seq;                      ///< Sequence number of the next frame.
+        uint16_t base;                          ///< Oldest unacknowledged sequence number.
+        uint32_t srtt;                          ///< Smoothed round trip time (us), 0 before the first sample.
+        uint32_t rttvar;                        ///< Round trip time variation (us).
+        uint32_t rto;                           ///< Retransmission timeout (us).
+        uint32_t backed_off_at;                 ///< Time (us) the timeout was last doubled.
+        std::atomic<uint32_t> peer_ack;         ///< Latest acknowledgment of the peer (ack | ack_bits << 16).
+        std::atomic<bool> peer_ack_new;         ///< An acknowledgment arrived since processAcks().
+
+        // Receiver side (WiFi task)
+        rx_slot rx[RELIABLE_WINDOW];            ///< The frames received ahead of rcv_next.
+        uint16_t rcv_next;                      ///< Next sequence number to be delivered.
+        uint16_t rcv_have;                      ///< Bit i is set if the frame rcv_next + i is buffered.
+        uint16_t peer_base;                     ///< Oldest sequence number the peer still retransmits.
+        std::atomic<uint32_t> ack_state;        ///< Acknowledgment for the peer (rcv_next | ack_bits << 16).
+        std::atomic<bool> ack_pending;          ///< A frame arrived that was not acknowledged yet.
+        std::atomic<bool> ack_now;              ///< The peer waits for the acknowledgment, it must not be delayed.
+        std::atomic<uint32_t> ack_owed_since;   ///< Time (us) the oldest unacknowledged frame arrived.
+
+        /**
+         * @brief   Writes the current acknowledgment into the link header of a frame.
+         * @param   frame The frame
+         * @param   ack_now Whether the peer must acknowledge the frame right away
+         */
+        void stamp(uint8_t* frame, bool ack_now);
+
+        /**
+         * @brief   Updates the retransmission timeout with a round trip time sample, as in RFC 6298.
+         */
+        void sample(uint32_t rtt);
+
+        /**
+         * @brief   Publishes the acknowledgment of the received frames (WiFi task).
+         */
+        void publish();
+
+    public:
+        /**
+         * @brief   Constructor for a link with nothing sent or received.
+         * @param   peer_mac The MAC address of the peer
+         * @param   window_size Largest number of unacknowledged frames (1 is stop-and-wait)
+         */
+        Reliable_Link(const uint8_t* peer_mac, int window_size);
+
+        Reliable_Link(const Reliable_Link&) = delete;
+        Reliable_Link& operator=(const Reliable_Link&) = delete;
+
+        /**
+         * @brief   Starts the link over for another peer (application task, while it is disabled).
+         */
+        void reset(const uint8_t* peer_mac, int window_size);
+
+        /**
+         * @brief   Checks if the link belongs to a peer.
+         */
+        bool matches(const uint8_t* peer_mac) const;
+
+        /**
+         * @brief   Starts or stops using the link.
+         */
+        void setEnabled(bool enable);
+
+        /**
+         * @brief   Checks if the link is in use.
+         */
+        bool isEnabled() const;
+
+        /**
+         * @brief   Sets the largest number of unacknowledged frames, up to RELIABLE_WINDOW.
+         */
+        void setWindow(int window_size);
+
+        /********Application task********/
+        /**
+         * @brief   Checks if the window has room for another frame.
+         */
+        bool canSend() const;
+
+        /**
+         * @brief   Gives the number of frames that wait for their acknowledgment.
+         */
+        int unacknowledged() const;
+
+        /**
+         * @brief   Puts messages in a reliable frame and keeps it until it is acknowledged.
+         * @attention Only call it when canSend() is true.
+         * @param   msgs The encoded messages
+         * @param   len The number of bytes of the messages, at most ESPNOW_MTU - RELIABLE_OVERHEAD
+         * @param   now The current time (us)
+         * @param   frame_len The variable that will receive the length of the frame
+         * @return  The frame to be sent
+         */
+        const uint8_t* push(const uint8_t* msgs, int len, uint32_t now, int* frame_len);
+
+        /**
+         * @brief   Releases the frames the peer acknowledged and measures the round trip time.
+         * @param   now The current time (us)
+         * @return  The number of released frames
+         */
+        int processAcks(uint32_t now);
+
+        /**
+         * @brief   Finds a frame whose retransmission timeout expired.
+         * @param   now The current time (us)
+         * @param   frame The variable that will receive the frame to be sent again
+         * @param   value The variable that will receive the length of the frame, or the sequence number of a given up frame
+         * @return
+         *          - 1 : The frame must be sent again
+         *          - -1 : The frame was retransmitted RELIABLE_MAX_RETRIES times and was given up
+         *          - 0 : No frame is due
+         */
+        int expired(uint32_t now, const uint8_t** frame, int* value);
+
+        /**
+         * @brief   Builds a frame that only carries the acknowledgment, if one is owed to the peer
+         *          and no data frame took it for RELIABLE_ACK_DELAY_US.
+         * @param   now The current time (us)
+         * @param   frame The buffer of at least RELIABLE_OVERHEAD bytes that will hold the frame
+         * @return  The length of the frame, 0 if no acknowledgment is due
+         */
+        int ackFrame(uint32_t now, uint8_t* frame);
+        /********************************/
+
+        /********WiFi task********/
+        /**
+         * @brief   Takes the acknowledgment of a received reliable frame and buffers its messages.
+         * @param   frame The frame, starting with the link message
+         * @param   len The length of the frame
+         */
+        void receive(const uint8_t* frame, int len);
+
+        /**
+         * @brief   Gives the messages of the next frame in order, skipping the frames the peer gave up.
+         * @param   len The variable that will receive the length of the messages
+         * @param   forced The variable that will be set if the peer gave up the frame, it can not wait any longer
+         * @return  The messages, nullptr if the next frame has not arrived
+         */
+        const uint8_t* next(int* len, bool* forced);
+
+        /**
+         * @brief   Moves past the frame given by next(), once it is delivered or dropped.
+         */
+        void advance();
+        /*************************/
+};
+
+#endif
@@ -0,0 +1,294 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_RingBuffer_h
+#define QuickESPNow_RingBuffer_h
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+/**
+ * @class   Ring_Buffer
+ * @brief   A fixed-capacity, lock-free single-producer/single-consumer ring buffer.
+ * @tparam  T Type of the stored elements.
+ * @tparam  N Capacity of the buffer, must be a power of two.
+ * @note    Only one task may call the producer methods (push) and only one task may call
+ *          the consumer methods (front, pop, drop, clear). Both sides may call the query methods.
+ */
+template<typename T, size_t N>
+class Ring_Buffer {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Ring_Buffer capacity must be a power of two");
+
+    private:
+        T slots[N];                 ///< Preallocated storage for the elements.
+        std::atomic<size_t> head;   ///< Index of the next slot to be written (owned by the producer).
+        std::atomic<size_t> tail;   ///< Index of the next slot to be read (owned by the consumer).
+
+    public:
+        /**
+         * @brief   Constructor to initialize an empty buffer.
+         */
+        Ring_Buffer() : head(0), tail(0) {}
+
+        Ring_Buffer(const Ring_Buffer&) = delete;
+        Ring_Buffer& operator=(const Ring_Buffer&) = delete;
+
+        /**
+         * @brief   Copies a value to the back of the buffer (producer side).
+         * @param   value The value to be added.
+         * @return
+         *          - true : The value was added
+         *          - false : The buffer is full, the value was dropped
+         */
+        bool push(const T& value) {
+            T* slot = claim();
+            if (slot == nullptr) {
+                return false;
+            }
+            *slot = value;
+            commit();
+            return true;
+        }
+
+        /**
+         * @brief   Gives access to the next free slot so it can be filled in place (producer side).
+         * @return  Pointer to the free slot, or nullptr if the buffer is full.
+         * @note    The slot is only visible to the consumer after commit().
+         */
+        T* claim() {
+            const size_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) == N) {
+                return nullptr;
+            }
+            return &slots[h & (N - 1)];
+        }
+
+        /**
+         * @brief   Publishes the slot returned by claim() (producer side).
+         * @attention Must only be called after claim() returned a non-null pointer.
+         */
+        void commit() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief   Gives access to the oldest element without removing it (consumer side).
+         * @return  Pointer to the front element, or nullptr if the buffer is empty.
+         */
+        T* front() {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &slots[t & (N - 1)];
+        }
+
+        /**
+         * @brief   Gives read-only access to the oldest element without removing it (consumer side).
+         * @return  Pointer to the front element, or nullptr if the buffer is empty.
+         */
+        const T* front() const {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &slots[t & (N - 1)];
+        }
+
+        /**
+         * @brief   Removes the oldest element and copies it to output (consumer side).
+         * @param   output The variable that will receive the element.
+         * @return
+         *          - true : An element was removed
+         *          - false : The buffer is empty
+         */
+        bool pop(T& output) {
+            const T* value = front();
+            if (value == nullptr) {
+                return false;
+            }
+            output = *value;
+            drop();
+            return true;
+        }
+
+        /**
+         * @brief   Removes the oldest element (consumer side).
+         * @attention Must only be called after front() returned a non-null pointer.
+         */
+        void drop() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief   Removes every element currently in the buffer (consumer side).
+         */
+        void clear() {
+            tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        /**
+         * @brief   Checks if the buffer is empty.
+         * @return  true if the buffer is empty, false otherwise.
+         */
+        bool isEmpty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief   Checks if the buffer is full.
+         * @return  true if the buffer is full, false otherwise.
+         */
+        bool isFull() const {
+            return size() == N;
+        }
+
+        /**
+         * @brief   Gives the number of elements currently stored.
+         * @return  The number of elements in the buffer.
+         */
+        size_t size() const {
+            const size_t t = tail.load(std::memory_order_acquire);
+            return head.load(std::memory_order_acquire) - t;
+        }
+
+        /**
+         * @brief   Gives the maximum number of elements the buffer can hold.
+         * @return  The capacity of the buffer.
+         */
+        static constexpr size_t capacity() {
+            return N;
+        }
+};
+
+/**
+ * @class   Index_Ring
+ * @brief   A lock-free single-producer/single-consumer ring of slot indexes, whose entries the
+ *          producer can still take back or swap until the consumer reaches them.
+ * @tparam  N Capacity of the ring, must be a power of two.
+ * @note    Each entry is exchanged atomically by the side that gets to it first. An entry the producer
+ *          took back is left as a hole, which keeps its place until the consumer skips it.
+ */
+template<size_t N>
+class Index_Ring {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Index_Ring capacity must be a power of two");
+
+    public:
+        static constexpr uint16_t HOLE = 0xFFFF;    ///< Entry that was taken back by the producer or read by the consumer.
+
+    private:
+        std::atomic<uint16_t> entries[N];   ///< The queued indexes and holes.
+        std::atomic<size_t> head;           ///< Index of the next entry to be written (owned by the producer).
+        std::atomic<size_t> tail;           ///< Index of the next entry to be read (owned by the consumer).
+        std::atomic<int> count;             ///< Number of entries that are not holes.
+
+    public:
+        /**
+         * @brief   Constructor to initialize an empty ring.
+         */
+        Index_Ring() : head(0), tail(0), count(0) {}
+
+        Index_Ring(const Index_Ring&) = delete;
+        Index_Ring& operator=(const Index_Ring&) = delete;
+
+        /**
+         * @brief   Checks if an index can be added, holes take room until the consumer skips them (producer side).
+         * @return  true if push() will succeed, false otherwise.
+         */
+        bool hasRoom() const {
+            return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire) < N;
+        }
+
+        /**
+         * @brief   Adds an index to the back of the ring (producer side).
+         * @param   index The index to be added, anything but HOLE.
+         * @return
+         *          - true : The index was added
+         *          - false : The ring is full, the index was dropped
+         */
+        bool push(uint16_t index) {
+            if (!hasRoom()) {
+                return false;
+            }
+            const size_t h = head.load(std::memory_order_relaxed);
+            entries[h & (N - 1)].store(index, std::memory_order_relaxed);
+            head.store(h + 1, std::memory_order_release);
+            count.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief   Removes the oldest index, skipping the holes (consumer side).
+         * @param   index The variable that will receive the index.
+         * @return
+         *          - true : An index was removed
+         *          - false : The ring is empty
+         */
+        bool take(uint16_t* index) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            while (t != head.load(std::memory_order_acquire)) {
+                uint16_t entry = entries[t & (N - 1)].exchange(HOLE, std::memory_order_acq_rel);
+                tail.store(++t, std::memory_order_release);
+                if (entry != HOLE) {
+                    count.fetch_sub(1, std::memory_order_relaxed);
+                    *index = entry;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief   Swaps the oldest queued index that matches, unless the consumer gets to it first (producer side).
+         * @tparam  Match Callable that takes an index and tells if it should be swapped.
+         * @param   match Chooses the index to be swapped
+         * @param   replacement The index that takes its place, HOLE to take it back
+         * @param   index The variable that will receive the swapped index.
+         * @return
+         *          - true : An index was swapped
+         *          - false : No queued index matches
+         */
+        template<typename Match>
+        bool replace(Match match, uint16_t replacement, uint16_t* index) {
+            const size_t h = head.load(std::memory_order_relaxed);
+            for (size_t t = tail.load(std::memory_order_acquire); t != h; t++) {
+                std::atomic<uint16_t>& entry = entries[t & (N - 1)];
+                uint16_t queued = entry.load(std::memory_order_acquire);
+                if (queued == HOLE || !match(queued)) {
+                    continue;
+                }
+                if (entry.compare_exchange_strong(queued, replacement, std::memory_order_acq_rel)) {
+                    if (replacement == HOLE) {
+                        count.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                    *index = queued;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief   Checks if the ring holds no index.
+         * @return  true if the ring is empty, false otherwise.
+         */
+        bool isEmpty() const {
+            return count.load(std::memory_order_acquire) <= 0;
+        }
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "QuickESPNow_RxDemux.h"
+#include "QuickESPNow_Log.h"
+
+#include <new>
+
+// Values of the hash index entries that do not hold a slot
+#define INDEX_EMPTY -1
+#define INDEX_REMOVED -2    // Keeps the probe sequences of the other MACs going
+
+// Constructor for Rx_Demux
+Rx_Demux::Rx_Demux() : large_store(nullptr), overflow(DROP_NEWEST) {
+    for(int i = 0; i < MAX_PEERS; i++){
+        queues[i] = nullptr;
+    }
+    for(int i = 0; i < RX_INDEX_SIZE; i++){
+        index[i].store(INDEX_EMPTY, std::memory_order_relaxed);
+    }
+}
+
+// Destructor to clean up the Rx_Demux
+Rx_Demux::~Rx_Demux() {
+    reset();
+}
+
+int Rx_Demux::hash(const uint8_t* mac) {
+    // The first bytes are often the same vendor prefix, the last ones tell the boards apart
+    uint32_t low = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+    return (int)(((low ^ mac[1]) * 2654435761u) >> 16) & (RX_INDEX_SIZE - 1);
+}
+
+bool Rx_Demux::open(int key, int id, const uint8_t* mac) {
+    if(key < 0 || key >= MAX_PEERS){
+        return false;
+    }
+    close(key); // The peer may have changed its MAC
+
+    if(queues[key] == nullptr){
+        queues[key] = new (std::nothrow) Msg_Queue();
+        if(queues[key] != nullptr){
+            queues[key]->setLargeStore(large_store);
+            queues[key]->setOverflowPolicy(overflow);
+        }else{
+            QEN_LOG_ERROR(LOG_FROM_APP, LOG_ALLOCATION_FAIL, mac, id);
+        }
+    }else if(queues[key]->sender() != id){
+        queues[key]->clear(); // Messages of the slot's previous peer
+        queues[key]->setOverflowPolicy(overflow);
+    }
+    if(queues[key] != nullptr){
+        queues[key]->setSender(id);
+    }
+    memcpy(macs[key], mac, MAC_LENGTH);
+
+    // The MAC is written before the entry is published, the callback only reads it through the entry
+    int pos = hash(mac);
+    while(index[pos].load(std::memory_order_relaxed) >= 0){
+        pos = (pos + 1) & (RX_INDEX_SIZE - 1);
+    }
+    index[pos].store(key, std::memory_order_release);
+    return queues[key] != nullptr; // Without its queue the slot is still found, its frames go to the shared queue
+}
+
+void Rx_Demux::close(int key) {
+    for(int pos = 0; pos < RX_INDEX_SIZE; pos++){
+        if(index[pos].load(std::memory_order_relaxed) == key){
+            index[pos].store(INDEX_REMOVED, std::memory_order_release);
+        }
+    }
+
+    // A removed entry right before an empty one ends no probe sequence, so it can be emptied
+    for(int pos = 0; pos < RX_INDEX_SIZE; pos++){
+        int at = pos;
+        while(index[at].load(std::memory_order_relaxed) == INDEX_REMOVED &&
+              index[(at + 1) & (RX_INDEX_SIZE - 1)].load(std::memory_order_relaxed) == INDEX_EMPTY){
+            index[at].store(INDEX_EMPTY, std::memory_order_release);
+            at = (at - 1) & (RX_INDEX_SIZE - 1);
+        }
+    }
+}
+
+int Rx_Demux::find(const uint8_t* mac) const {
+    int pos = hash(mac);
+    for(int probes = 0; probes < RX_INDEX_SIZE; probes++){
+        int key = index[pos].load(std::memory_order_acquire);
+        if(key == INDEX_EMPTY){
+            return -1;
+        }
+        if(key >= 0 && memcmp(macs[key], mac, MAC_LENGTH) == 0){
+            return key;
+        }
+        pos = (pos + 1) & (RX_INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+Msg_Queue* Rx_Demux::queue(int key) const {
+    return key >= 0 && key < MAX_PEERS ? queues[key] : nullptr;
+}
+
+void Rx_Demux::setLargeStore(Frag_Reassembler* store) {
+    large_store = store;
+    for(int i = 0; i < MAX_PEERS; i++){
+        if(queues[i] != nullptr){
+            queues[i]->setLargeStore(store);
+        }
+    }
+}
+
+void Rx_Demux::setOverflowPolicy(OVERFLOW_POLICY policy) {
+    overflow = policy;
+    for(int i = 0; i < MAX_PEERS; i++){
+        if(queues[i] != nullptr){
+            queues[i]->setOverflowPolicy(policy);
+        }
+    }
+}
+
+void Rx_Demux::reset() {
+    for(int i = 0; i < RX_INDEX_SIZE; i++){
+        index[i].store(INDEX_EMPTY, std::memory_order_relaxed);
+    }
+    for(int i = 0; i < MAX_PEERS; i++){
+        delete queues[i];
+        queues[i] = nullptr;
+    }
+}
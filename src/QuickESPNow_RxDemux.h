@@ -0,0 +1,116 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_RxDemux_h
+#define QuickESPNow_RxDemux_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_Queue.h"
+
+/**
+ * @class   Rx_Demux
+ * @brief   Sorts the received frames into one queue per registered peer, found by the sender's MAC.
+ * @note    The peers are opened and closed by the application task, find() is called by the
+ *          receive callback (WiFi task). The MAC index is updated one entry at a time so the
+ *          callback never waits and never sees a half rebuilt index.
+ * @note    Each slot's queue is allocated on the heap the first time the slot is opened and costs
+ *          sizeof(Msg_Queue), about MSG_QUEUE_CAPACITY * 280 bytes (9 KB with the default 32 slots,
+ *          180 KB for 20 peers). Lower MSG_QUEUE_CAPACITY with a build flag on boards with many peers.
+ */
+class Rx_Demux {
+    private:
+        Msg_Queue* queues[MAX_PEERS];               ///< The queue of each peer slot, nullptr until the slot is first opened.
+        uint8_t macs[MAX_PEERS][MAC_LENGTH];        ///< The MAC address of each open slot.
+        std::atomic<int8_t> index[RX_INDEX_SIZE];   ///< Open addressing hash index from MAC to slot.
+        Frag_Reassembler* large_store;              ///< Given to the queues for the reassembled messages.
+        OVERFLOW_POLICY overflow;                   ///< Given to the queues when they are opened for a new peer.
+
+        /**
+         * @brief   Gives the first hash index position of a MAC address
+         * @param   mac The MAC address
+         * @return  The position in the hash index
+         */
+        static int hash(const uint8_t* mac);
+
+    public:
+        /**
+         * @brief   Constructor to initialize a demultiplexer without peers.
+         */
+        Rx_Demux();
+
+        /**
+         * @brief   Destructor that frees the queues.
+         */
+        ~Rx_Demux();
+
+        Rx_Demux(const Rx_Demux&) = delete;
+        Rx_Demux& operator=(const Rx_Demux&) = delete;
+
+        /**
+         * @brief   Starts sorting the frames of a peer into the queue of its slot (application task).
+         * @param   key The slot of the peer
+         * @param   id The ID of the peer, given back by the queue's sender()
+         * @param   mac The MAC address of the peer
+         * @note    The queue is emptied and gets the default OVERFLOW_POLICY when the slot is given to another ID.
+         * @return
+         *          - true : The peer's frames go to its queue
+         *          - false : The slot is out of range, or its queue could not be allocated and queue() gives nullptr
+         */
+        bool open(int key, int id, const uint8_t* mac);
+
+        /**
+         * @brief   Stops sorting the frames of a peer, the messages already queued can still be read (application task).
+         * @param   key The slot of the peer
+         */
+        void close(int key);
+
+        /**
+         * @brief   Finds the slot of the peer that sent a frame in constant time (WiFi task).
+         * @param   mac The MAC address of the sender
+         * @return  The slot of the peer, -1 if the sender is not an open peer
+         */
+        int find(const uint8_t* mac) const;
+
+        /**
+         * @brief   Gives the queue of a slot.
+         * @param   key The slot of the peer
+         * @return  The queue, nullptr if the slot was never opened
+         */
+        Msg_Queue* queue(int key) const;
+
+        /**
+         * @brief   Sets where the payloads of reassembled messages are kept, for every queue.
+         * @param   store The reassembler, nullptr if none
+         */
+        void setLargeStore(Frag_Reassembler* store);
+
+        /**
+         * @brief   Sets what a full queue does with a new message, for every queue and the ones opened later.
+         * @param   policy The OVERFLOW_POLICY
+         */
+        void setOverflowPolicy(OVERFLOW_POLICY policy);
+
+        /**
+         * @brief   Closes every slot and frees the queues (application task, receive callback unregistered).
+         */
+        void reset();
+};
+
+#endif
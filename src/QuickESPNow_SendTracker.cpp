@@ -0,0 +1,114 @@
+#include "QuickESPNow_SendTracker.h"
+
+// Handles and statuses share a single word so they are updated together
+#define HANDLE_BITS 30
+#define HANDLE_MASK ((1u << HANDLE_BITS) - 1)
+
+// Constructor for Send_Tracker
+Send_Tracker::Send_Tracker() : head(0), tail(0), next_handle(1), callback(nullptr) {
+    for(int i = 0; i < SEND_TRACK_CAPACITY; i++){
+        frames[i].cancelled.store(false, std::memory_order_relaxed);
+    }
+    for(int i = 0; i < MAX_PEERS; i++){
+        window_used[i].store(0, std::memory_order_relaxed);
+    }
+    for(int i = 0; i < SEND_STATUS_HISTORY; i++){
+        results[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int Send_Tracker::reserve(int key) {
+    if(key < 0 || key >= MAX_PEERS || window_used[key].load(std::memory_order_acquire) >= SEND_WINDOW){
+        return -1;
+    }
+    window_used[key].fetch_add(1, std::memory_order_acq_rel);
+
+    int handle = next_handle;
+    next_handle = next_handle == (int)HANDLE_MASK ? 1 : next_handle + 1;
+
+    results[handle & (SEND_STATUS_HISTORY - 1)].store(((uint32_t)handle << 2) | SEND_PENDING, std::memory_order_release);
+    return handle;
+}
+
+void Send_Tracker::release(int key, int handle) {
+    window_used[key].fetch_sub(1, std::memory_order_acq_rel);
+    results[handle & (SEND_STATUS_HISTORY - 1)].store(((uint32_t)handle << 2) | SEND_FAILED, std::memory_order_release);
+}
+
+int Send_Tracker::add(int key, int id, int handle) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) == SEND_TRACK_CAPACITY){
+        return -1;
+    }
+
+    inflight_frame* frame = &frames[h % SEND_TRACK_CAPACITY];
+    frame->key = key;
+    frame->id = id;
+    frame->handle = handle;
+    frame->sent_at = micros();
+    frame->cancelled.store(false, std::memory_order_relaxed);
+
+    // Published before esp_now_send, the callback may run before it returns
+    head.store(h + 1, std::memory_order_release);
+    return h % SEND_TRACK_CAPACITY;
+}
+
+void Send_Tracker::cancel(int position) {
+    frames[position].cancelled.store(true, std::memory_order_release);
+}
+
+void Send_Tracker::complete(bool delivered) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+
+    // Frames refused by the driver never get a callback, skip them
+    while(t != head.load(std::memory_order_acquire)){
+        inflight_frame* frame = &frames[t % SEND_TRACK_CAPACITY];
+        bool cancelled = frame->cancelled.load(std::memory_order_acquire);
+        int key = frame->key;
+        int id = frame->id;
+        int handle = frame->handle;
+        if(!cancelled){
+            QEN_LATENCY(PERF_SEND_TO_ACK, micros() - frame->sent_at); // Before the tail gives the frame back
+        }
+
+        t++;
+        tail.store(t, std::memory_order_release);
+
+        if(!cancelled){
+            if(handle != 0){
+                finish(key, id, handle, delivered ? SEND_DELIVERED : SEND_FAILED);
+            }
+            return;
+        }
+    }
+}
+
+void Send_Tracker::finish(int key, int id, int handle, SEND_STATUS status) {
+    window_used[key].fetch_sub(1, std::memory_order_acq_rel);
+    results[handle & (SEND_STATUS_HISTORY - 1)].store(((uint32_t)handle << 2) | status, std::memory_order_release);
+
+    send_complete_cb_t custom = callback;
+    if(custom != nullptr){
+        custom(id, handle, status == SEND_DELIVERED);
+    }
+}
+
+int Send_Tracker::inFlight() const {
+    return (int)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+}
+
+SEND_STATUS Send_Tracker::status(int handle) const {
+    if(handle <= 0){
+        return SEND_UNKNOWN;
+    }
+
+    uint32_t result = results[handle & (SEND_STATUS_HISTORY - 1)].load(std::memory_order_acquire);
+    if((result >> 2) != (uint32_t)handle){
+        return SEND_UNKNOWN; // Overwritten by a newer message
+    }
+    return (SEND_STATUS)(result & 3);
+}
+
+void Send_Tracker::setCallback(send_complete_cb_t custom) {
+    callback = custom;
+}
@@ -0,0 +1,131 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_SendTracker_h
+#define QuickESPNow_SendTracker_h
+
+#include <cstddef>
+#include <atomic>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+#include "QuickESPNow_Metrics.h"
+
+/**
+ * @brief   Callback for the completion of an asynchronous message
+ * @param   id The ID of the peer the message was sent to
+ * @param   handle The handle returned by sendAsync
+ * @param   delivered Whether the peer acknowledged the message
+ */
+typedef void (*send_complete_cb_t)(int id, int handle, bool delivered);
+
+/**
+ * @class   Send_Tracker
+ * @brief   Matches the send callbacks to the frames that were handed to the driver.
+ * @note    The driver reports the frames in the order they were sent, so the frames in flight are kept
+ *          in a FIFO. The application task adds frames and the WiFi task completes them.
+ */
+class Send_Tracker {
+    private:
+        /**
+         * @struct  inflight_frame
+         * @brief   A frame handed to the driver that waits for its send callback.
+         */
+        struct inflight_frame {
+            int key;                                ///< The slot of the destination peer.
+            int id;                                 ///< The ID of the destination peer.
+            int handle;                             ///< The handle of the message, 0 for messages sent with Send.
+            uint32_t sent_at;                       ///< Time (us) the frame was handed to the driver.
+            std::atomic<bool> cancelled;            ///< The driver refused the frame, no callback will come.
+        };
+
+        inflight_frame frames[SEND_TRACK_CAPACITY]; ///< The frames in flight.
+        std::atomic<uint32_t> head;                 ///< Next frame to be added (owned by the application task).
+        std::atomic<uint32_t> tail;                 ///< Next frame to be completed (owned by the WiFi task).
+
+        std::atomic<int> window_used[MAX_PEERS];    ///< Asynchronous messages in flight per peer.
+        std::atomic<uint32_t> results[SEND_STATUS_HISTORY]; ///< Handle and status of the recent messages.
+        int next_handle;                            ///< Handle given to the next message.
+        send_complete_cb_t callback;                ///< User callback for completed messages.
+
+        /**
+         * @brief   Records the status of a message and notifies the user.
+         */
+        void finish(int key, int id, int handle, SEND_STATUS status);
+
+    public:
+        /**
+         * @brief   Constructor to initialize an empty tracker.
+         */
+        Send_Tracker();
+
+        /**
+         * @brief   Reserves a place in the window of a peer for an asynchronous message.
+         * @param   key The slot of the peer
+         * @return  The handle of the message, -1 if the window of the peer is full
+         */
+        int reserve(int key);
+
+        /**
+         * @brief   Gives back a reserved place when the message could not be sent.
+         * @param   key The slot of the peer
+         * @param   handle The handle returned by reserve
+         */
+        void release(int key, int handle);
+
+        /**
+         * @brief   Records a frame right before it is handed to the driver (application task).
+         * @param   key The slot of the peer
+         * @param   id The ID of the peer
+         * @param   handle The handle of the message, 0 for messages sent with Send
+         * @return  The position of the frame, -1 if too many frames are in flight
+         */
+        int add(int key, int id, int handle);
+
+        /**
+         * @brief   Marks a recorded frame as refused by the driver (application task).
+         * @param   position The position returned by add
+         * @note    The message keeps its window slot, the caller releases it or sends the frame again.
+         */
+        void cancel(int position);
+
+        /**
+         * @brief   Completes the oldest frame in flight (WiFi task).
+         * @param   delivered Whether the peer acknowledged the frame
+         */
+        void complete(bool delivered);
+
+        /**
+         * @brief   Gives the number of frames waiting for their send callback.
+         * @return  The number of frames in flight.
+         */
+        int inFlight() const;
+
+        /**
+         * @brief   Gives the status of an asynchronous message.
+         * @param   handle The handle returned by sendAsync
+         * @return  The status of the message
+         */
+        SEND_STATUS status(int handle) const;
+
+        /**
+         * @brief   Sets the user callback for completed messages.
+         * @param   custom The function to be called, nullptr to disable it
+         */
+        void setCallback(send_complete_cb_t custom);
+};
+
+#endif
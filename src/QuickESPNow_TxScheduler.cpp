@@ -0,0 +1,165 @@
+#include "QuickESPNow_TxScheduler.h"
+
+// Constructor for Tx_Scheduler
+Tx_Scheduler::Tx_Scheduler(unsigned long settle_ms, int starvation_limit)
+    : pending(0), next_seq(0), settle_ms(settle_ms), starvation_limit(starvation_limit),
+      hop_started(0), settling(false), sent_on_channel(0), front_channel(-1) {
+    for(int ch = 0; ch <= MAX_WIFI_CHANNEL; ch++){
+        heads[ch] = -1;
+        tails[ch] = -1;
+    }
+    for(int i = 0; i < TX_QUEUE_CAPACITY; i++){
+        pool[i].next = i + 1 < TX_QUEUE_CAPACITY ? i + 1 : -1;
+    }
+    free_list = 0;
+}
+
+bool Tx_Scheduler::push(int key, uint8_t channel, const uint8_t* frame, int len, int handle, MSG_PRIORITY priority) {
+    int reserve = priority == PRIORITY_NORMAL ? MSG_PRIORITY_RESERVE : 0;
+    if(TX_QUEUE_CAPACITY - pending <= reserve || channel > MAX_WIFI_CHANNEL){
+        return false;
+    }
+
+    int16_t i = free_list;
+    free_list = pool[i].next;
+
+    memcpy(pool[i].frame, frame, len);
+    pool[i].length = len;
+    pool[i].key = key;
+    pool[i].handle = handle;
+    pool[i].channel = channel;
+    pool[i].priority = priority;
+    pool[i].seq = next_seq++;
+
+    // Goes after the last frame of the same or a higher priority
+    int16_t prev = -1;
+    int16_t next = heads[channel];
+    while(next != -1 && pool[next].priority >= priority){
+        prev = next;
+        next = pool[next].next;
+    }
+    pool[i].next = next;
+    if(prev == -1){
+        heads[channel] = i;
+    }else{
+        pool[prev].next = i;
+    }
+    if(next == -1){
+        tails[channel] = i;
+    }
+    pending++;
+    return true;
+}
+
+bool Tx_Scheduler::goesFirst(int channel, int other) const {
+    const tx_frame* a = &pool[heads[channel]];
+    const tx_frame* b = &pool[heads[other]];
+    if(a->priority != b->priority){
+        return a->priority > b->priority;
+    }
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+const tx_frame* Tx_Scheduler::front(int current_channel, unsigned long now, int* hop_to) {
+    *hop_to = -1;
+    front_channel = -1;
+
+    if(settling && now - hop_started < settle_ms){
+        return nullptr; // The radio is still settling
+    }
+    settling = false;
+
+    if(pending == 0){
+        return nullptr;
+    }
+
+    // Find the most urgent (then oldest) frame that needs a channel other than the current one
+    int oldest_other = -1;
+    for(int ch = 1; ch <= MAX_WIFI_CHANNEL; ch++){
+        if(ch == current_channel || heads[ch] == -1){
+            continue;
+        }
+        if(oldest_other == -1 || goesFirst(ch, oldest_other)){
+            oldest_other = ch;
+        }
+    }
+
+    // Frames for the current channel and frames for any channel need no hop
+    int candidate = -1;
+    if(current_channel > 0 && current_channel <= MAX_WIFI_CHANNEL && heads[current_channel] != -1){
+        candidate = current_channel;
+    }
+    if(heads[0] != -1 && (candidate == -1 || goesFirst(0, candidate))){
+        candidate = 0;
+    }
+
+    // A more urgent frame on another channel does not wait for the starvation limit
+    if(candidate != -1 && (oldest_other == -1 || (sent_on_channel < starvation_limit &&
+                                                  pool[heads[candidate]].priority >= pool[heads[oldest_other]].priority))){
+        front_channel = candidate;
+        return &pool[heads[candidate]];
+    }
+
+    *hop_to = oldest_other;
+    return nullptr;
+}
+
+void Tx_Scheduler::pop() {
+    if(front_channel == -1){
+        return;
+    }
+
+    int16_t i = heads[front_channel];
+    heads[front_channel] = pool[i].next;
+    if(heads[front_channel] == -1){
+        tails[front_channel] = -1;
+    }
+
+    pool[i].next = free_list;
+    free_list = i;
+    pending--;
+    sent_on_channel++;
+    front_channel = -1;
+}
+
+void Tx_Scheduler::hopped(unsigned long now) {
+    hop_started = now;
+    settling = true;
+    sent_on_channel = 0;
+}
+
+int Tx_Scheduler::dropPeer(int key, int* handles) {
+    int dropped = 0;
+    for(int ch = 0; ch <= MAX_WIFI_CHANNEL; ch++){
+        int16_t prev = -1;
+        int16_t i = heads[ch];
+        while(i != -1){
+            int16_t next = pool[i].next;
+            if(pool[i].key == key){
+                if(prev == -1){
+                    heads[ch] = next;
+                }else{
+                    pool[prev].next = next;
+                }
+                if(tails[ch] == i){
+                    tails[ch] = prev;
+                }
+                if(pool[i].handle != 0){
+                    handles[dropped++] = pool[i].handle;
+                }
+                pool[i].next = free_list;
+                free_list = i;
+                pending--;
+            }else{
+                prev = i;
+            }
+            i = next;
+        }
+    }
+    front_channel = -1;
+    return dropped;
+}
+
+bool Tx_Scheduler::isEmpty() const {
+    return pending == 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @author George Papamichail
+ *
+ * Copyright 2024 George Papamichail
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef QuickESPNow_TxScheduler_h
+#define QuickESPNow_TxScheduler_h
+
+#include <cstddef>
+#include <Arduino.h>
+
+#include "QuickESPNow_enums.h"
+
+/**
+ * @brief   A frame waiting to be transmitted
+ */
+typedef struct {
+    uint8_t frame[ESPNOW_MTU];      ///< The raw bytes of the frame.
+    int length;                     ///< The length of the frame.
+    int key;                        ///< The slot of the destination peer.
+    int handle;                     ///< The handle of an asynchronous message, 0 otherwise.
+    uint8_t channel;                ///< The channel of the destination peer (0 means any channel).
+    uint8_t priority;               ///< The MSG_PRIORITY of the frame.
+    uint32_t seq;                   ///< Enqueue order, used to find the oldest pending frame.
+    int16_t next;                   ///< Next frame of the same channel, -1 for the last one.
+} tx_frame;
+
+/**
+ * @class   Tx_Scheduler
+ * @brief   Holds the outgoing frames grouped by channel and decides when to hop.
+ * @note    The frames of the current channel are drained before hopping, but after starvation_limit
+ *          frames the scheduler hops to the channel with the oldest pending frame. After a hop nothing
+ *          is sent until the radio had settle_ms to settle.
+ * @note    Each channel keeps its frames ordered by priority, a frame goes after the frames of its own
+ *          or a higher priority. A frame of a higher priority on another channel makes the scheduler hop
+ *          right away, and the last MSG_PRIORITY_RESERVE frames of the pool are kept for them.
+ * @note    Both the producer (Send) and the consumer (update) run in the application task.
+ */
+class Tx_Scheduler {
+    static_assert(MSG_PRIORITY_RESERVE < TX_QUEUE_CAPACITY, "MSG_PRIORITY_RESERVE must leave room for PRIORITY_NORMAL frames");
+
+    private:
+        /**
+         * @brief   Checks if the head of a channel should be sent before the head of another one
+         * @return  true if it has a higher priority, or the same priority and was queued first
+         */
+        bool goesFirst(int channel, int other) const;
+
+        tx_frame pool[TX_QUEUE_CAPACITY];       ///< Preallocated storage of the pending frames.
+        int16_t heads[MAX_WIFI_CHANNEL + 1];    ///< First pending frame of each channel.
+        int16_t tails[MAX_WIFI_CHANNEL + 1];    ///< Last pending frame of each channel.
+        int16_t free_list;                      ///< First unused frame of the pool.
+        int pending;                            ///< Number of pending frames.
+        uint32_t next_seq;                      ///< Sequence given to the next frame.
+
+        unsigned long settle_ms;                ///< Time (ms) the radio needs after a channel switch.
+        int starvation_limit;                   ///< Frames sent on a channel before the others get a turn.
+        unsigned long hop_started;              ///< Time (ms) of the last channel switch.
+        bool settling;                          ///< Whether the radio may still be settling after a switch.
+        int sent_on_channel;                    ///< Frames sent since the last channel switch.
+        int front_channel;                      ///< List of the frame returned by front().
+
+    public:
+        /**
+         * @brief   Constructor to initialize an empty scheduler.
+         * @param   settle_ms The time (ms) the radio needs after a channel switch
+         * @param   starvation_limit The number of frames sent on a channel before the others get a turn
+         */
+        Tx_Scheduler(unsigned long settle_ms, int starvation_limit);
+
+        /**
+         * @brief   Adds a frame to the pending frames of its channel.
+         * @param   key The slot of the destination peer
+         * @param   channel The channel of the destination peer (0 means any channel)
+         * @param   frame The raw bytes of the frame
+         * @param   len The length of the frame
+         * @param   handle The handle of an asynchronous message, 0 otherwise
+         * @param   priority The priority of the frame
+         * @return
+         *          - true : The frame was queued
+         *          - false : The queue is full (for the frame's priority), the frame was dropped
+         */
+        bool push(int key, uint8_t channel, const uint8_t* frame, int len, int handle, MSG_PRIORITY priority = PRIORITY_NORMAL);
+
+        /**
+         * @brief   Gives the frame that should be sent now.
+         * @param   current_channel The channel the radio is set to
+         * @param   now The current time (ms)
+         * @param   hop_to Set to the channel to switch to, or -1 if no switch is needed
+         * @return  Pointer to the frame to be sent, nullptr if nothing can be sent now
+         */
+        const tx_frame* front(int current_channel, unsigned long now, int* hop_to);
+
+        /**
+         * @brief   Removes the frame returned by the last front() call.
+         */
+        void pop();
+
+        /**
+         * @brief   Tells the scheduler that the radio has switched channel.
+         * @param   now The time (ms) of the switch
+         */
+        void hopped(unsigned long now);
+
+        /**
+         * @brief   Drops every pending frame of a peer.
+         * @param   key The slot of the peer
+         * @param   handles Receives the handles of the dropped asynchronous messages, room for TX_QUEUE_CAPACITY
+         * @return  The number of handles written
+         */
+        int dropPeer(int key, int* handles);
+
+        /**
+         * @brief Checks if there are no pending frames.
+         *
+         * @return true if the scheduler is empty, false otherwise.
+         */
+        bool isEmpty() const;
+};
+
+#endif
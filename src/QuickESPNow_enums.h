@@ -17,11 +17,137 @@
 #ifndef QuickESPNow_enums_h 
 #define QuickESPNow_enums_h
 
+#include <cstdint>
+
 ///< Define constants
 #define MAC_LENGTH 6                    ///< Length of MAC address
 #define STRING_LENGTH 40                ///< Maximum string length
 #define SETTUP_ERRORS 8                 ///< Number of setup errors
 #define ENCRYPTION_KEY_LENGTH 16        ///< Length of the encryption key
+#define ESPNOW_MTU 250                  ///< Maximum number of bytes in a single ESP-NOW frame
+#define MAX_WIFI_CHANNEL 14             ///< Highest WiFi channel number
+
+#define MSG_WIRE_VERSION 1              ///< Version of the message wire format
+#define MSG_FLAG_ARRAY 0x01             ///< The payload is an array of elements
+#define MSG_FLAG_FRAGMENT 0x02          ///< The payload is one fragment of a message larger than a frame
+#define MSG_FLAG_LARGE 0x04             ///< The queued payload refers to a reassembled message (never sent)
+#define MSG_FLAG_PRIORITY 0x18          ///< The two bits that hold the MSG_PRIORITY of the message
+#define MSG_FLAG_DELTA 0x20             ///< The payload is a keyframe or the changes since the previous message of its type
+#define MSG_FLAG_COMPRESSED 0x40        ///< The fragmented message is LZ compressed, the receiver restores it after reassembly
+#define MSG_PRIORITY_SHIFT 3            ///< Position of the priority in the flags
+#define MSG_LINK_TYPE 63                ///< Type tag of the link header that starts every reliable frame
+#define LINK_FLAG_ACK_NOW 0x01          ///< The sender of the reliable frame waits for its acknowledgment
+#define MSG_GROUP_TYPE 62               ///< Type tag of the group header that starts every group frame
+#define GROUP_FLAG_ACK 0x01             ///< The members of the group acknowledge the group frame
+#define GROUP_FLAG_REPLY 0x02           ///< The frame acknowledges a group frame, it carries no messages
+#define MSG_CLOCK_TYPE 61               ///< Type tag of the probes that measure the round trip and the clock offset to a peer
+#define CLOCK_FLAG_PONG 0x01            ///< The probe answers a ping and carries the timestamps of its receiver
+#define MSG_USER_TYPE_FIRST 64          ///< Type tag of the first type registered with QUICKESPNOW_REGISTER_TYPE
+#define MSG_USER_TYPE_LAST 255          ///< Highest type tag (tags below MSG_USER_TYPE_FIRST are kept for the library)
+
+#ifndef MSG_QUEUE_CAPACITY
+#define MSG_QUEUE_CAPACITY 32           ///< Number of messages the receive queue can hold (must be a power of two)
+#endif
+
+#ifndef TX_QUEUE_CAPACITY
+#define TX_QUEUE_CAPACITY 16            ///< Number of frames the transmit scheduler can hold
+#endif
+
+#ifndef TX_DRIVER_DEPTH
+#define TX_DRIVER_DEPTH 4               ///< Scheduled frames handed to the driver at once, the rest wait in the scheduler where they can be overtaken
+#endif
+
+#ifndef MSG_PRIORITY_RESERVE
+#define MSG_PRIORITY_RESERVE 4          ///< Slots of each receive queue and of the transmit scheduler that only messages above PRIORITY_NORMAL can take
+#endif
+
+#ifndef MAILBOX_CAPACITY
+#define MAILBOX_CAPACITY 8              ///< Number of (peer, type) pairs that can keep only their newest message
+#endif
+
+#ifndef DELTA_CONTEXTS
+#define DELTA_CONTEXTS 8                ///< Number of (peer, type) pairs whose state is kept for delta encoding, on each side
+#endif
+
+#ifndef DISPATCH_QUEUE_CAPACITY
+#define DISPATCH_QUEUE_CAPACITY 16      ///< Number of messages that can wait for their handler (must be a power of two)
+#endif
+
+#ifndef DISPATCH_TASK_PRIORITY
+#define DISPATCH_TASK_PRIORITY 2        ///< FreeRTOS priority of the task that runs the handlers, loop() runs at 1
+#endif
+
+#ifndef DISPATCH_TASK_STACK
+#define DISPATCH_TASK_STACK 4096        ///< Stack (bytes) of the task that runs the handlers
+#endif
+
+#ifndef LINK_EWMA_SHIFT
+#define LINK_EWMA_SHIFT 3               ///< A new frame weighs 1 / (1 << LINK_EWMA_SHIFT) in the moving averages of the link statistics
+#endif
+
+#define LINK_JITTER_SHIFT 4             ///< Gain of the jitter estimate (1/16, as in RFC 3550)
+#define LINK_MAX_INTERVAL 10000000      ///< Longest time (us) between two frames taken into the averages
+
+#ifndef QUICKESPNOW_METRICS
+#define QUICKESPNOW_METRICS 1           ///< Set to 0 to compile the performance counters and histograms out
+#endif
+
+#define PERF_HISTOGRAM_BUCKETS 24       ///< Buckets of a latency histogram, bucket b counts [2^(b-1), 2^b) us and the last one everything above
+
+#ifndef CLOCK_SAMPLES
+#define CLOCK_SAMPLES 32                ///< Round trips kept per peer for the latency percentiles
+#endif
+
+#define CLOCK_FILTER_DEPTH 8            ///< Newest round trips the clock offset is taken from, the one with the least delay wins (as in NTP)
+#define CLOCK_DRIFT_PPM 15              ///< Drift (ppm) assumed between two clocks, it ages the older round trips in the filter
+#define CLOCK_PROBE_INTERVAL_MS 1000    ///< Default time between two probes of enableClockSync()
+#define CLOCK_PONG_TIMEOUT_MS 100       ///< Time a ping waits for its pong before the next periodic ping replaces it
+
+#ifndef GROUP_CAPACITY
+#define GROUP_CAPACITY 8                ///< Number of groups a board can send to or belong to
+#endif
+
+#ifndef COMPRESS_HASH_BITS
+#define COMPRESS_HASH_BITS 10           ///< Size (log2) of the match table of the compressor, it takes 4 bytes per entry
+#endif
+
+#define DELTA_KEYFRAME_INTERVAL 50      ///< Default number of messages between two keyframes of a delta encoded type
+#define DELTA_OVERHEAD 2                ///< Bytes the sequence numbers add to a delta encoded message
+
+#define GROUP_OVERHEAD 8                ///< Bytes the group header takes in a group frame
+#define GROUP_REPLY_BACKLOG 16          ///< Acknowledgments of group frames that can wait for update() (power of two)
+
+#define CLOCK_OVERHEAD 32               ///< Bytes of a clock probe, it is sent on its own
+#define CLOCK_REPLY_BACKLOG 8           ///< Answers to clock probes that can wait for update() (power of two)
+
+#ifndef SEND_WINDOW
+#define SEND_WINDOW 4                   ///< Number of asynchronous messages that can be in flight per peer
+#endif
+
+#ifndef FRAG_CONTEXTS
+#define FRAG_CONTEXTS 4                 ///< Number of fragmented messages that can be reassembled at the same time
+#endif
+
+#define FRAG_BLOCK_SIZE 256             ///< Allocation unit of the reassembly arena
+#define FRAG_SEND_TIMEOUT_MS 1000       ///< Time a fragment may wait for room in the driver's queue before the send fails
+
+#ifndef RELIABLE_WINDOW
+#define RELIABLE_WINDOW 8               ///< Largest number of unacknowledged reliable frames per peer (power of two, at most 16)
+#endif
+
+#define RELIABLE_OVERHEAD 12            ///< Bytes the link header takes in a reliable frame
+#define RELIABLE_ACK_DELAY_US 2000      ///< Time an acknowledgment may wait for a frame to ride on
+#define RELIABLE_RTO_INITIAL_US 20000   ///< Retransmission timeout before the first round trip is measured
+#define RELIABLE_RTO_MIN_US 2000        ///< Shortest retransmission timeout
+#define RELIABLE_RTO_MARGIN_US 1000     ///< Smallest margin of the retransmission timeout over the round trip time
+#define RELIABLE_RTO_MAX_US 500000      ///< Longest retransmission timeout
+#define RELIABLE_MAX_RETRIES 8          ///< Retransmissions of a reliable frame before it is given up
+#define RELIABLE_SEND_TIMEOUT_MS 1000   ///< Time Send() waits for room in a full reliable window
+
+#define MAX_PEERS 20                    ///< Maximum number of peers ESP-NOW supports
+#define RX_INDEX_SIZE 64                ///< Size of the MAC index that sorts the received frames (power of two, over twice MAX_PEERS)
+#define SEND_TRACK_CAPACITY 32          ///< Number of frames in flight that can be matched to their send callback
+#define SEND_STATUS_HISTORY 64          ///< Number of recent asynchronous messages whose status can be polled (power of two)
 
 /**
  * @brief   Enum for communication modes
@@ -47,10 +173,43 @@ enum INITIALIZATION_ERRORS {
     GET_NUMBER_OF_PEERS_ERROR            ///< [Error] getting the number of peers                       *8
 };
 
+/**
+ * @brief   Enum for the status of an asynchronous message.
+ */
+enum SEND_STATUS {
+    SEND_PENDING,       ///< The message has not been sent or acknowledged yet
+    SEND_DELIVERED,     ///< The peer acknowledged the message
+    SEND_FAILED,        ///< The message was not delivered
+    SEND_UNKNOWN        ///< The handle is invalid or too old to be tracked
+};
+
+/**
+ * @brief   Enum for the priority of a message.
+ * @note    The receive queues give the message with the highest priority first and the
+ *          transmit scheduler sends it first, messages of the same priority keep their order.
+ */
+enum MSG_PRIORITY : uint8_t {
+    PRIORITY_NORMAL,    ///< Default priority, for telemetry and other bulk traffic
+    PRIORITY_HIGH,      ///< Commands that should not wait behind the bulk traffic
+    PRIORITY_URGENT,    ///< Commands that must go first, such as an emergency stop
+    MSG_PRIORITIES      ///< Number of priority levels
+};
+
+/**
+ * @brief   Enum for what a full receive queue does with a new message.
+ * @note    Every message that is lost this way is counted by dropped().
+ */
+enum OVERFLOW_POLICY : uint8_t {
+    DROP_NEWEST,        ///< The new message is dropped (default)
+    DROP_OLDEST,        ///< The oldest message of the lowest priority makes room for the new one
+    COALESCE_TYPE       ///< The new message replaces the oldest queued message of the same type and priority, or is dropped if there is none
+};
+
 /**
  * @brief   Enum for variable types.
+ * @note    Types registered with QUICKESPNOW_REGISTER_TYPE use the tags from MSG_USER_TYPE_FIRST up.
  */
-enum MSG_VARIABLE_TYPE {
+enum MSG_VARIABLE_TYPE : uint8_t {
     INT,        ///< integer
     SHORT,      ///< short
     LONG,       ///< long
@@ -1,8 +1,25 @@
 #include "QuickESPNow_utils.h"
 
 
+int msgLength(const uint8_t* frame, int len){
+    if(len < MSG_HEADER_SIZE){
+        return 0;
+    }
 
+    const msg_header* header = (const msg_header*)frame;
+    if(header->version != MSG_WIRE_VERSION || header->length > MSG_MAX_PAYLOAD || MSG_HEADER_SIZE + header->length > len){
+        return 0;
+    }
+    return MSG_HEADER_SIZE + header->length;
+}
 
+int decodeMsg(msg_struct* msg, const uint8_t* frame, int len){
+    int used = msgLength(frame, len);
+    if(used > 0){
+        memcpy(msg, frame, used);
+    }
+    return used;
+}
 
 void getSTRINGtoMAC(String text, uint8_t *new_mac){
     String clean_MAC;
@@ -42,7 +59,8 @@ String getMACtoSTRING(uint8_t *mac){
 // Set the parameters of the data struct
 void Set_Data_parameters(data *new_struct,char type, char new_char[], int new_int, float new_float, bool new_bool) {
   if (new_char != NULL) {
-    strncpy(new_struct->msg_char, new_char, STRING_LENGTH);
+    strncpy(new_struct->msg_char, new_char, STRING_LENGTH - 1);
+    new_struct->msg_char[STRING_LENGTH - 1] = '\0';
   }
   new_struct->type = type;
   new_struct->msg_int = new_int;
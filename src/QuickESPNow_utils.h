@@ -18,6 +18,7 @@
 #define QuickESPNow_utils_h
 
 #include <cstddef>
+#include <type_traits>
 #include <Arduino.h>
 
 #include "QuickESPNow_enums.h"
@@ -33,16 +34,180 @@ typedef struct {
     bool msg_bool;                  ///< Boolean message.
 } data;
 
+/**
+ * @brief   Header that precedes every message on the wire
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;                    ///< Version of the wire format (MSG_WIRE_VERSION).
+    uint8_t type;                       ///< Type of the message (MSG_VARIABLE_TYPE).
+    uint8_t flags;                      ///< Flags of the message (MSG_FLAG_*).
+    uint8_t length;                     ///< Number of payload bytes that follow the header.
+} msg_header;
+
+#define MSG_HEADER_SIZE ((int)sizeof(msg_header))           ///< Size of the message header on the wire
+#define MSG_MAX_PAYLOAD (ESPNOW_MTU - MSG_HEADER_SIZE)      ///< Maximum number of payload bytes in a message
+
 /**
  * @brief   Create a struct that contains the data of the message
+ * @note    Only the header and the first header.length bytes of the payload are sent
  */
 typedef struct {
-    MSG_VARIABLE_TYPE type;             ///< Type of the message (Enum).
-    int size;                           ///< Size of the message.
-    void* data = nullptr;               ///< Pointer to the data.
-    void* data_array[STRING_LENGTH];    ///< Array to hold the data.
+    msg_header header;                  ///< Header of the message.
+    uint8_t payload[MSG_MAX_PAYLOAD];   ///< The raw bytes of the value or array.
 } msg_struct;
 
+/**
+ * @brief   Registry of the message types, gives the type tag that is sent with a value of type T
+ * @tparam  T The type of the value
+ * @note    Types that are not registered are sent as UNKNOWN and are not checked on receive,
+ *          register your own structs with QUICKESPNOW_REGISTER_TYPE.
+ */
+template<typename T>
+struct Msg_Type {
+    static constexpr uint8_t id = UNKNOWN;      ///< The type tag of T.
+};
+
+/**
+ * @brief   Reverse lookup of the registry, each tag can belong to a single type
+ * @tparam  ID The type tag
+ */
+template<uint8_t ID>
+struct Msg_Type_Owner;
+
+#define QUICKESPNOW_BUILTIN_TYPE(T, tag) \
+    template<> struct Msg_Type<T> { static constexpr uint8_t id = tag; }; \
+    template<> struct Msg_Type_Owner<tag> { typedef T type; };
+
+QUICKESPNOW_BUILTIN_TYPE(int, INT)
+QUICKESPNOW_BUILTIN_TYPE(short, SHORT)
+QUICKESPNOW_BUILTIN_TYPE(long, LONG)
+QUICKESPNOW_BUILTIN_TYPE(float, FLOAT)
+QUICKESPNOW_BUILTIN_TYPE(double, DOUBLE)
+QUICKESPNOW_BUILTIN_TYPE(char, CHAR)
+QUICKESPNOW_BUILTIN_TYPE(bool, BOOL)
+QUICKESPNOW_BUILTIN_TYPE(data, DATA)
+
+#undef QUICKESPNOW_BUILTIN_TYPE
+
+/**
+ * @brief   Registers a struct so it is sent with its own type tag and checked by read<T>()
+ * @param   T The struct, it must be trivially copyable and fit in a single frame
+ * @param   user_id The ID of the type, from 0 to MSG_USER_TYPE_LAST - MSG_USER_TYPE_FIRST, unique per type
+ * @attention   Use it at global scope, with the same ID on the sender and the receiver
+ * @example     QUICKESPNOW_REGISTER_TYPE(Telemetry, 1);
+ */
+#define QUICKESPNOW_REGISTER_TYPE(T, user_id) \
+    template<> struct Msg_Type<T> { \
+        static_assert(std::is_trivially_copyable<T>::value, #T " must be trivially copyable to be sent"); \
+        static_assert(sizeof(T) <= MSG_MAX_PAYLOAD, #T " does not fit in a single ESP-NOW frame"); \
+        static_assert((user_id) >= 0 && (user_id) <= MSG_USER_TYPE_LAST - MSG_USER_TYPE_FIRST, "The ID of " #T " is out of range"); \
+        static constexpr uint8_t id = MSG_USER_TYPE_FIRST + (user_id); \
+    }; \
+    template<> struct Msg_Type_Owner<MSG_USER_TYPE_FIRST + (user_id)> { typedef T type; }
+
+/**
+ * @brief   Gives the message type that corresponds to a variable type
+ * @tparam  T The type of the variable
+ * @return  The type tag of T, UNKNOWN if the type is not registered
+ */
+template<typename T>
+constexpr MSG_VARIABLE_TYPE getMsgType() {
+    return (MSG_VARIABLE_TYPE)Msg_Type<T>::id;
+}
+
+/**
+ * @brief   Checks if a received message can be read as the expected type
+ * @param   expected The type tag of the variable it is read into
+ * @param   received The type tag of the message
+ * @return  true if the tags are equal or either of them is UNKNOWN
+ */
+constexpr bool msgTypeMatches(uint8_t expected, uint8_t received) {
+    return expected == received || expected == UNKNOWN || received == UNKNOWN;
+}
+
+/**
+ * @brief   Gives the flag bits that carry a priority
+ * @param   priority The priority of the message
+ * @return  The bits to be set in the flags of the message
+ */
+constexpr uint8_t msgPriorityFlags(MSG_PRIORITY priority) {
+    return ((uint8_t)priority << MSG_PRIORITY_SHIFT) & MSG_FLAG_PRIORITY;
+}
+
+/**
+ * @brief   Gives the priority of a message from its flags
+ * @param   flags The flags of the message
+ * @return  The priority, an unknown level is treated as the highest one
+ */
+constexpr MSG_PRIORITY msgPriority(uint8_t flags) {
+    return ((flags & MSG_FLAG_PRIORITY) >> MSG_PRIORITY_SHIFT) < MSG_PRIORITIES ?
+           (MSG_PRIORITY)((flags & MSG_FLAG_PRIORITY) >> MSG_PRIORITY_SHIFT) : PRIORITY_URGENT;
+}
+
+/**
+ * @brief   Encodes a single value into a message
+ * @tparam  T The type of the value
+ * @param   msg The message that will hold the encoded value
+ * @param   value The value to be encoded
+ * @return  The number of bytes to be sent (header and payload)
+ */
+template<typename T>
+int encodeMsg(msg_struct* msg, const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be sent");
+    static_assert(sizeof(T) <= MSG_MAX_PAYLOAD, "The type does not fit in a single ESP-NOW frame");
+
+    msg->header.version = MSG_WIRE_VERSION;
+    msg->header.type = getMsgType<T>();
+    msg->header.flags = 0;
+    msg->header.length = sizeof(T);
+    memcpy(msg->payload, &value, sizeof(T));
+
+    return MSG_HEADER_SIZE + sizeof(T);
+}
+
+/**
+ * @brief   Encodes an array into a message
+ * @tparam  T The type of the array elements
+ * @param   msg The message that will hold the encoded array
+ * @param   values The array to be encoded
+ * @param   size The number of elements in the array
+ * @return  The number of bytes to be sent (header and payload), -1 if the array does not fit in a frame
+ */
+template<typename T>
+int encodeMsg(msg_struct* msg, const T* values, int size) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be sent");
+
+    if(size < 0 || size * (int)sizeof(T) > MSG_MAX_PAYLOAD){
+        return -1;
+    }
+
+    msg->header.version = MSG_WIRE_VERSION;
+    msg->header.type = getMsgType<T>();
+    msg->header.flags = MSG_FLAG_ARRAY;
+    msg->header.length = size * sizeof(T);
+    memcpy(msg->payload, values, size * sizeof(T));
+
+    return MSG_HEADER_SIZE + size * sizeof(T);
+}
+
+/**
+ * @brief   Checks the first message of a received frame without copying it
+ * @param   frame The raw bytes of the frame
+ * @param   len The length of the frame
+ * @return  The number of bytes the message takes in the frame, 0 if it is truncated or has an unsupported version
+ */
+int msgLength(const uint8_t* frame, int len);
+
+/**
+ * @brief   Decodes the first message of a received frame
+ * @param   msg The message that will hold the decoded message
+ * @param   frame The raw bytes of the frame
+ * @param   len The length of the frame
+ * @note    A frame may carry several messages back to back, call again with frame + the returned value
+ * @return  The number of bytes the message takes in the frame, 0 if it is truncated or has an unsupported version
+ */
+int decodeMsg(msg_struct* msg, const uint8_t* frame, int len);
+
 /**
  * @brief Function to set data parameters in the data structure.
  * @param new_struct Pointer to the data structure to be modified.